@@ -0,0 +1,57 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import <Foundation/Foundation.h>
+#import "MetricsHistogram.h"
+
+
+@interface ActionMetrics : NSObject
+
+
+// Required by BuildAPI access class
+// ActionMetrics is simply a packaging object for the counters and latency
+// histograms recorded for all the requests of a single action type
+
+// Methods
+
+- (instancetype)init;
+
+// Properties
+
+@property (nonatomic, strong) MetricsHistogram    *queueWait;         // From request to transmission
+@property (nonatomic, strong) MetricsHistogram    *firstByte;         // From transmission to response
+@property (nonatomic, strong) MetricsHistogram    *duration;          // From transmission to completion
+@property (nonatomic, strong) MetricsHistogram    *decode;            // Time spent decoding JSON
+@property (nonatomic, strong) NSMutableDictionary *statusCodes;       // Response counts keyed by HTTP status
+@property (nonatomic, assign) NSUInteger          requests;
+@property (nonatomic, assign) NSUInteger          failures;
+@property (nonatomic, assign) NSUInteger          retries;            // Requests re-sent after a 429 or a transient failure
+@property (nonatomic, assign) NSUInteger          hedges;             // Second copies sent of slow reads
+@property (nonatomic, assign) NSUInteger          cacheHits;          // Requests served without a request
+@property (nonatomic, assign) unsigned long long  bytesReceived;
+
+
+@end
@@ -0,0 +1,58 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import "ActionMetrics.h"
+
+
+@implementation ActionMetrics
+
+
+@synthesize queueWait, firstByte, duration, decode, statusCodes;
+@synthesize requests, failures, retries, hedges, cacheHits, bytesReceived;
+
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        queueWait = [[MetricsHistogram alloc] init];
+        firstByte = [[MetricsHistogram alloc] init];
+        duration = [[MetricsHistogram alloc] init];
+        decode = [[MetricsHistogram alloc] init];
+        statusCodes = [[NSMutableDictionary alloc] init];
+        requests = 0;
+        failures = 0;
+        retries = 0;
+        hedges = 0;
+        cacheHits = 0;
+        bytesReceived = 0;
+    }
+
+    return self;
+}
+
+
+@end
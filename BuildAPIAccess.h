@@ -26,8 +26,20 @@
 
 #import <Foundation/Foundation.h>
 #import "BuildAPIAccessConstants.h"
+#import "ActionMetrics.h"
+#import "BulkOperation.h"
+#import "CachedResponse.h"
+#import "CompactRecordDecoder.h"
 #import "Connexion.h"
+#import "DeviceTimeline.h"
+#import "FleetMirror.h"
+#import "LogStream.h"
 #import "LogStreamEvent.h"
+#import "PagedList.h"
+#import "RequestCompletion.h"
+#import "RingBuffer.h"
+#import "RolloutPipeline.h"
+#import "SessionPool.h"
 #import "Token.h"
 
 
@@ -36,28 +48,44 @@
 {
     NSURLSession *apiSession;
 
-    NSMutableArray *connexions, *pendingConnections, *loggingDevices, *products, *devices;
-    NSMutableArray *devicegroups, *deployments, *history, *logs, *logConnexions, *eiLibs;
+    NSMutableDictionary *connexions, *responseCache, *coalescedReads, *metrics, *timelines, *latencyHistory;
 
-    NSDictionary *me;
+    NSMutableArray *connexionQueues, *loggingDevices, *products, *devices;
+    NSMutableArray *devicegroups, *deployments, *logStreams, *eiLibs;
 
-    NSOperationQueue *eventQueue;
+    NSDictionary *me, *lastError;
 
-    NSString *baseURL, *userAgent, *username, *password, *logStreamID;
+    NSOperationQueue *eventQueue, *delegateQueue;
 
-    NSDateFormatter *dateFormatter;
+    dispatch_queue_t processingQueue, snapshotQueue;
+
+    NSString *baseURL, *userAgent, *username, *password, *snapshotAccount;
 
-    NSURL *logStreamURL;
+    NSDateFormatter *dateFormatter;
 
     NSTimeInterval logTimeout, logRetryInterval;
 
-    NSInteger pageSize, tempImpCloudCode;
+    NSMutableArray *logBatch;
+
+    dispatch_source_t logBatchTimer, scheduleTimer, metricsTimer, tokenRefreshTimer, mirrorSyncTimer, snapshotTimer;
+
+    NSTimeInterval rateLimitWindow, rateLimitRefillTime, rateLimitResumeTime, metricsStartTime;
+
+    double rateLimitCapacity, rateLimitTokens, retryBudget;
+
+    NSUInteger logBatchDropped, logEntriesDelivering, cacheGeneration;
+
+    NSInteger pageSize, tempImpCloudCode, snapshotCloudCode;
+
+    BOOL pageSizeChangeFlag, useTwoFactor, logStreamsBlocked, useCustomEndpoint;
+
+    Connexion *tokenConnexion;
 
-    BOOL pageSizeChangeFlag, logIsClosed, restartingLog, useTwoFactor;
+    FleetMirror *fleetMirror;
 
-    id logLastEventID, savedObject;
+    CompactRecordDecoder *recordDecoder;
 
-    Connexion *logConnexion, *tokenConnexion;
+    NSMutableSet *retryingConnexions;
 
     Token *token;
 }
@@ -72,6 +100,10 @@
 - (void)getNewAccessToken;
 - (void)refreshAccessToken:(NSString *)loginKey;
 - (BOOL)isAccessTokenValid;
+- (void)cacheTokenExpiry;
+- (void)scheduleTokenRefresh;
+- (void)refreshTokenInBackground;
+- (void)tokenRequestFailed:(Connexion *)connexion;
 - (void)clearCredentials;
 - (void)logout;
 - (void)twoFactorLogin:(NSString *)loginToken :(NSString *)otp;
@@ -84,6 +116,12 @@
 - (BOOL)isFirstPage:(NSDictionary *)links;
 - (NSString *)nextPageLink:(NSDictionary *)links;
 - (NSString *)getNextURL:(NSString *)url;
+- (void)setPagePrefetchLimit:(NSUInteger)limit;
+- (NSRange)rangeOfPageNumber:(NSString *)link;
+- (BOOL)fetchRemainingPages:(Connexion *)connexion :(NSDictionary *)data :(NSMutableArray *)array;
+- (BOOL)launchPageRequest:(PagedList *)pagedList;
+- (BOOL)addPageToPagedList:(Connexion *)connexion :(NSDictionary *)data;
+- (void)pageFailed:(Connexion *)connexion;
 
 // Data Request Methods
 - (void)getMyAccount;
@@ -160,6 +198,36 @@
 - (void)setMinimumDeployment:(NSString *)devicegroupID :(NSDictionary *)deployment;
 - (void)setMinimumDeployment:(NSString *)devicegroupID :(NSDictionary *)deployment :(id)someObject;
 
+// Bulk Device Methods
+- (void)bulkAssignDevices:(NSArray *)devices :(NSString *)devicegroupID;
+- (void)bulkAssignDevices:(NSArray *)devices :(NSString *)devicegroupID :(id)someObject;
+- (void)bulkUnassignDevices:(NSArray *)devices;
+- (void)bulkUnassignDevices:(NSArray *)devices :(id)someObject;
+- (void)bulkRestartDevices:(NSArray *)devices;
+- (void)bulkRestartDevices:(NSArray *)devices :(id)someObject;
+- (void)bulkRenameDevices:(NSDictionary *)names;
+- (void)bulkRenameDevices:(NSDictionary *)names :(id)someObject;
+- (void)bulkDeleteDevices:(NSArray *)devices;
+- (void)bulkDeleteDevices:(NSArray *)devices :(id)someObject;
+- (BulkOperation *)makeBulkOperation:(NSInteger)operation :(NSUInteger)total :(id)someObject;
+- (void)addBulkChunks:(BulkOperation *)bulk :(NSString *)verb :(NSString *)path :(NSArray *)deviceIDs;
+- (void)startBulkOperation:(BulkOperation *)bulk;
+- (void)launchBulkChunk:(BulkOperation *)bulk;
+- (void)bulkChunkComplete:(Connexion *)connexion :(BOOL)success;
+- (void)postBulkProgress:(BulkOperation *)bulk;
+- (void)finishBulkOperation:(BulkOperation *)bulk;
+- (NSString *)idOfDevice:(id)device;
+- (NSString *)devicegroupOfDevice:(id)device;
+
+// Rollout Methods
+- (void)runRollout:(NSArray *)plan;
+- (void)runRollout:(NSArray *)plan :(id)someObject;
+- (RolloutPipeline *)makeRolloutPipeline:(NSArray *)plan :(id)someObject;
+- (void)startRollout:(RolloutPipeline *)pipeline;
+- (void)startRolloutStep:(RolloutStep *)step :(RolloutPipeline *)pipeline;
+- (void)rolloutStepComplete:(RolloutStep *)step :(RolloutPipeline *)pipeline :(NSDictionary *)result :(NSDictionary *)error;
+- (void)skipRolloutDependents:(RolloutStep *)step :(RolloutPipeline *)pipeline;
+- (void)finishRollout:(RolloutPipeline *)pipeline;
 // HTTP Request Construction Methods
 - (NSMutableURLRequest *)makeGETrequest:(NSString *)path :(BOOL)getMultipleItems;
 - (NSMutableURLRequest *)makeDELETErequest:(NSString *)path;
@@ -171,31 +239,168 @@
 
 // Connection Methods
 - (Connexion *)launchConnection:(NSMutableURLRequest *)request :(NSInteger)actionCode :(id)someObject;
-- (void)relaunchConnection:(id)userInfo;
+- (BOOL)coalesceConnexion:(Connexion *)connexion;
+- (void)releaseCoalescedConnexion:(Connexion *)connexion;
+- (void)fanOutResult:(Connexion *)connexion :(NSDictionary *)data;
+- (void)notifyFollowers:(Connexion *)connexion :(NSString *)name :(NSDictionary *)returnData;
+- (BOOL)isListAction:(NSInteger)actionCode;
+- (void)startConnexion:(Connexion *)connexion;
+- (NSURLSessionDataTask *)makeTask:(NSURLRequest *)request;
+- (NSInteger)priorityForAction:(NSInteger)actionCode;
+- (void)queueConnexion:(Connexion *)connexion;
+- (void)rejectConnexion:(Connexion *)connexion;
+- (void)requestFailed:(Connexion *)connexion;
+- (NSUInteger)numberOfQueuedConnexions;
+- (NSUInteger)numberOfScheduledConnexions;
+- (void)scheduleConnections;
+- (NSTimeInterval)rateLimitDelay;
+- (void)updateRateLimit:(NSHTTPURLResponse *)response;
 - (void)launchPendingConnections;
 - (void)killAllConnections;
+- (void)addConnexion:(Connexion *)connexion;
+- (void)removeConnexion:(Connexion *)connexion;
+- (Connexion *)connexionForTask:(NSURLSessionTask *)task;
+- (void)clearConnexions;
+
+// Retry and Hedging Methods
+- (BOOL)isRetryableRead:(Connexion *)connexion;
+- (BOOL)isTransientError:(NSError *)error;
+- (BOOL)isTransientStatus:(NSInteger)statusCode;
+- (BOOL)retryConnexion:(Connexion *)connexion;
+- (void)resendConnexion:(Connexion *)connexion;
+- (NSTimeInterval)retryBackoff:(NSInteger)attempt;
+- (BOOL)spendRetryBudget;
+- (void)depositRetryBudget;
+- (BOOL)isHedgeableRead:(Connexion *)connexion;
+- (void)armHedge:(Connexion *)connexion;
+- (void)launchHedge:(Connexion *)connexion;
+- (BOOL)dropHedgedConnexion:(Connexion *)connexion;
+- (void)settleHedge:(Connexion *)connexion;
+- (void)unpairHedge:(Connexion *)survivor :(Connexion *)loser;
+- (void)recordLatency:(Connexion *)connexion;
+- (NSTimeInterval)hedgeDelay:(NSInteger)actionCode;
+
+// Session Pool Methods
+- (void)setSessionPool:(SessionPool *)pool;
+
+// Processing Queue Methods
+- (void)setProcessingQueue:(dispatch_queue_t)queue;
+- (BOOL)isOnProcessingQueue;
+- (void)performOnProcessingQueue:(dispatch_block_t)block;
+- (void)performOnProcessingQueueAndWait:(dispatch_block_t)block;
+- (void)performAfterDelay:(NSTimeInterval)delay :(dispatch_block_t)block;
+- (dispatch_source_t)makeTimer:(NSTimeInterval)delay :(dispatch_block_t)block;
+- (void)cancelTimer:(dispatch_source_t)timer;
+
+// Completion Handlers
+- (void)performRequest:(void (^)(id someObject))request :(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler;
+- (void)getMyAccountWithCompletion:(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler;
+- (void)getProductsWithCompletion:(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler;
+- (void)getProductWithCompletion:(NSString *)productID :(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler;
+- (void)getDevicegroupsWithCompletion:(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler;
+- (void)getDevicegroupWithCompletion:(NSString *)devicegroupID :(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler;
+- (void)getDevicesWithCompletion:(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler;
+- (void)getDeviceWithCompletion:(NSString *)deviceID :(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler;
+- (void)getDeploymentsWithCompletion:(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler;
+- (void)getDeploymentWithCompletion:(NSString *)deploymentID :(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler;
+- (void)relayResult:(NSString *)name :(NSDictionary *)dict;
+- (void)completeRequest:(RequestCompletion *)completion :(NSDictionary *)result :(NSDictionary *)error;
+
+// Metrics Methods
+- (void)recordMetrics:(Connexion *)connexion;
+- (ActionMetrics *)metricsForAction:(NSInteger)actionCode;
+- (NSDictionary *)metricsSnapshot;
+- (void)resetMetrics;
+- (void)setCollectMetrics:(BOOL)collect;
+- (void)setMetricsExportInterval:(NSTimeInterval)interval;
+- (void)exportMetrics;
+
+// Fleet Mirror Methods
+- (void)setUseFleetMirror:(BOOL)use;
+- (void)setMirrorSyncInterval:(NSTimeInterval)interval;
+- (void)syncMirror;
+- (void)syncMirrorList:(NSString *)path :(NSInteger)actionCode;
+- (void)mirrorList:(Connexion *)connexion :(NSArray *)list;
+- (void)updateMirror:(Connexion *)connexion :(NSDictionary *)data;
+- (void)postMirrorChanges:(NSDictionary *)changes;
+- (NSDictionary *)mirroredRecord:(NSString *)recordID :(NSString *)type;
+- (NSArray *)mirroredRecords:(NSString *)type;
+- (NSArray *)mirroredChildren:(NSString *)parentID :(NSString *)type;
+
+// Snapshot Methods
+- (BOOL)restoreSnapshot;
+- (void)saveSnapshot;
+- (BOOL)writeSnapshotFile:(NSData *)data :(NSString *)path;
+- (void)scheduleSnapshotSave;
+- (void)deleteSnapshot;
+- (void)validateSnapshot;
+- (void)setCurrentAccount:(NSString *)account;
+
+// Compact Record Methods
+- (NSString *)collectionForAction:(NSInteger)actionCode;
+- (NSSet *)fieldsForAction:(NSInteger)actionCode;
+- (NSString *)addFieldsToPath:(NSString *)path;
+- (NSDictionary *)compactListData:(Connexion *)connexion :(NSDictionary *)data;
+
+// Response Cache Methods
+- (NSString *)cacheKeyForConnexion:(Connexion *)connexion;
+- (BOOL)serveFromCache:(Connexion *)connexion;
+- (void)completeFromCache:(Connexion *)connexion;
+- (void)applyCacheValidators:(Connexion *)connexion;
+- (BOOL)validateCachedResponse:(Connexion *)connexion :(NSHTTPURLResponse *)response;
+- (void)cacheResponse:(Connexion *)connexion;
+- (void)invalidateCacheForAction:(NSInteger)actionCode;
+- (void)clearResponseCache;
 
 // Log Stream Methods
 - (void)startLogging:(NSString *)deviceID;
 - (void)startLogging:(NSString *)deviceID :(id)someObject;
 - (void)addDeviceToLogStream:(NSString *)deviceID :(id)someObject;
+- (void)subscribeDevice:(NSString *)deviceID :(id)someObject :(LogStream *)stream;
 - (void)stopLogging:(NSString *)deviceID;
 - (void)stopLogging:(NSString *)deviceID :(id)someObject;
-- (void)restartLogging;
-- (void)startStream;
-- (void)openStream;
+- (void)restartLogging:(LogStream *)stream;
+- (void)startStream:(LogStream *)stream;
+- (void)openStream:(LogStream *)stream;
+- (void)reopenStream:(LogStream *)stream;
+- (void)streamDropped:(Connexion *)connexion :(NSError *)error;
 - (void)closeStream;
+- (void)closeStream:(LogStream *)stream;
+- (void)logRequestFailed:(Connexion *)connexion;
 - (void)dispatchEvent:(LogStreamEvent *)event;
 - (void)processEvent:(LogStreamEvent *)event;
 - (void)relayLogEntry:(NSDictionary *)entry;
-- (void)logOpened;
+- (void)queueLogEntry:(NSString *)entry;
+- (void)flushLogBatch;
+- (void)logBatchDelivered:(NSUInteger)count;
+- (void)logOpened:(LogStream *)stream;
 - (void)logClosed:(NSDictionary *)error;
 - (BOOL)isDeviceLogging:(NSString *)deviceID;
 - (NSInteger)indexOfLoggedDevice:(NSString *)deviceID;
+- (LogStream *)logStreamForDevice:(NSString *)deviceID;
+
+// Device Timeline Methods
+- (DeviceTimeline *)timelineForDevice:(NSString *)deviceID;
+- (DeviceTimeline *)timelineForRequest:(Connexion *)connexion;
+- (NSString *)addTimelinePage:(NSMutableArray *)pending :(NSDictionary *)data :(NSString *)cursor :(NSSet *)cursorKeys;
+- (NSArray *)newTimelineEntries:(NSArray *)entries :(NSString *)cursor :(NSSet *)cursorKeys;
+- (NSArray *)mergeTimelineEntries:(DeviceTimeline *)timeline :(BOOL)isHistory;
+- (void)addTimelineEntries:(NSArray *)entries :(RingBuffer *)buffer;
+- (void)addStreamedLogEntry:(NSString *)message;
+- (NSArray *)sortTimelineEntries:(NSArray *)entries;
+- (NSString *)timestampOfEntry:(NSDictionary *)entry;
+- (id)keyOfEntry:(NSDictionary *)entry;
+- (NSArray *)timelineLogs:(NSString *)deviceID;
+- (NSArray *)timelineHistory:(NSString *)deviceID;
+- (void)clearTimeline:(NSString *)deviceID;
+- (void)setTimelineCapacity:(NSUInteger)capacity;
 
 // Connection Result Processing Methods
 - (void)parseStreamData:(NSData *)data :(Connexion *)connexion;
+- (void)completeConnexion:(Connexion *)connexion :(NSDictionary *)result;
 - (NSDictionary *)processConnection:(Connexion *)connexion;
+- (NSDictionary *)processConnection:(Connexion *)connexion :(id)parsedData :(NSError *)dataDecodeError;
+- (void)notifyListPage:(Connexion *)connexion :(NSDictionary *)data;
 - (void)processResult:(Connexion *)connexion :(NSDictionary *)data;
 
 // Utility Methods
@@ -212,7 +417,7 @@
 
 // Properties
 
-@property (nonatomic, strong) NSString *currentAccount;
+@property (nonatomic, strong, setter=setCurrentAccount:) NSString *currentAccount;
 @property (nonatomic, strong) NSString *errorMessage;
 @property (nonatomic, strong) NSString *statusMessage;
 @property (nonatomic, readonly) NSUInteger numberOfConnections;
@@ -221,6 +426,33 @@
 @property (nonatomic, readwrite) NSUInteger maxListCount;
 @property (nonatomic, readonly) BOOL isLoggedIn;
 @property (nonatomic, readwrite, setter=setPageSize:) NSInteger pageSize;
+@property (nonatomic, readwrite, setter=setPagePrefetchLimit:) NSUInteger pagePrefetchLimit;
+@property (nonatomic, readwrite, setter=setLogBatchInterval:) NSTimeInterval logBatchInterval;
+@property (nonatomic, readwrite) NSUInteger logBatchSize;
+@property (nonatomic, readwrite) NSUInteger logQueueLimit;
+@property (nonatomic, readwrite) NSInteger logOverflowPolicy;
+@property (nonatomic, readonly) NSUInteger logEntriesDropped;
+@property (nonatomic, readwrite) BOOL acknowledgeLogBatches;
+@property (nonatomic, readwrite, setter=setMaxConcurrentConnections:) NSUInteger maxConcurrentConnections;
+@property (nonatomic, readwrite) NSUInteger maxQueuedConnections;
+@property (nonatomic, readwrite) NSTimeInterval responseCacheLifetime;
+@property (nonatomic, readwrite) BOOL useResponseCache;
+@property (nonatomic, readwrite) BOOL coalesceReads;
+@property (nonatomic, readwrite) BOOL notifyListPages;
+@property (nonatomic, readwrite, strong, setter=setProcessingQueue:) dispatch_queue_t processingQueue;
+@property (nonatomic, readwrite, setter=setCollectMetrics:) BOOL collectMetrics;
+@property (nonatomic, readwrite, setter=setMetricsExportInterval:) NSTimeInterval metricsExportInterval;
+@property (nonatomic, readwrite, setter=setUseFleetMirror:) BOOL useFleetMirror;
+@property (nonatomic, readwrite, setter=setMirrorSyncInterval:) NSTimeInterval mirrorSyncInterval;
+@property (nonatomic, readwrite, strong) NSString *snapshotPath;
+@property (nonatomic, readwrite, setter=setTimelineCapacity:) NSUInteger timelineCapacity;
+@property (nonatomic, readwrite, strong) NSDictionary *listFields;
+@property (nonatomic, readwrite) BOOL useCompactRecords;
+@property (nonatomic, readwrite) BOOL retryReads;
+@property (nonatomic, readwrite) NSUInteger maxRetries;
+@property (nonatomic, readwrite) BOOL hedgeReads;
+@property (nonatomic, readwrite) double hedgePercentile;
+@property (nonatomic, readwrite, weak, setter=setSessionPool:) SessionPool *sessionPool;
 
 
 @end
@@ -25,6 +25,8 @@
 
 
 #import "BuildAPIAccess.h"
+#import <fcntl.h>
+#import <unistd.h>
 
 
 @implementation BuildAPIAccess
@@ -32,7 +34,13 @@
 
 
 @synthesize errorMessage, statusMessage, isLoggedIn, pageSize, currentAccount;
-@synthesize numberOfConnections, numberOfLogStreams, maxListCount, impCloudCode;
+@synthesize numberOfConnections, numberOfLogStreams, maxListCount, impCloudCode, pagePrefetchLimit;
+@synthesize logBatchInterval, logBatchSize, logQueueLimit, logOverflowPolicy, logEntriesDropped, acknowledgeLogBatches;
+@synthesize maxConcurrentConnections, maxQueuedConnections, useResponseCache, responseCacheLifetime, coalesceReads;
+@synthesize notifyListPages, processingQueue, collectMetrics, metricsExportInterval;
+@synthesize useFleetMirror, mirrorSyncInterval, snapshotPath, timelineCapacity;
+@synthesize listFields, useCompactRecords;
+@synthesize retryReads, maxRetries, hedgeReads, hedgePercentile, sessionPool;
 
 
 
@@ -45,8 +53,35 @@
     {
         // The list of connections should be instantiated immediately...
 
-        connexions = [[NSMutableArray alloc] init];
-        pendingConnections = nil;
+        connexions = [[NSMutableDictionary alloc] init];
+
+        // Request scheduling
+
+        connexionQueues = nil;
+        scheduleTimer = nil;
+        maxConcurrentConnections = kConnectConcurrentDefault;
+        maxQueuedConnections = kConnectQueueMaxDefault;
+        rateLimitCapacity = 0;
+        rateLimitTokens = 0;
+        rateLimitWindow = 0;
+        rateLimitRefillTime = 0;
+        rateLimitResumeTime = 0;
+
+        // Response cache. On by default because it holds only single resources, never list pages
+
+        responseCache = nil;
+        cacheGeneration = 0;
+        useResponseCache = YES;
+        responseCacheLifetime = kResponseCacheLifetimeDefault;
+
+        // Request coalescing
+
+        coalescedReads = nil;
+        coalesceReads = YES;
+
+        // Per-page list notifications
+
+        notifyListPages = NO;
 
         // impCentral API returned data lists
 
@@ -55,41 +90,106 @@
         loggingDevices = nil;
         deployments = nil;
         devicegroups = nil;
-        history = nil;
-        logs = nil;
+
+        // Device log and history timelines
+
+        timelines = nil;
+        timelineCapacity = kTimelineCapacityDefault;
 
         // Message-handling Operation Queue
 
         eventQueue = nil;
 
+        // Metrics
+
+        metrics = nil;
+        metricsTimer = nil;
+        metricsStartTime = 0;
+        metricsExportInterval = kMetricsExportIntervalDefault;
+        collectMetrics = NO;
+
+        // Fleet mirror
+
+        fleetMirror = nil;
+        mirrorSyncTimer = nil;
+        mirrorSyncInterval = kFleetMirrorSyncIntervalDefault;
+        useFleetMirror = NO;
+
+        // Snapshot
+
+        snapshotPath = nil;
+        snapshotQueue = dispatch_queue_create("BuildAPIAccess.snapshot", DISPATCH_QUEUE_SERIAL);
+        snapshotTimer = nil;
+        snapshotAccount = nil;
+        snapshotCloudCode = -1;
+
+        // Retries and hedged reads
+
+        retryReads = YES;
+        maxRetries = kRetryMaxDefault;
+        retryBudget = kRetryBudgetMax;
+        retryingConnexions = nil;
+        hedgeReads = NO;
+        hedgePercentile = kHedgePercentileDefault;
+        latencyHistory = nil;
+
+        // Session pool (nil for the instance's own session)
+
+        sessionPool = nil;
+
+        // Compact records
+
+        listFields = nil;
+        recordDecoder = [[CompactRecordDecoder alloc] init];
+        useCompactRecords = NO;
+
+        // Processing queue (nil for the main queue)
+
+        processingQueue = nil;
+        delegateQueue = nil;
+        lastError = nil;
+
         // Account
 
         username = nil;
         password = nil;
         tokenConnexion = nil;
+        tokenRefreshTimer = nil;
 
         // Logging
 
-        logConnexions = nil;
-        logConnexion = nil;
-        logStreamID = nil;
-        logStreamURL = nil;
+        logStreams = nil;
         logTimeout = kLogTimeout;
         logRetryInterval = klogRetryInterval;
-        logIsClosed = YES;
         maxListCount = kMaxHistoricalLogs;
 
+        // Log entry batching
+
+        logBatch = nil;
+        logBatchTimer = nil;
+        logBatchInterval = kLogBatchIntervalDefault;
+        logBatchSize = kLogBatchSizeDefault;
+        logQueueLimit = kLogQueueLimitDefault;
+        logOverflowPolicy = kLogOverflowPolicyDrop;
+        logBatchDropped = 0;
+        logEntriesDropped = 0;
+        logEntriesDelivering = 0;
+        logStreamsBlocked = NO;
+        acknowledgeLogBatches = NO;
+
         // Misc
 
         errorMessage = @"";
         isLoggedIn = NO;
         useTwoFactor = NO;
+        useCustomEndpoint = NO;
         impCloudCode = -1;
 
         // Pagination
 
         pageSize = kPaginationDefault;
         pageSizeChangeFlag = YES;
+        pagePrefetchLimit = kPagePrefetchDefault;
         baseURL = [kBaseAPIURL stringByAppendingString:kAPIVersion];
 
         // User Agent for impCentral API requests
@@ -126,6 +226,14 @@
     // RETURNS
     //   Nothing
 
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self login:userName :passWord :cloudCode]; }];
+        return;
+    }
+
     if ((userName == nil || userName.length == 0) && (passWord == nil || passWord.length == 0))
     {
         errorMessage = @"Could not log in to the Electric Imp impCloud — no username/email address and password.";
@@ -156,15 +264,20 @@
     // ie. confirmed that we're logging in to the correct cloud
 
     tempImpCloudCode = cloudCode;
-    
-    switch (cloudCode)
+
+    // Select the cloud's API server, unless the host has chosen one with 'setEndpoint:'
+
+    if (!useCustomEndpoint)
     {
-        case kImpCloudTypeAzure:
-            baseURL = [kAzureAPIURL stringByAppendingString:kAPIVersion];
-            break;
-            
-        default:
-            baseURL = [kBaseAPIURL stringByAppendingString:kAPIVersion];
+        switch (cloudCode)
+        {
+            case kImpCloudTypeAzure:
+                baseURL = [kAzureAPIURL stringByAppendingString:kAPIVersion];
+                break;
+
+            default:
+                baseURL = [kBaseAPIURL stringByAppendingString:kAPIVersion];
+        }
     }
 
     // Attempt to get a new access token using the credentials provided
@@ -276,10 +389,36 @@
 
 - (BOOL)isAccessTokenValid
 {
-    // No token available; return BAD TOKEN
+    // Returns YES if we have an access token that can still be used. The token's expiry is
+    // converted once to a deadline on the system clock, so this is cheap to call for every request
+    // NOTE the token is refreshed in the background before it expires (see 'scheduleTokenRefresh'),
+    //      so requests only wait for a new token if it could not be refreshed in time
 
     if (token == nil) return NO;
 
+    if (!token.hasExpiryTime) [self cacheTokenExpiry];
+
+    return ([NSProcessInfo processInfo].systemUptime < token.expiryTime - kTokenExpiryMargin);
+}
+
+
+
+- (void)cacheTokenExpiry
+{
+    // Record when the access token expires as a deadline on the system clock, which, unlike
+    // the wall clock, is not affected by changes to the date and time. Use the token's lifetime
+    // if the server gave it, otherwise its expiry date
+
+    NSTimeInterval now = [NSProcessInfo processInfo].systemUptime;
+
+    token.hasExpiryTime = YES;
+
+    if (token.lifetime > 0)
+    {
+        token.expiryTime = now + token.lifetime;
+        return;
+    }
+
     if (dateFormatter == nil)
     {
         dateFormatter = [[NSDateFormatter alloc] init];
@@ -287,49 +426,70 @@
         dateFormatter.timeZone = [NSTimeZone timeZoneWithAbbreviation:@"UTC"];
     }
 
-    NSDate *expiry = [dateFormatter dateFromString:token.expiryDate];
-    NSDate *deltaExpiry = [NSDate dateWithTimeInterval:-240 sinceDate:expiry];
-    NSDate *now = [NSDate date];
+    NSDate *expiry = token.expiryDate.length > 0 ? [dateFormatter dateFromString:token.expiryDate] : nil;
 
-#ifdef DEBUG
-    //NSLog(@"      Expiry: %@", [dateFormatter stringFromDate:expiry]);
-    //NSLog(@"Expiry Delta: %@", [dateFormatter stringFromDate:deltaExpiry]);
-    //NSLog(@"         Now: %@", [dateFormatter stringFromDate:now]);
-#endif
+    // A token whose expiry can't be read is treated as already expired, so that a new one is obtained
+    // before the next request is sent (the expiry date is not re-read every time)
 
-    NSDate *latest = [now laterDate:expiry];
+    token.expiryTime = expiry != nil ? now + expiry.timeIntervalSinceNow : now;
 
-    if (now == latest)
-    {
 #ifdef DEBUG
-    //NSLog(@"              EXPIRED");
+    NSLog(@"Token expires in: %.0fs", token.expiryTime - now);
 #endif
+}
 
-        // Return BAD TOKEN
 
-        return NO;
-    }
 
-    latest = [now laterDate:deltaExpiry];
+- (void)scheduleTokenRefresh
+{
+    // Set a timer to refresh the access token 'kTokenRefreshLead' seconds before it expires, so that
+    // a new token has been received before the current one is no longer accepted. Requests continue
+    // to be made with the current token in the meantime
 
-    if (now == latest)
-    {
-#ifdef DEBUG
-    //NSLog(@"              ABOUT TO EXPIRE");
-#endif
+    [self cancelTimer:tokenRefreshTimer];
+    tokenRefreshTimer = nil;
 
-        // Return BAD TOKEN
+    if (token == nil || !isLoggedIn) return;
 
-        return NO;
-    }
+    if (!token.hasExpiryTime) [self cacheTokenExpiry];
 
-#ifdef DEBUG
-    //NSLog(@"              NOT EXPIRED");
-#endif
+    NSTimeInterval delay = token.expiryTime - kTokenRefreshLead - [NSProcessInfo processInfo].systemUptime;
 
-    // Return GOOD TOKEN
+    // Don't refresh more often than every 'kTokenRefreshRetry' seconds, eg. if the token is short-lived
 
-    return YES;
+    if (delay < kTokenRefreshRetry) delay = kTokenRefreshRetry;
+
+    tokenRefreshTimer = [self makeTimer:delay :^{
+        [self refreshTokenInBackground];
+    }];
+}
+
+
+
+- (void)refreshTokenInBackground
+{
+    // Called by the token refresh timer: request a new access token unless a request is already in flight
+
+    [self cancelTimer:tokenRefreshTimer];
+    tokenRefreshTimer = nil;
+
+    if (token == nil || !isLoggedIn || tokenConnexion != nil) return;
+
+    [self refreshAccessToken:(token.loginKey.length > 0 ? token.loginKey : nil)];
+}
+
+
+
+- (void)tokenRequestFailed:(Connexion *)connexion
+{
+    // An access token request has failed (the error will already have been reported). Allow
+    // another to be made, and if the current token is still good, try again a little later
+
+    if (connexion != tokenConnexion) return;
+
+    tokenConnexion = nil;
+
+    if (isLoggedIn && [self isAccessTokenValid]) [self scheduleTokenRefresh];
 }
 
 
@@ -349,12 +509,34 @@
 {
     // To logout just clear the stored session data and cancel any remaining connections
 
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self logout]; }];
+        return;
+    }
+
     [self killAllConnections];
+    [self clearResponseCache];
+
+    [self cancelTimer:tokenRefreshTimer];
+    tokenRefreshTimer = nil;
 
     token = nil;
     isLoggedIn = NO;
     impCloudCode = -1;
 
+    [fleetMirror clear];
+    [timelines removeAllObjects];
+    [recordDecoder clear];
+
+    // The snapshot holds the token, so it must not outlive the session
+
+    [self deleteSnapshot];
+    snapshotAccount = nil;
+    snapshotCloudCode = -1;
+
     [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPILoggedOut" object:nil];
 }
 
@@ -394,9 +576,20 @@
 {
     // Change the API's base URL: server address plus version
     // eg. api.electricimp.com/v5/
-    
-    baseURL = pathWithVersion;
-    
+    // The URL may use HTTP, eg. for a local server standing in for impCentral.
+    // Pass nil to restore the default, ie. the server of the cloud logged in to
+
+    if (pathWithVersion == nil || pathWithVersion.length == 0)
+    {
+        baseURL = [kBaseAPIURL stringByAppendingString:kAPIVersion];
+        useCustomEndpoint = NO;
+    }
+    else
+    {
+        baseURL = pathWithVersion;
+        useCustomEndpoint = YES;
+    }
+
     // Append a slash to the base URL if there isn't one
     
     if (![baseURL hasSuffix:@"/"]) baseURL = [baseURL stringByAppendingString:@"/"];
@@ -453,6 +646,14 @@
     // will add a URL query code specifying the required page size
     // Default is 20
 
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self setPageSize:size]; }];
+        return;
+    }
+
     if (size < 1) size = 1;
     if (size > 100) size = 100;
     if (pageSize != size)
@@ -464,6 +665,18 @@
 
 
 
+- (void)setPagePrefetchLimit:(NSUInteger)limit
+{
+    // Sets the maximum number of pages of a list that will be requested concurrently once
+    // the first page has told us how many pages there are. 0 or 1 disables page prefetching,
+    // ie. pages are requested one at a time. Default is 0
+
+    if (limit > kPagePrefetchMax) limit = kPagePrefetchMax;
+    pagePrefetchLimit = limit;
+}
+
+
+
 - (BOOL)isFirstPage:(NSDictionary *)links
 {
     // Checks the 'links' dictionary returned by the server and responds YES or NO
@@ -519,14 +732,194 @@
     // Strips the non-query content out of the supplied URL, or
     // returns an empty string if 'url' is nil or empty - what's
     // returned is added to a full URL by the calling method
-    // NOTE AWS and Azure URLs have different length, hence the 31 and 33
+    // NOTE AWS and Azure URLs have different length, hence the 31 and 33. Links from
+    //      any other server, eg. one set with 'setEndpoint:', are stripped of the base URL
 
     if (url == nil || url.length == 0) return @"";
+    if ([url hasPrefix:baseURL]) return [url substringFromIndex:baseURL.length];
     return [url substringFromIndex:(impCloudCode == 0 ? 31 : 33)];
 }
 
 
 
+- (NSRange)rangeOfPageNumber:(NSString *)link
+{
+    // Returns the range of the page number within a page link, eg. the '2' in
+    // '.../devices?page[number]=2&page[size]=20', or { NSNotFound, 0 } if there isn't one
+    // NOTE the link's square brackets may or may not be percent-encoded
+
+    if (link == nil || link.length == 0) return NSMakeRange(NSNotFound, 0);
+
+    // This is called for every page of every list, so compile the expression once
+
+    static NSRegularExpression *regex = nil;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^{
+        regex = [NSRegularExpression regularExpressionWithPattern:@"page(?:\\[|%5B)number(?:\\]|%5D)=([0-9]+)"
+                                                          options:NSRegularExpressionCaseInsensitive
+                                                            error:nil];
+    });
+
+    NSTextCheckingResult *match = [regex firstMatchInString:link options:0 range:NSMakeRange(0, link.length)];
+
+    return match != nil ? [match rangeAtIndex:1] : NSMakeRange(NSNotFound, 0);
+}
+
+
+
+- (BOOL)fetchRemainingPages:(Connexion *)connexion :(NSDictionary *)data :(NSMutableArray *)array
+{
+    // Called when a page of a list has been received and there are more to come. If page prefetching
+    // is enabled, this is the first page and the server has told us which is the last page, request
+    // all of the remaining pages concurrently and return YES. Otherwise return NO so that the caller
+    // can fall back to requesting the next page only
+    // PARAMETERS:
+    //   'connexion' is the connexion which retrieved the first page
+    //   'data' is the decoded first page
+    //   'array' is the master array to which the first page has been added
+    // RETURNS:
+    //   YES if the remaining pages have been requested, otherwise NO
+
+    if (pagePrefetchLimit < 2) return NO;
+
+    NSDictionary *links = [data objectForKey:@"links"];
+
+    if (![self isFirstPage:links]) return NO;
+
+    NSString *nextLink = [self nextPageLink:links];
+    NSString *lastLink = [links objectForKey:@"last"];
+    NSRange nextRange = [self rangeOfPageNumber:nextLink];
+    NSRange lastRange = [self rangeOfPageNumber:lastLink];
+
+    // No page count from the server? Then we can only proceed page by page
+
+    if (nextRange.location == NSNotFound || lastRange.location == NSNotFound) return NO;
+    if ([[nextLink substringWithRange:nextRange] integerValue] != 2) return NO;
+
+    NSInteger lastPage = [[lastLink substringWithRange:lastRange] integerValue];
+
+    if (connexion.actionCode == kConnectTypeGetDeployments || connexion.actionCode == kConnectTypeGetDeviceHistory)
+    {
+        // These lists are capped at 'maxListCount' entries, so don't request pages we won't need
+
+        NSInteger perPage = [[data objectForKey:@"data"] count];
+
+        if (perPage > 0)
+        {
+            NSInteger maxPages = ((NSInteger)maxListCount + perPage - 1) / perPage;
+            if (lastPage > maxPages) lastPage = maxPages;
+        }
+    }
+
+    if (lastPage < 2) return NO;
+
+    PagedList *pagedList = [[PagedList alloc] init];
+    pagedList.list = array;
+    pagedList.actionCode = connexion.actionCode;
+    pagedList.representedObject = connexion.representedObject;
+    pagedList.followers = connexion.followers;
+    pagedList.urlHead = [nextLink substringToIndex:nextRange.location];
+    pagedList.urlTail = [nextLink substringFromIndex:(nextRange.location + nextRange.length)];
+    pagedList.lastPage = lastPage;
+    pagedList.nextPage = 2;
+    pagedList.pages = [[NSMutableArray alloc] initWithCapacity:lastPage];
+
+    for (NSInteger i = 0 ; i < lastPage ; ++i) [pagedList.pages addObject:[NSNull null]];
+
+    // Page 1 is already in 'array', so request as many of the others as we can right now
+
+    while (pagedList.nextPage <= pagedList.lastPage && pagedList.pagesOutstanding < pagePrefetchLimit) [self launchPageRequest:pagedList];
+
+    // Callers sharing the first page are notified when the list is complete
+
+    if (pagedList.pagesOutstanding > 0) connexion.followers = nil;
+
+    return (pagedList.pagesOutstanding > 0);
+}
+
+
+
+- (BOOL)launchPageRequest:(PagedList *)pagedList
+{
+    // Request the next unrequested page of a list being retrieved concurrently
+
+    NSInteger page = pagedList.nextPage;
+    pagedList.nextPage = page + 1;
+
+    NSString *url = [NSString stringWithFormat:@"%@%li%@", pagedList.urlHead, (long)page, pagedList.urlTail];
+    NSMutableURLRequest *request = [self makeGETrequest:[self getNextURL:url] :NO];
+
+    if (request == nil)
+    {
+        // Record the page as empty so that the list can still be completed
+
+        [pagedList.pages replaceObjectAtIndex:(page - 1) withObject:@[]];
+        pagedList.pagesFailed += 1;
+        return NO;
+    }
+
+    Connexion *connexion = [self launchConnection:request :pagedList.actionCode :pagedList.representedObject];
+    connexion.pagedList = pagedList;
+    connexion.pageNumber = page;
+
+    pagedList.pagesOutstanding += 1;
+    return YES;
+}
+
+
+
+- (BOOL)addPageToPagedList:(Connexion *)connexion :(NSDictionary *)data
+{
+    // Record a page received as part of a concurrently retrieved list and request the next outstanding
+    // page, if there is one. Once every page has been received, add them to the master array in page order
+    // RETURNS:
+    //   YES if the list is complete, otherwise NO
+
+    PagedList *pagedList = connexion.pagedList;
+    NSArray *page = [data objectForKey:@"data"];
+
+    [pagedList.pages replaceObjectAtIndex:(connexion.pageNumber - 1) withObject:(page != nil ? page : @[])];
+
+    connexion.pagedList = nil;
+    pagedList.pagesOutstanding -= 1;
+
+    NSInteger limit = pagePrefetchLimit > 1 ? pagePrefetchLimit : 1;
+
+    while (pagedList.nextPage <= pagedList.lastPage && pagedList.pagesOutstanding < limit) [self launchPageRequest:pagedList];
+
+    if (pagedList.pagesOutstanding > 0) return NO;
+
+    // The list is complete, so restore any callers sharing it to be notified
+
+    connexion.followers = pagedList.followers;
+    connexion.isPartialList = (pagedList.pagesFailed > 0);
+
+    // Page 1 was added to the master array when it was received
+
+    for (NSUInteger i = 1 ; i < pagedList.pages.count ; ++i)
+    {
+        id aPage = [pagedList.pages objectAtIndex:i];
+        if ([aPage isKindOfClass:[NSArray class]]) [pagedList.list addObjectsFromArray:aPage];
+    }
+
+    return YES;
+}
+
+
+
+- (void)pageFailed:(Connexion *)connexion
+{
+    // A page of a concurrently retrieved list could not be retrieved (the error will already have been
+    // reported). Record it as an empty page so that the rest of the list can still be relayed to the host
+
+    connexion.actionCode = connexion.pagedList.actionCode;
+    connexion.pagedList.pagesFailed += 1;
+    [self processResult:connexion :@{ @"data" : @[] }];
+}
+
+
+
 #pragma mark - Data Request Methods
 
 
@@ -1876,7 +2269,8 @@
 
 - (void)unassignDevices:(NSArray *)devices :(id)someObject
 {
-    // Set up a DELETE to /devicegroups/{id}/relationships/devices
+    // Set up a DELETE to /devicegroups/{id}/relationships/devices for each device group the devices
+    // are assigned to. The devices are grouped by the device group listed in their records
     // 'devices' is an array of standard device records
 
     if (devices == nil || devices.count == 0)
@@ -1886,15 +2280,25 @@
         return;
     }
 
-    NSMutableArray *array = [[NSMutableArray alloc] init];
-    NSString *groupid;
+    NSMutableDictionary *groups = [[NSMutableDictionary alloc] init];
+    NSMutableArray *groupIDs = [[NSMutableArray alloc] init];
+    NSUInteger unknown = 0;
 
-    for (NSDictionary *device in devices)
+    for (id device in devices)
     {
-        NSDictionary *relationships = [device objectForKey:@"relationships"];
-        NSDictionary *dg = [relationships objectForKey:@"devicegroup"];
+        NSString *did = [device isKindOfClass:[NSDictionary class]] ? [self idOfDevice:device] : nil;
+
+        if (did == nil)
+        {
+            // Without a device record we can't tell which device group to unassign the device from
+
+            ++unknown;
+            continue;
+        }
+
+        NSString *dgid = [self devicegroupOfDevice:device];
 
-        if (dg == nil)
+        if (dgid == nil)
         {
             // If there is no devicegroup set for the device, it is unassigned
             // This is not an error, so we replicate the post-unassignment process to inform the host app
@@ -1906,53 +2310,56 @@
             : @{ @"data" : @"already unassigned" };
 
             [nc postNotificationName:@"BuildAPIDeviceUnassigned" object:dict];
+            continue;
         }
-        else
-        {
-            NSString *dgid = [dg objectForKey:@"id"];
-
-            NSDictionary *dict = @{ @"type" : @"device",
-                                @"id" : [device objectForKey:@"id"] };
-
-            if (groupid == nil)
-            {
-                // Store the first device group ID on the list
-                // This will be used for all further devices on the list
-
-                groupid = dgid;
 
-            }
+        NSMutableArray *group = [groups objectForKey:dgid];
 
-            if ([groupid compare:dgid] == NSOrderedSame)
-            {
-                // Add the device info to the data array
+        if (group == nil)
+        {
+            // Keep the device groups in the order they were first listed
 
-                [array addObject:dict];
-            }
+            group = [[NSMutableArray alloc] init];
+            [groups setObject:group forKey:dgid];
+            [groupIDs addObject:dgid];
         }
-    }
-
-    NSDictionary *dict = @{ @"data" : [NSArray arrayWithArray:array] };
-    NSError *error;
-    NSMutableURLRequest *request = [self makeRequest:@"DELETE" :[NSString stringWithFormat:@"/devicegroups/%@/relationships/devices", groupid] :YES :NO];
 
-    [request setHTTPBody:[NSJSONSerialization dataWithJSONObject:dict options:0 error:&error]];
+        [group addObject:@{ @"type" : @"device", @"id" : did }];
+    }
 
-    if (error)
+    if (unknown > 0)
     {
-        errorMessage = @"Could not create a request to unassign the devices: bad JSON data.";
+        errorMessage = [NSString stringWithFormat:@"Could not unassign %lu device(s): a device record is required to unassign a device.", (unsigned long)unknown];
         [self reportError];
-        return;
     }
 
-    if (request)
-    {
-        [self launchConnection:request :kConnectTypeUnassignDevices :someObject];
-    }
-    else
+    // Unassign each device group's devices with a request of its own
+
+    for (NSString *dgid in groupIDs)
     {
-        errorMessage = @"Could not create a request to unassign the device: bad request.";
-        [self reportError];
+        NSDictionary *dict = @{ @"data" : [groups objectForKey:dgid] };
+        NSError *error = nil;
+        NSData *body = [NSJSONSerialization dataWithJSONObject:dict options:0 error:&error];
+
+        if (error != nil || body == nil)
+        {
+            errorMessage = @"Could not create a request to unassign the devices: bad JSON data.";
+            [self reportError];
+            continue;
+        }
+
+        NSMutableURLRequest *request = [self makeRequest:@"DELETE" :[NSString stringWithFormat:@"/devicegroups/%@/relationships/devices", dgid] :YES :NO];
+
+        if (request)
+        {
+            [request setHTTPBody:body];
+            [self launchConnection:request :kConnectTypeUnassignDevices :someObject];
+        }
+        else
+        {
+            errorMessage = @"Could not create a request to unassign the device: bad request.";
+            [self reportError];
+        }
     }
 }
 
@@ -2314,781 +2721,4821 @@
 
 
 
-#pragma mark - HTTP Request Construction Methods
+#pragma mark - Bulk Device Methods
 
 
-- (NSMutableURLRequest *)makeGETrequest:(NSString *)path :(BOOL)getMultipleItems
+- (void)bulkAssignDevices:(NSArray *)devices :(NSString *)devicegroupID
 {
-    return [self makeRequest:@"GET" :path :NO : getMultipleItems];
+    [self bulkAssignDevices:devices :devicegroupID :nil];
 }
 
 
 
-- (NSMutableURLRequest *)makeDELETErequest:(NSString *)path
+- (void)bulkAssignDevices:(NSArray *)devices :(NSString *)devicegroupID :(id)someObject
 {
-    return [self makeRequest:@"DELETE" :path :NO :NO];
+    // Assign any number of devices to the specified device group, 'kBulkChunkMax' devices per request
+    // PARAMETERS:
+    //   'devices' is an array of standard device records and/or device IDs
+    //   'devicegroupID' is the ID of the target device group
+    //   'someObject' is an optional object, supplied by the host app, that is bound to this request
+    //                and follows it through sending and processing the response from the server
+    // RETURNS:
+    //   Nothing
+
+    if (devices == nil || devices.count == 0)
+    {
+        errorMessage = @"Could not create a request to assign devices: no devices specified.";
+        [self reportError];
+        return;
+    }
+
+    if (devicegroupID == nil || devicegroupID.length == 0)
+    {
+        errorMessage = @"Could not create a request to assign devices: no device group specified.";
+        [self reportError];
+        return;
+    }
+
+    BulkOperation *bulk = [self makeBulkOperation:kBulkOperationAssign :devices.count :someObject];
+    NSMutableArray *deviceIDs = [[NSMutableArray alloc] init];
+
+    for (id device in devices)
+    {
+        NSString *did = [self idOfDevice:device];
+
+        if (did == nil) continue;
+
+        if ([[self devicegroupOfDevice:device] isEqualToString:devicegroupID])
+        {
+            // Device is already assigned to this device group - this is not an error
+
+            [bulk.succeeded addObject:did];
+            continue;
+        }
+
+        [deviceIDs addObject:did];
+    }
+
+    [self addBulkChunks:bulk :@"POST" :[NSString stringWithFormat:@"/devicegroups/%@/relationships/devices", devicegroupID] :deviceIDs];
+    [self startBulkOperation:bulk];
 }
 
 
 
-- (NSMutableURLRequest *)makePOSTrequest:(NSString *)path :(NSDictionary *)body
+- (void)bulkUnassignDevices:(NSArray *)devices
 {
-    NSError *error = nil;
-    NSMutableURLRequest *request = [self makeRequest:@"POST" :path :YES :NO];
-
-    if (body != nil) [request setHTTPBody:[NSJSONSerialization dataWithJSONObject:body options:0 error:&error]];
-    if (error != nil) return nil;
-    return request;
+    [self bulkUnassignDevices:devices :nil];
 }
 
 
 
-- (NSMutableURLRequest *)makePATCHrequest:(NSString *)path :(NSDictionary *)body
+- (void)bulkUnassignDevices:(NSArray *)devices :(id)someObject
 {
-    NSError *error = nil;
-    NSMutableURLRequest *request = [self makeRequest:@"PATCH" :path :YES :NO];
+    // Unassign any number of devices from whichever device groups they are assigned to. Devices are
+    // grouped by device group, and each group's devices unassigned 'kBulkChunkMax' devices per request
+    // PARAMETERS:
+    //   'devices' is an array of standard device records
+    //   'someObject' is an optional object, supplied by the host app, that is bound to this request
+    //                and follows it through sending and processing the response from the server
+    // RETURNS:
+    //   Nothing
 
-    if (body != nil) [request setHTTPBody:[NSJSONSerialization dataWithJSONObject:body options:0 error:&error]];
-    if (error != nil) return nil;
-    return request;
+    if (devices == nil || devices.count == 0)
+    {
+        errorMessage = @"Could not create a request to unassign devices: no devices specified.";
+        [self reportError];
+        return;
+    }
+
+    BulkOperation *bulk = [self makeBulkOperation:kBulkOperationUnassign :devices.count :someObject];
+    NSMutableDictionary *groups = [[NSMutableDictionary alloc] init];
+
+    for (id device in devices)
+    {
+        NSString *did = [self idOfDevice:device];
+
+        if (did == nil) continue;
+
+        if (![device isKindOfClass:[NSDictionary class]])
+        {
+            // A bare device ID does not say which device group to unassign the device from
+
+            [bulk.failed setObject:@"A device record is required to unassign a device" forKey:did];
+            continue;
+        }
+
+        NSString *dgid = [self devicegroupOfDevice:device];
+
+        if (dgid == nil)
+        {
+            // The device is already unassigned - this is not an error
+
+            [bulk.succeeded addObject:did];
+            continue;
+        }
+
+        NSMutableArray *group = [groups objectForKey:dgid];
+
+        if (group == nil)
+        {
+            group = [[NSMutableArray alloc] init];
+            [groups setObject:group forKey:dgid];
+        }
+
+        [group addObject:did];
+    }
+
+    for (NSString *dgid in groups)
+    {
+        [self addBulkChunks:bulk :@"DELETE" :[NSString stringWithFormat:@"/devicegroups/%@/relationships/devices", dgid] :[groups objectForKey:dgid]];
+    }
+
+    [self startBulkOperation:bulk];
 }
 
 
 
-- (NSMutableURLRequest *)makePUTrequest:(NSString *)path :(NSDictionary *)body
+- (void)bulkRestartDevices:(NSArray *)devices
 {
-    NSError *error = nil;
-    NSMutableURLRequest *request = [self makeRequest:@"PUT" :path :YES :NO];
-
-    if (body != nil) [request setHTTPBody:[NSJSONSerialization dataWithJSONObject:body options:0 error:&error]];
-    if (error != nil) return nil;
-    return request;
+    [self bulkRestartDevices:devices :nil];
 }
 
 
 
-- (NSMutableURLRequest *)makeRequest:(NSString *)verb :(NSString *)path :(BOOL)addContentType :(BOOL)getMultipleItems
+- (void)bulkRestartDevices:(NSArray *)devices :(id)someObject
 {
-    // Generic HTTP request constructor used by the specific-verb methods, and separately
+    // Restart any number of devices. The impCentral API restarts devices one at a time,
+    // so this makes one request per device
+    // PARAMETERS:
+    //   'devices' is an array of standard device records and/or device IDs
+    //   'someObject' is an optional object, supplied by the host app, that is bound to this request
+    //                and follows it through sending and processing the response from the server
+    // RETURNS:
+    //   Nothing
 
-    if (token == nil || !isLoggedIn)
+    if (devices == nil || devices.count == 0)
     {
-        // We have no access token, so we can't get any data
-
-        errorMessage = @"You must be logged in to access the Electric Imp impCloud™";
+        errorMessage = @"Could not create a request to restart devices: no devices specified.";
         [self reportError];
-        return nil;
+        return;
     }
 
-    if (pageSizeChangeFlag && ([path compare:@"accounts/me"] != NSOrderedSame) && [verb compare:@"GET"] == NSOrderedSame)
+    BulkOperation *bulk = [self makeBulkOperation:kBulkOperationRestart :devices.count :someObject];
+
+    for (id device in devices)
     {
-        // User has changed the page size, so we need to pass this in now to set it
-        // NOTE make sure this is not called when we do a request for the user's account
-        // and that it's not duplicating the encoded string
+        NSString *did = [self idOfDevice:device];
 
-        if (![path containsString:@"?"] && getMultipleItems) path = [path stringByAppendingFormat:@"?page[size]=%li", pageSize];
+        if (did != nil) [bulk.chunks addObject:@{ @"verb" : @"POST",
+                                                  @"path" : [NSString stringWithFormat:@"devices/%@/restart", did],
+                                                  @"devices" : @[ did ] }];
     }
 
-    // Deal with paths that already contain an HTTP mode and domain
+    [self startBulkOperation:bulk];
+}
 
-    if (![path hasPrefix:@"https://"]) path = [baseURL stringByAppendingString:path];
 
-    // Prepare the request
 
-    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:path]];
+- (void)bulkRenameDevices:(NSDictionary *)names
+{
+    [self bulkRenameDevices:names :nil];
+}
 
-    [self setRequestAuthorization:request];
-    [request setValue:userAgent forHTTPHeaderField:@"User-Agent"];
 
-    request.timeoutInterval = kConnectTimeoutInterval;
-    request.HTTPMethod = verb;
 
-    if (addContentType) [request setValue:@"application/vnd.api+json" forHTTPHeaderField:@"Content-Type"];
+- (void)bulkRenameDevices:(NSDictionary *)names :(id)someObject
+{
+    // Rename any number of devices, one request per device
+    // PARAMETERS:
+    //   'names' is a dictionary of new device names keyed by device ID. A zero-length name
+    //           removes the device's name, ie. sets it to the device ID
+    //   'someObject' is an optional object, supplied by the host app, that is bound to this request
+    //                and follows it through sending and processing the response from the server
+    // RETURNS:
+    //   Nothing
 
-    return request;
-}
+    if (names == nil || names.count == 0)
+    {
+        errorMessage = @"Could not create a request to rename devices: no devices specified.";
+        [self reportError];
+        return;
+    }
 
+    BulkOperation *bulk = [self makeBulkOperation:kBulkOperationRename :names.count :someObject];
 
+    for (NSString *did in names)
+    {
+        NSDictionary *data = @{ @"type" : @"device",
+                                @"id" : did,
+                                @"attributes" : @{ @"name" : [names objectForKey:did] } };
 
-- (void)setRequestAuthorization:(NSMutableURLRequest *)request
-{
-    // Applies the stored access token data to the request
-    // NOTE the validity of the accessToken should already have been checked
+        [bulk.chunks addObject:@{ @"verb" : @"PATCH",
+                                  @"path" : [NSString stringWithFormat:@"devices/%@", did],
+                                  @"body" : @{ @"data" : data },
+                                  @"devices" : @[ did ] }];
+    }
 
-    [request setValue:[@"Bearer " stringByAppendingString:token.accessToken] forHTTPHeaderField:@"Authorization"];
-    [request setTimeoutInterval:30.0];
+    [self startBulkOperation:bulk];
 }
 
 
 
-#pragma mark - Connection Methods
+- (void)bulkDeleteDevices:(NSArray *)devices
+{
+    [self bulkDeleteDevices:devices :nil];
+}
 
 
-- (Connexion *)launchConnection:(NSMutableURLRequest *)request :(NSInteger)actionCode :(id)someObject
+
+- (void)bulkDeleteDevices:(NSArray *)devices :(id)someObject
 {
-    // Create a default connexion object to store the details of the connection we're about to initiate
+    // Delete any number of devices, one request per device
     // PARAMETERS:
-    //   'request' is the HTTP request we're making to the API
-    //   'actionCode' is an internal ID indicating what the API is being asked to do
+    //   'devices' is an array of standard device records and/or device IDs
     //   'someObject' is an optional object, supplied by the host app, that is bound to this request
     //                and follows it through sending and processing the response from the server
     // RETURNS:
-    //   A BuildAPIAccess Connexion instance
+    //   Nothing
 
-#ifdef DEBUG
-    NSLog(@"URL: %@", request.URL);
-    NSLog(@"VRB: %@", request.HTTPMethod);
-    NSLog(@"HED: %@", request.allHTTPHeaderFields);
-    NSLog(@"BDY: %@", [[NSString alloc] initWithData:request.HTTPBody encoding:NSUTF8StringEncoding]);
-#endif
-    
-    Connexion *aConnexion = [[Connexion alloc] init];
-    aConnexion.actionCode = actionCode;
-    aConnexion.originalRequest = request;
-    aConnexion.data = [NSMutableData dataWithCapacity:0];
+    if (devices == nil || devices.count == 0)
+    {
+        errorMessage = @"Could not create a request to delete devices: no devices specified.";
+        [self reportError];
+        return;
+    }
 
-    if (someObject) aConnexion.representedObject = someObject;
+    BulkOperation *bulk = [self makeBulkOperation:kBulkOperationDelete :devices.count :someObject];
 
-    // Use NSURLSession for the connection. Compatible with iOS, tvOS and Mac OS X
+    for (id device in devices)
+    {
+        NSString *did = [self idOfDevice:device];
 
-    if (apiSession == nil)
+        if (did != nil) [bulk.chunks addObject:@{ @"verb" : @"DELETE",
+                                                  @"path" : [NSString stringWithFormat:@"devices/%@", did],
+                                                  @"devices" : @[ did ] }];
+    }
+
+    [self startBulkOperation:bulk];
+}
+
+
+
+- (BulkOperation *)makeBulkOperation:(NSInteger)operation :(NSUInteger)total :(id)someObject
+{
+    BulkOperation *bulk = [[BulkOperation alloc] init];
+    bulk.operation = operation;
+    bulk.total = total;
+    bulk.representedObject = someObject;
+    return bulk;
+}
+
+
+
+- (void)addBulkChunks:(BulkOperation *)bulk :(NSString *)verb :(NSString *)path :(NSArray *)deviceIDs
+{
+    // Split a list of devices into requests of no more than 'kBulkChunkMax' devices each,
+    // each request sending the devices' identifiers to the same endpoint
+
+    for (NSUInteger i = 0 ; i < deviceIDs.count ; i += kBulkChunkMax)
     {
-        NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
-        configuration.URLCache = [[NSURLCache alloc] initWithMemoryCapacity:0 diskCapacity:0 diskPath:nil];
-        apiSession = [NSURLSession sessionWithConfiguration:configuration
-                                                          delegate:self
-                                                     delegateQueue:[NSOperationQueue mainQueue]];
+        NSUInteger count = MIN(kBulkChunkMax, deviceIDs.count - i);
+        NSArray *chunk = [deviceIDs subarrayWithRange:NSMakeRange(i, count)];
+        NSMutableArray *data = [[NSMutableArray alloc] initWithCapacity:count];
+
+        for (NSString *did in chunk) [data addObject:@{ @"type" : @"device", @"id" : did }];
+
+        [bulk.chunks addObject:@{ @"verb" : verb,
+                                  @"path" : path,
+                                  @"body" : @{ @"data" : data },
+                                  @"devices" : chunk }];
+    }
+}
+
+
+
+- (void)startBulkOperation:(BulkOperation *)bulk
+{
+    // Devices not processed by any request (eg. invalid records) are not counted, unless they
+    // have already been recorded as successes or failures
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self startBulkOperation:bulk]; }];
+        return;
     }
 
-    // Do we have a valid access token - or are we getting/refreshing the access token?
+    NSUInteger queued = 0;
+
+    for (NSDictionary *chunk in bulk.chunks) queued += [[chunk objectForKey:@"devices"] count];
 
-    if (aConnexion.actionCode == kConnectTypeGetAccessToken ||
-        aConnexion.actionCode == kConnectTypeRefreshAccessToken || 
-        [self isAccessTokenValid])
+    if (bulk.succeeded.count + bulk.failed.count + queued < bulk.total) bulk.total = bulk.succeeded.count + bulk.failed.count + queued;
+
+    if (bulk.chunks.count == 0)
     {
-        // Create and begin the task
+        [self finishBulkOperation:bulk];
+        return;
+    }
+
+    // Make the first requests; the rest are made as these complete
+
+    while (bulk.chunks.count > 0 && bulk.chunksOutstanding < kBulkConcurrency) [self launchBulkChunk:bulk];
+
+    if (bulk.chunksOutstanding == 0) [self finishBulkOperation:bulk];
+}
+
+
+
+- (void)launchBulkChunk:(BulkOperation *)bulk
+{
+    // Make the request for the next of a bulk operation's chunks of devices
+
+    NSDictionary *chunk = [bulk.chunks objectAtIndex:0];
+    [bulk.chunks removeObjectAtIndex:0];
 
-        aConnexion.task = [apiSession dataTaskWithRequest:request];
+    NSString *verb = [chunk objectForKey:@"verb"];
+    NSDictionary *body = [chunk objectForKey:@"body"];
+    NSMutableURLRequest *request = [self makeRequest:verb :[chunk objectForKey:@"path"] :(body != nil) :NO];
+    NSError *error = nil;
+
+    if (request != nil && body != nil) [request setHTTPBody:[NSJSONSerialization dataWithJSONObject:body options:0 error:&error]];
 
-        [aConnexion.task resume];
+    if (request == nil || error != nil)
+    {
+        for (NSString *did in [chunk objectForKey:@"devices"]) [bulk.failed setObject:@"Could not create the request" forKey:did];
 
-        // Notify the main app to show and start its progress indicator, if it has one
+        [self postBulkProgress:bulk];
+        return;
+    }
 
-        if (connexions.count == 0) [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPIProgressStart" object:nil];
+    bulk.chunksOutstanding += 1;
 
-        // Add the new connection to the list
+    [self launchConnection:request :kConnectTypeBulkOperation :@{ @"bulk" : bulk, @"chunk" : chunk }];
+}
 
-        [connexions addObject:aConnexion];
 
-        // Update the public property, numberOfConnections
 
-        numberOfConnections = connexions.count;
+- (void)bulkChunkComplete:(Connexion *)connexion :(BOOL)success
+{
+    // Record the outcome of one of a bulk operation's requests, notify the host of
+    // the operation's progress, and make the next request, if there is one
 
-        // Set 'tokenConnexion' if we need to
+    BulkOperation *bulk = [connexion.representedObject objectForKey:@"bulk"];
+    NSDictionary *chunk = [connexion.representedObject objectForKey:@"chunk"];
+    NSArray *chunkDevices = [chunk objectForKey:@"devices"];
 
-        if (aConnexion.actionCode == kConnectTypeGetAccessToken || aConnexion.actionCode == kConnectTypeRefreshAccessToken) tokenConnexion = aConnexion;
+    if (success)
+    {
+        [bulk.succeeded addObjectsFromArray:chunkDevices];
     }
     else
     {
-        // We do not have a valid access token, so we must now acquire one. In the meantime,
-        // we cache all new connexions in 'pendingConnections' so they can be actioned when
-        // we finally get the token
+        NSString *message = errorMessage.length > 0 ? errorMessage : @"Request failed";
 
-        // Q: do we want to put a limit on 'pendingConnections' size?
+        for (NSString *did in chunkDevices) [bulk.failed setObject:message forKey:did];
 
-        if (pendingConnections == nil) pendingConnections = [[NSMutableArray alloc] init];
-
-        if (tokenConnexion == nil)
+        if ([[lastError objectForKey:@"code"] integerValue] == kErrorRequestCancelled)
         {
-            // We have no queued attempt to get a new access token yet, so get one now, either
-            // with a stored login key (pass in the key) or a stored refresh token (pass in nil)
-            // NOTE we need to ensure this is called only once per refresh
+            // The instance's requests have been cancelled, so the requests not yet made fail too
 
-            [self refreshAccessToken:(token != nil && token.loginKey.length > 0 ? token.loginKey : nil)];
+            for (NSDictionary *next in bulk.chunks)
+            {
+                for (NSString *did in [next objectForKey:@"devices"]) [bulk.failed setObject:message forKey:did];
+            }
+
+            [bulk.chunks removeAllObjects];
         }
+    }
 
-        // Add the current request to the pending queue while the new token is retrieved
+    bulk.chunksOutstanding -= 1;
 
-        [pendingConnections addObject:aConnexion];
-    }
+    [self postBulkProgress:bulk];
 
-    return aConnexion;
+    while (bulk.chunks.count > 0 && bulk.chunksOutstanding < kBulkConcurrency) [self launchBulkChunk:bulk];
+
+    if (bulk.chunksOutstanding == 0 && bulk.chunks.count == 0) [self finishBulkOperation:bulk];
+}
+
+
+
+- (void)postBulkProgress:(BulkOperation *)bulk
+{
+    // Notify the host of the number of a bulk operation's devices whose outcome is now known
+
+    NSDictionary *dict = bulk.representedObject != nil
+    ? @{ @"completed" : [NSNumber numberWithUnsignedInteger:(bulk.succeeded.count + bulk.failed.count)], @"total" : [NSNumber numberWithUnsignedInteger:bulk.total], @"object" : bulk.representedObject }
+    : @{ @"completed" : [NSNumber numberWithUnsignedInteger:(bulk.succeeded.count + bulk.failed.count)], @"total" : [NSNumber numberWithUnsignedInteger:bulk.total] };
+
+    [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPIBulkOperationProgress" object:dict];
+}
+
+
+
+- (void)finishBulkOperation:(BulkOperation *)bulk
+{
+    // Notify the host of the outcome of a bulk operation: its 'data' is a dictionary of the IDs of the
+    // devices successfully processed ('succeeded') and the error messages for those that were not,
+    // keyed by device ID ('failed'). A request rejected as it is made may already have completed the operation
+
+    if (bulk.isComplete) return;
+
+    bulk.isComplete = YES;
+
+    NSArray *operations = @[ @"assign", @"unassign", @"restart", @"rename", @"delete" ];
+    NSDictionary *data = @{ @"operation" : [operations objectAtIndex:bulk.operation],
+                            @"succeeded" : [NSArray arrayWithArray:bulk.succeeded],
+                            @"failed" : [NSDictionary dictionaryWithDictionary:bulk.failed] };
+
+    NSDictionary *dict = bulk.representedObject != nil
+    ? @{ @"data" : data, @"object" : bulk.representedObject }
+    : @{ @"data" : data };
+
+    [self relayResult:@"BuildAPIBulkOperationComplete" :dict];
+}
+
+
+
+- (NSString *)idOfDevice:(id)device
+{
+    // Returns the ID of a device supplied as either a device record or a device ID
+
+    if ([device isKindOfClass:[NSString class]]) return ([device length] > 0 ? device : nil);
+    if ([device isKindOfClass:[NSDictionary class]]) return [device objectForKey:@"id"];
+    return nil;
 }
 
 
 
-- (void)relaunchConnection:(id)userInfo
-{
-    // This method is called in response to the receipt of a status code 429 from the server,
-    // ie. we have been rate-limited. A timer will bring us here 1.0 seconds after receipt of the error
-    // 'userInfo' is user data from the previous request
+- (NSString *)devicegroupOfDevice:(id)device
+{
+    // Returns the ID of the device group to which a device (supplied as a device record) is assigned, or nil
+
+    if (![device isKindOfClass:[NSDictionary class]]) return nil;
+
+    NSDictionary *relationships = [device objectForKey:@"relationships"];
+    NSDictionary *dg = [relationships objectForKey:@"devicegroup"];
+
+    return [dg objectForKey:@"id"];
+}
+
+
+
+#pragma mark - Rollout Methods
+
+
+- (void)runRollout:(NSArray *)plan
+{
+    [self runRollout:plan :nil];
+}
+
+
+
+- (void)runRollout:(NSArray *)plan :(id)someObject
+{
+    // Run a rollout plan: any number of steps across any number of device groups, each of which may
+    // depend on others. Every step is started as soon as the steps it depends on have succeeded, so
+    // independent steps, eg. those for different device groups, run concurrently, and the rollout takes
+    // as many round trips as its longest chain of dependent steps
+    // PARAMETERS:
+    //   'plan' is an array of steps, each a dictionary with these keys:
+    //       'id'          - a name for the step, unique within the plan
+    //       'action'      - 'createDeployment', 'setMinimumDeployment', 'updateDevicegroup',
+    //                       'restartDevices' or 'conditionalRestartDevices'
+    //       'devicegroup' - the ID of the device group the step acts on
+    //       'deployment'  - for 'createDeployment', the deployment's details, as passed to 'createDeployment:';
+    //                       for 'setMinimumDeployment', a deployment record
+    //       'keys'        - for 'updateDevicegroup', the keys and values to update, as passed to
+    //       'values'        'updateDevicegroup:::'
+    //       'after'       - optional: an array of the IDs of the steps which must succeed first
+    //       'input'       - optional: the ID of a step whose returned record is used as this step's 'deployment',
+    //                       eg. a 'createDeployment' step for a 'setMinimumDeployment' step. It must succeed first
+    //   'someObject' is an optional object, supplied by the host app, that is bound to this request
+    //                and follows it through sending and processing the response from the server
+    // RETURNS:
+    //   Nothing
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self runRollout:plan :someObject]; }];
+        return;
+    }
+
+    RolloutPipeline *pipeline = [self makeRolloutPipeline:plan :someObject];
+
+    if (pipeline == nil)
+    {
+        [self reportError];
+        return;
+    }
+
+    [self startRollout:pipeline];
+}
+
+
+
+- (RolloutPipeline *)makeRolloutPipeline:(NSArray *)plan :(id)someObject
+{
+    // Check a rollout plan and convert it to a pipeline of steps, each linked to those which depend on it
+    // RETURNS:
+    //   The pipeline, or nil if the plan is invalid, in which case 'errorMessage' says why
+
+    if (plan == nil || plan.count == 0)
+    {
+        errorMessage = @"Could not start a rollout: no steps specified.";
+        return nil;
+    }
+
+    NSArray *actions = @[ @"createDeployment", @"setMinimumDeployment", @"updateDevicegroup", @"restartDevices", @"conditionalRestartDevices" ];
+    RolloutPipeline *pipeline = [[RolloutPipeline alloc] init];
+    pipeline.representedObject = someObject;
+
+    for (NSDictionary *entry in plan)
+    {
+        NSString *stepID = [entry isKindOfClass:[NSDictionary class]] ? [entry objectForKey:@"id"] : nil;
+
+        if (![stepID isKindOfClass:[NSString class]] || stepID.length == 0 || [pipeline.steps objectForKey:stepID] != nil)
+        {
+            errorMessage = @"Could not start a rollout: every step must have a unique ID.";
+            return nil;
+        }
+
+        NSString *action = [entry objectForKey:@"action"];
+        NSString *devicegroupID = [entry objectForKey:@"devicegroup"];
+        NSUInteger actionCode = [action isKindOfClass:[NSString class]] ? [actions indexOfObject:action] : NSNotFound;
+
+        if (actionCode == NSNotFound)
+        {
+            errorMessage = [NSString stringWithFormat:@"Could not start a rollout: step '%@' has no valid action.", stepID];
+            return nil;
+        }
+
+        if (![devicegroupID isKindOfClass:[NSString class]] || devicegroupID.length == 0)
+        {
+            errorMessage = [NSString stringWithFormat:@"Could not start a rollout: step '%@' has no device group.", stepID];
+            return nil;
+        }
+
+        RolloutStep *step = [[RolloutStep alloc] init];
+        step.stepID = stepID;
+        step.devicegroupID = devicegroupID;
+        step.plan = entry;
+        step.action = actionCode;
+
+        NSMutableArray *dependencies = [[NSMutableArray alloc] init];
+        NSArray *after = [entry objectForKey:@"after"];
+        NSString *input = [entry objectForKey:@"input"];
+
+        if ([after isKindOfClass:[NSArray class]]) [dependencies addObjectsFromArray:after];
+
+        if ([input isKindOfClass:[NSString class]])
+        {
+            step.inputID = input;
+            if (![dependencies containsObject:input]) [dependencies addObject:input];
+        }
+
+        step.dependencies = dependencies;
+
+        [pipeline.steps setObject:step forKey:stepID];
+        [pipeline.order addObject:stepID];
+    }
+
+    // Link each step to the steps which depend on it
+
+    for (NSString *stepID in pipeline.order)
+    {
+        RolloutStep *step = [pipeline.steps objectForKey:stepID];
+
+        for (NSString *dependencyID in step.dependencies)
+        {
+            RolloutStep *dependency = [pipeline.steps objectForKey:dependencyID];
+
+            if (dependency == nil || dependency == step)
+            {
+                errorMessage = [NSString stringWithFormat:@"Could not start a rollout: step '%@' depends on an unknown step.", stepID];
+                return nil;
+            }
+
+            [dependency.dependents addObject:step];
+            step.waitingOn += 1;
+        }
+    }
+
+    // Check that the steps can be ordered, ie. that no step depends, however indirectly, on itself
+
+    NSMutableDictionary *waiting = [[NSMutableDictionary alloc] init];
+    NSMutableArray *ready = [[NSMutableArray alloc] init];
+    NSUInteger ordered = 0;
+
+    for (NSString *stepID in pipeline.order)
+    {
+        RolloutStep *step = [pipeline.steps objectForKey:stepID];
+        [waiting setObject:[NSNumber numberWithInteger:step.waitingOn] forKey:stepID];
+        if (step.waitingOn == 0) [ready addObject:step];
+    }
+
+    while (ready.count > 0)
+    {
+        RolloutStep *step = [ready lastObject];
+        [ready removeLastObject];
+        ordered += 1;
+
+        for (RolloutStep *dependent in step.dependents)
+        {
+            NSInteger count = [[waiting objectForKey:dependent.stepID] integerValue] - 1;
+            [waiting setObject:[NSNumber numberWithInteger:count] forKey:dependent.stepID];
+            if (count == 0) [ready addObject:dependent];
+        }
+    }
+
+    if (ordered < pipeline.order.count)
+    {
+        errorMessage = @"Could not start a rollout: its steps depend on each other in a loop.";
+        return nil;
+    }
+
+    pipeline.stepsRemaining = pipeline.order.count;
+    return pipeline;
+}
+
+
+
+- (void)startRollout:(RolloutPipeline *)pipeline
+{
+    // Start every step which depends on no other
+
+    for (NSString *stepID in pipeline.order)
+    {
+        RolloutStep *step = [pipeline.steps objectForKey:stepID];
+
+        if (step.waitingOn == 0 && step.state == kRolloutStepStatePending) [self startRolloutStep:step :pipeline];
+    }
+}
+
+
+
+- (void)startRolloutStep:(RolloutStep *)step :(RolloutPipeline *)pipeline
+{
+    // Make a step's request, with a completion handler which records its outcome on the processing queue
+
+    step.state = kRolloutStepStateRunning;
+
+    NSDictionary *plan = step.plan;
+    NSString *devicegroupID = step.devicegroupID;
+    NSDictionary *deployment = [plan objectForKey:@"deployment"];
+
+    if (step.inputID != nil)
+    {
+        RolloutStep *input = [pipeline.steps objectForKey:step.inputID];
+        deployment = [input.result isKindOfClass:[NSDictionary class]] ? input.result : nil;
+    }
+
+    if ((step.action == kRolloutStepCreateDeployment || step.action == kRolloutStepSetMinDeployment) && ![deployment isKindOfClass:[NSDictionary class]])
+    {
+        [self rolloutStepComplete:step :pipeline :nil :@{ @"message" : @"No deployment specified", @"code" : @-1 }];
+        return;
+    }
+
+    if (step.action == kRolloutStepSetMinDeployment && ![[deployment objectForKey:@"id"] isKindOfClass:[NSString class]])
+    {
+        [self rolloutStepComplete:step :pipeline :nil :@{ @"message" : @"The deployment has no ID", @"code" : @-1 }];
+        return;
+    }
+
+    [self performRequest:^(id someObject) {
+        switch (step.action)
+        {
+            case kRolloutStepCreateDeployment:
+                [self createDeployment:deployment :someObject];
+                break;
+
+            case kRolloutStepSetMinDeployment:
+                [self setMinimumDeployment:devicegroupID :deployment :someObject];
+                break;
+
+            case kRolloutStepUpdateDevicegroup:
+                [self updateDevicegroup:devicegroupID :[plan objectForKey:@"keys"] :[plan objectForKey:@"values"] :someObject];
+                break;
+
+            case kRolloutStepRestartDevices:
+                [self restartDevices:devicegroupID :someObject];
+                break;
+
+            default:
+                [self conditionalRestartDevices:devicegroupID :someObject];
+        }
+    } :processingQueue :^(NSDictionary *result, NSDictionary *error) {
+        [self rolloutStepComplete:step :pipeline :result :error];
+    }];
+}
+
+
+
+- (void)rolloutStepComplete:(RolloutStep *)step :(RolloutPipeline *)pipeline :(NSDictionary *)result :(NSDictionary *)error
+{
+    // Record the outcome of a step. If it failed, skip every step which depends on it, however indirectly.
+    // Then notify the host of the rollout's progress, and of its outcome if no steps remain. Finally, if the
+    // step succeeded, start any steps which were waiting only for it
+
+    if (pipeline.isComplete || step.state != kRolloutStepStateRunning) return;
+
+    NSMutableArray *ready = [[NSMutableArray alloc] init];
+
+    pipeline.stepsRemaining -= 1;
+
+    if (error == nil)
+    {
+        step.state = kRolloutStepStateSucceeded;
+        step.result = [result objectForKey:@"data"];
+
+        for (RolloutStep *dependent in step.dependents)
+        {
+            dependent.waitingOn -= 1;
+
+            if (dependent.waitingOn == 0 && dependent.state == kRolloutStepStatePending) [ready addObject:dependent];
+        }
+    }
+    else
+    {
+        step.state = kRolloutStepStateFailed;
+        step.error = [error objectForKey:@"message"];
+
+        [self skipRolloutDependents:step :pipeline];
+
+        if ([[error objectForKey:@"code"] integerValue] == kErrorRequestCancelled)
+        {
+            // The instance's requests have been cancelled, so no further steps are started
+
+            for (NSString *stepID in pipeline.order)
+            {
+                RolloutStep *pending = [pipeline.steps objectForKey:stepID];
+
+                if (pending.state != kRolloutStepStatePending) continue;
+
+                pending.state = kRolloutStepStateSkipped;
+                pending.error = @"The rollout was cancelled";
+                pipeline.stepsRemaining -= 1;
+            }
+        }
+    }
+
+    NSDictionary *progress = @{ @"step" : step.stepID,
+                                @"devicegroup" : step.devicegroupID,
+                                @"succeeded" : [NSNumber numberWithBool:(step.state == kRolloutStepStateSucceeded)],
+                                @"completed" : [NSNumber numberWithInteger:(pipeline.order.count - pipeline.stepsRemaining)],
+                                @"total" : [NSNumber numberWithInteger:pipeline.order.count] };
+
+    NSDictionary *dict = pipeline.representedObject != nil
+    ? @{ @"data" : progress, @"object" : pipeline.representedObject }
+    : @{ @"data" : progress };
+
+    [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPIRolloutProgress" object:dict];
+
+    if (pipeline.stepsRemaining == 0)
+    {
+        [self finishRollout:pipeline];
+        return;
+    }
+
+    for (RolloutStep *dependent in ready) [self startRolloutStep:dependent :pipeline];
+}
+
+
+
+- (void)skipRolloutDependents:(RolloutStep *)step :(RolloutPipeline *)pipeline
+{
+    // Mark every step which depends on a failed step as skipped, as it can now never start
+
+    for (RolloutStep *dependent in step.dependents)
+    {
+        if (dependent.state != kRolloutStepStatePending) continue;
+
+        dependent.state = kRolloutStepStateSkipped;
+        dependent.error = [NSString stringWithFormat:@"Step '%@' did not succeed", step.stepID];
+        pipeline.stepsRemaining -= 1;
+
+        [self skipRolloutDependents:dependent :pipeline];
+    }
+}
+
+
+
+- (void)finishRollout:(RolloutPipeline *)pipeline
+{
+    // Notify the host of the outcome of a rollout: its 'data' is a dictionary of the IDs of the steps which
+    // succeeded ('succeeded'), the error messages of those which failed or were skipped, keyed by step ID
+    // ('failed'), and the same outcomes for each device group, keyed by device group ID ('devicegroups')
+
+    if (pipeline.isComplete) return;
+
+    pipeline.isComplete = YES;
+
+    NSMutableArray *succeeded = [[NSMutableArray alloc] init];
+    NSMutableDictionary *failed = [[NSMutableDictionary alloc] init];
+    NSMutableDictionary *devicegroups = [[NSMutableDictionary alloc] init];
+
+    for (NSString *stepID in pipeline.order)
+    {
+        RolloutStep *step = [pipeline.steps objectForKey:stepID];
+        NSDictionary *group = [devicegroups objectForKey:step.devicegroupID];
+
+        if (group == nil)
+        {
+            group = @{ @"succeeded" : [[NSMutableArray alloc] init], @"failed" : [[NSMutableDictionary alloc] init] };
+            [devicegroups setObject:group forKey:step.devicegroupID];
+        }
+
+        if (step.state == kRolloutStepStateSucceeded)
+        {
+            [succeeded addObject:stepID];
+            [[group objectForKey:@"succeeded"] addObject:stepID];
+        }
+        else
+        {
+            NSString *message = step.error != nil ? step.error : @"Request failed";
+            [failed setObject:message forKey:stepID];
+            [[group objectForKey:@"failed"] setObject:message forKey:stepID];
+        }
+    }
+
+    NSDictionary *data = @{ @"succeeded" : succeeded,
+                            @"failed" : failed,
+                            @"devicegroups" : devicegroups };
+
+    NSDictionary *dict = pipeline.representedObject != nil
+    ? @{ @"data" : data, @"object" : pipeline.representedObject }
+    : @{ @"data" : data };
+
+    [self relayResult:@"BuildAPIRolloutComplete" :dict];
+}
+
+
+
+#pragma mark - HTTP Request Construction Methods
+
+
+- (NSMutableURLRequest *)makeGETrequest:(NSString *)path :(BOOL)getMultipleItems
+{
+    return [self makeRequest:@"GET" :path :NO : getMultipleItems];
+}
+
+
+
+- (NSMutableURLRequest *)makeDELETErequest:(NSString *)path
+{
+    return [self makeRequest:@"DELETE" :path :NO :NO];
+}
+
+
+
+- (NSMutableURLRequest *)makePOSTrequest:(NSString *)path :(NSDictionary *)body
+{
+    NSError *error = nil;
+    NSMutableURLRequest *request = [self makeRequest:@"POST" :path :YES :NO];
+
+    if (body != nil) [request setHTTPBody:[NSJSONSerialization dataWithJSONObject:body options:0 error:&error]];
+    if (error != nil) return nil;
+    return request;
+}
+
+
+
+- (NSMutableURLRequest *)makePATCHrequest:(NSString *)path :(NSDictionary *)body
+{
+    NSError *error = nil;
+    NSMutableURLRequest *request = [self makeRequest:@"PATCH" :path :YES :NO];
+
+    if (body != nil) [request setHTTPBody:[NSJSONSerialization dataWithJSONObject:body options:0 error:&error]];
+    if (error != nil) return nil;
+    return request;
+}
+
+
+
+- (NSMutableURLRequest *)makePUTrequest:(NSString *)path :(NSDictionary *)body
+{
+    NSError *error = nil;
+    NSMutableURLRequest *request = [self makeRequest:@"PUT" :path :YES :NO];
+
+    if (body != nil) [request setHTTPBody:[NSJSONSerialization dataWithJSONObject:body options:0 error:&error]];
+    if (error != nil) return nil;
+    return request;
+}
+
+
+
+- (NSMutableURLRequest *)makeRequest:(NSString *)verb :(NSString *)path :(BOOL)addContentType :(BOOL)getMultipleItems
+{
+    // Generic HTTP request constructor used by the specific-verb methods, and separately
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        __block NSMutableURLRequest *request = nil;
+        [self performOnProcessingQueueAndWait:^{ request = [self makeRequest:verb :path :addContentType :getMultipleItems]; }];
+        return request;
+    }
+
+    if (token == nil || !isLoggedIn)
+    {
+        // We have no access token, so we can't get any data
+
+        errorMessage = @"You must be logged in to access the Electric Imp impCloud™";
+        [self reportError];
+        return nil;
+    }
+
+    if (pageSizeChangeFlag && ([path compare:@"accounts/me"] != NSOrderedSame) && [verb compare:@"GET"] == NSOrderedSame)
+    {
+        // User has changed the page size, so we need to pass this in now to set it
+        // NOTE make sure this is not called when we do a request for the user's account
+        // and that it's not duplicating the encoded string
+
+        if (![path containsString:@"?"] && getMultipleItems) path = [path stringByAppendingFormat:@"?page[size]=%li", pageSize];
+    }
+
+    // Ask for only the fields the host needs from list records
+
+    if ([verb compare:@"GET"] == NSOrderedSame) path = [self addFieldsToPath:path];
+
+    // Deal with paths that already contain an HTTP mode and domain
+
+    if (![path hasPrefix:@"https://"] && ![path hasPrefix:@"http://"]) path = [baseURL stringByAppendingString:path];
+
+    // Prepare the request
+
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:path]];
+
+    [self setRequestAuthorization:request];
+    [request setValue:userAgent forHTTPHeaderField:@"User-Agent"];
+
+    request.timeoutInterval = kConnectTimeoutInterval;
+    request.HTTPMethod = verb;
+
+    if (addContentType) [request setValue:@"application/vnd.api+json" forHTTPHeaderField:@"Content-Type"];
+
+    return request;
+}
+
+
+
+- (void)setRequestAuthorization:(NSMutableURLRequest *)request
+{
+    // Applies the stored access token data to the request
+    // NOTE the validity of the accessToken should already have been checked
+
+    [request setValue:[@"Bearer " stringByAppendingString:token.accessToken] forHTTPHeaderField:@"Authorization"];
+    [request setTimeoutInterval:30.0];
+}
+
+
+
+#pragma mark - Connection Methods
+
+
+- (Connexion *)launchConnection:(NSMutableURLRequest *)request :(NSInteger)actionCode :(id)someObject
+{
+    // Create a default connexion object to store the details of the connection we're about to initiate
+    // and pass it to the scheduler, which starts it once the rate limit and concurrency cap allow
+    // PARAMETERS:
+    //   'request' is the HTTP request we're making to the API
+    //   'actionCode' is an internal ID indicating what the API is being asked to do
+    //   'someObject' is an optional object, supplied by the host app, that is bound to this request
+    //                and follows it through sending and processing the response from the server
+    // RETURNS:
+    //   A BuildAPIAccess Connexion instance
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        __block Connexion *connexion = nil;
+        [self performOnProcessingQueueAndWait:^{ connexion = [self launchConnection:request :actionCode :someObject]; }];
+        return connexion;
+    }
+
+#ifdef DEBUG
+    NSLog(@"URL: %@", request.URL);
+    NSLog(@"VRB: %@", request.HTTPMethod);
+    NSLog(@"HED: %@", request.allHTTPHeaderFields);
+    NSLog(@"BDY: %@", [[NSString alloc] initWithData:request.HTTPBody encoding:NSUTF8StringEncoding]);
+#endif
+    
+    Connexion *aConnexion = [[Connexion alloc] init];
+    aConnexion.actionCode = actionCode;
+    aConnexion.initialActionCode = actionCode;
+    aConnexion.originalRequest = request;
+    aConnexion.data = [NSMutableData dataWithCapacity:0];
+
+    if (collectMetrics) aConnexion.queuedTime = [NSProcessInfo processInfo].systemUptime;
+
+    if (someObject) aConnexion.representedObject = someObject;
+
+    if (aConnexion.actionCode == kConnectTypeGetAccessToken || aConnexion.actionCode == kConnectTypeRefreshAccessToken)
+    {
+        // Access token requests bypass the scheduler: every other request may be waiting on them
+
+        [self startConnexion:aConnexion];
+
+        // Set 'tokenConnexion'
+
+        tokenConnexion = aConnexion;
+        return aConnexion;
+    }
+
+    // Can we complete the request with a recent response from the cache?
+
+    if ([self serveFromCache:aConnexion]) return aConnexion;
+
+    // Is an identical read already in flight? If so, share its result
+
+    if ([self coalesceConnexion:aConnexion]) return aConnexion;
+
+    // Each new request earns a fraction of a retry
+
+    [self depositRetryBudget];
+
+    aConnexion.priority = [self priorityForAction:actionCode];
+
+    [self queueConnexion:aConnexion];
+    [self scheduleConnections];
+
+    return aConnexion;
+}
+
+
+
+- (BOOL)coalesceConnexion:(Connexion *)connexion
+{
+    // If an identical read - same verb, URL and page size - is already in flight, attach the connexion
+    // to it as a follower, to receive the same result, rather than making another request. Otherwise
+    // record the connexion as the one in flight for that read
+    // NOTE pages after the first of a list are never coalesced: they belong to a specific list retrieval
+    // RETURNS:
+    //   YES if the connexion has been attached to a read in flight, otherwise NO
+
+    if (!coalesceReads) return NO;
+
+    NSURLRequest *request = connexion.originalRequest;
+
+    if ([request.HTTPMethod compare:@"GET"] != NSOrderedSame) return NO;
+    if ([self rangeOfPageNumber:request.URL.absoluteString].location != NSNotFound) return NO;
+
+    NSString *key = [NSString stringWithFormat:@"%@ %@ %li", request.HTTPMethod, request.URL.absoluteString, (long)pageSize];
+
+    if (coalescedReads == nil) coalescedReads = [[NSMutableDictionary alloc] init];
+
+    Connexion *leader = [coalescedReads objectForKey:key];
+
+    if (leader != nil && leader.actionCode == connexion.actionCode)
+    {
+        if (leader.followers == nil) leader.followers = [[NSMutableArray alloc] init];
+        [leader.followers addObject:connexion];
+        return YES;
+    }
+
+    connexion.coalesceKey = key;
+    [coalescedReads setObject:connexion forKey:key];
+    return NO;
+}
+
+
+
+- (void)releaseCoalescedConnexion:(Connexion *)connexion
+{
+    // Called when a coalesced read is complete, so that later identical reads are not attached to it
+
+    if (connexion.coalesceKey == nil) return;
+
+    if ([coalescedReads objectForKey:connexion.coalesceKey] == connexion) [coalescedReads removeObjectForKey:connexion.coalesceKey];
+
+    connexion.coalesceKey = nil;
+}
+
+
+
+- (void)fanOutResult:(Connexion *)connexion :(NSDictionary *)data
+{
+    // Pass the result of a coalesced read on to each of its followers, so that each caller is notified with
+    // its own represented object. Lists are handled in 'processResult::', as their notifications are only
+    // issued once every page has been received: there the followers are passed on to the connexion
+    // fetching the next page, and 'notifyFollowers:::' is called when the list is complete
+
+    if (connexion.followers.count == 0) return;
+
+    NSArray *followers = connexion.followers;
+
+    if (connexion.actionCode == kConnectTypeNone)
+    {
+        // The read failed - the error has been reported once, for all of the callers
+
+        connexion.followers = nil;
+        return;
+    }
+
+    if ([self isListAction:connexion.actionCode]) return;
+
+    connexion.followers = nil;
+
+    for (Connexion *follower in followers) [self processResult:follower :data];
+}
+
+
+
+- (void)notifyFollowers:(Connexion *)connexion :(NSString *)name :(NSDictionary *)returnData
+{
+    // Post a copy of the notification just issued for a coalesced read for each of its followers,
+    // replacing the connexion's represented object with the follower's own
+
+    if (connexion.followers.count == 0) return;
+
+    NSArray *followers = connexion.followers;
+    connexion.followers = nil;
+
+    for (Connexion *follower in followers)
+    {
+        NSMutableDictionary *dict = [NSMutableDictionary dictionaryWithDictionary:returnData];
+
+        if (follower.representedObject != nil)
+        {
+            [dict setObject:follower.representedObject forKey:@"object"];
+        }
+        else
+        {
+            [dict removeObjectForKey:@"object"];
+        }
+
+        [self relayResult:name :dict];
+    }
+}
+
+
+
+- (BOOL)isListAction:(NSInteger)actionCode
+{
+    // Returns YES if the specified action retrieves a list which may span several pages
+
+    return (actionCode == kConnectTypeGetProducts || actionCode == kConnectTypeGetDeviceGroups ||
+            actionCode == kConnectTypeGetDeployments || actionCode == kConnectTypeGetDevices ||
+            actionCode == kConnectTypeGetDeviceLogs || actionCode == kConnectTypeGetDeviceHistory ||
+            actionCode == kConnectTypeGetLibraries || actionCode == kConnectTypeSyncProducts ||
+            actionCode == kConnectTypeSyncDeviceGroups || actionCode == kConnectTypeSyncDevices);
+}
+
+
+
+- (void)startConnexion:(Connexion *)connexion
+{
+    // Create and begin the connexion's task
+
+    [self applyCacheValidators:connexion];
+
+    connexion.task = [self makeTask:connexion.originalRequest];
+
+    if (collectMetrics) connexion.startTime = [NSProcessInfo processInfo].systemUptime;
+
+    connexion.sentTime = [NSProcessInfo processInfo].systemUptime;
+
+    [connexion.task resume];
+
+    // Notify the main app to show and start its progress indicator, if it has one
+
+    if (connexions.count == 0) [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPIProgressStart" object:nil];
+
+    // Add the new connection to the list (this also updates the public property, numberOfConnections)
+
+    [self addConnexion:connexion];
+
+    // Send a second copy of the read if it turns out to be slow
+
+    [self armHedge:connexion];
+}
+
+
+
+- (NSURLSessionDataTask *)makeTask:(NSURLRequest *)request
+{
+    // Create a task for the request, in the shared session of the instance's session pool if it has one,
+    // otherwise in its own session. Use NSURLSession for the connection. Compatible with iOS, tvOS and Mac OS X
+
+    if (sessionPool != nil) return [sessionPool dataTask:request :self];
+
+    if (apiSession == nil)
+    {
+        NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
+        configuration.URLCache = [[NSURLCache alloc] initWithMemoryCapacity:0 diskCapacity:0 diskPath:nil];
+        apiSession = [NSURLSession sessionWithConfiguration:configuration
+                                                   delegate:self
+                                              delegateQueue:(delegateQueue != nil ? delegateQueue : [NSOperationQueue mainQueue])];
+    }
+
+    return [apiSession dataTaskWithRequest:request];
+}
+
+
+
+- (NSInteger)priorityForAction:(NSInteger)actionCode
+{
+    // Returns the scheduling priority class of a request with the specified action code:
+    // list retrievals are bulk work, log and history retrievals are background work, and
+    // everything else - single-item requests and actions - is interactive
+
+    switch (actionCode)
+    {
+        case kConnectTypeGetProducts:
+        case kConnectTypeGetDeviceGroups:
+        case kConnectTypeGetDeployments:
+        case kConnectTypeGetDevices:
+        case kConnectTypeGetWebhooks:
+        case kConnectTypeGetLibraries:
+        case kConnectTypeBulkOperation:
+            return kConnectPriorityBulk;
+
+        case kConnectTypeGetDeviceLogs:
+        case kConnectTypeGetDeviceHistory:
+        case kConnectTypeSyncProducts:
+        case kConnectTypeSyncDeviceGroups:
+        case kConnectTypeSyncDevices:
+            return kConnectPriorityBackground;
+
+        default:
+            return kConnectPriorityInteractive;
+    }
+}
+
+
+
+- (void)queueConnexion:(Connexion *)connexion
+{
+    // Add a connexion to the back of its priority class' queue. If the queues are full, the
+    // most recently queued request of a lower priority class is turned away to make room;
+    // failing that, the new request is turned away
+
+    if (connexionQueues == nil)
+    {
+        connexionQueues = [[NSMutableArray alloc] init];
+
+        for (NSUInteger i = 0 ; i < kConnectPriorityClasses ; ++i) [connexionQueues addObject:[[NSMutableArray alloc] init]];
+    }
+
+    if (maxQueuedConnections > 0 && [self numberOfQueuedConnexions] >= maxQueuedConnections)
+    {
+        Connexion *rejected = connexion;
+
+        for (NSInteger i = kConnectPriorityClasses - 1 ; i > connexion.priority ; --i)
+        {
+            NSMutableArray *queue = [connexionQueues objectAtIndex:i];
+
+            if (queue.count > 0)
+            {
+                rejected = queue.lastObject;
+                [queue removeLastObject];
+                break;
+            }
+        }
+
+        // Reject the request once the current call has completed, so that whoever
+        // launched it has had the chance to finish setting up its connexion
+
+        [self performOnProcessingQueue:^{
+            [self rejectConnexion:rejected];
+        }];
+
+        if (rejected == connexion) return;
+    }
+
+    [[connexionQueues objectAtIndex:connexion.priority] addObject:connexion];
+}
+
+
+
+- (void)rejectConnexion:(Connexion *)connexion
+{
+    // Report a request turned away because the queue of waiting requests was full,
+    // and release anything that depended on it
+
+    errorMessage = @"Too many requests are waiting to be sent to the impCloud. Please try again later.";
+    [self reportError];
+
+    // Any callers sharing the request share the error
+
+    [self releaseCoalescedConnexion:connexion];
+    [self requestFailed:connexion];
+
+    connexion.followers = nil;
+}
+
+
+
+- (void)requestFailed:(Connexion *)connexion
+{
+    // Called when a request has failed (the error will already have been reported)
+    // to release or account for anything that was waiting on its result
+
+    // A failed access token request must not block the next one
+
+    if (connexion == tokenConnexion) [self tokenRequestFailed:connexion];
+
+    // A failed page of a list that is being retrieved concurrently still needs to be accounted for
+
+    if (connexion.pagedList != nil)
+    {
+        [self pageFailed:connexion];
+    }
+    else
+    {
+        // A failed request made with a completion handler passes the error to the handler,
+        // as do any requests made with completion handlers that were sharing it
+
+        NSDictionary *error = lastError != nil ? lastError : @{ @"message" : @"Request failed", @"code" : @-1 };
+        NSMutableArray *callers = [NSMutableArray arrayWithObject:connexion];
+
+        if (connexion.followers != nil) [callers addObjectsFromArray:connexion.followers];
+
+        for (Connexion *caller in callers)
+        {
+            if ([caller.representedObject isKindOfClass:[RequestCompletion class]]) [self completeRequest:caller.representedObject :nil :error];
+        }
+    }
+
+    if (![connexion.representedObject isKindOfClass:[NSDictionary class]]) return;
+
+    // A failed log stream request needs to release what was reserved for it
+
+    if ([[connexion.representedObject objectForKey:@"stream"] isKindOfClass:[LogStream class]]) [self logRequestFailed:connexion];
+
+    // A failed request of a bulk operation fails all of its devices
+
+    if ([[connexion.representedObject objectForKey:@"bulk"] isKindOfClass:[BulkOperation class]]) [self bulkChunkComplete:connexion :NO];
+}
+
+
+
+- (NSUInteger)numberOfQueuedConnexions
+{
+    NSUInteger count = 0;
+
+    for (NSMutableArray *queue in connexionQueues) count += queue.count;
+
+    return count;
+}
+
+
+
+- (NSUInteger)numberOfScheduledConnexions
+{
+    // Returns the number of in-flight connections that count against 'maxConcurrentConnections',
+    // ie. those started by the scheduler. Log streams and access token requests are not included
+
+    NSUInteger count = 0;
+
+    for (Connexion *connexion in connexions.allValues)
+    {
+        if (connexion.priority != -1) ++count;
+    }
+
+    return count;
+}
+
+
+
+- (void)scheduleConnections
+{
+    // Start as many queued connexions, highest priority first, as the access token, the concurrency
+    // cap and the rate limiter allow. We come here whenever a request is queued or an in-flight
+    // request is removed, or from 'scheduleTimer' when the rate limiter has deferred the queue
+
+    [self cancelTimer:scheduleTimer];
+    scheduleTimer = nil;
+
+    if ([self numberOfQueuedConnexions] == 0) return;
+
+    // Do we have a valid access token? If not, the queue waits for a new one
+
+    if (![self isAccessTokenValid])
+    {
+        if (tokenConnexion == nil)
+        {
+            // We have no queued attempt to get a new access token yet, so get one now, either
+            // with a stored login key (pass in the key) or a stored refresh token (pass in nil)
+            // NOTE we need to ensure this is called only once per refresh
+
+            [self refreshAccessToken:(token != nil && token.loginKey.length > 0 ? token.loginKey : nil)];
+        }
+
+        return;
+    }
+
+    NSUInteger inFlight = [self numberOfScheduledConnexions];
+
+    for (NSMutableArray *queue in connexionQueues)
+    {
+        while (queue.count > 0)
+        {
+            if (maxConcurrentConnections > 0 && inFlight >= maxConcurrentConnections) return;
+
+            NSTimeInterval delay = [self rateLimitDelay];
+
+            if (delay > 0)
+            {
+                // Come back when the rate limiter will permit the next request
+
+                scheduleTimer = [self makeTimer:delay :^{
+                    [self scheduleConnections];
+                }];
+                return;
+            }
+
+            Connexion *connexion = [queue objectAtIndex:0];
+            [queue removeObjectAtIndex:0];
+
+            if (rateLimitCapacity > 0) rateLimitTokens -= 1.0;
+
+            ++inFlight;
+
+            [self startConnexion:connexion];
+        }
+    }
+}
+
+
+
+- (NSTimeInterval)rateLimitDelay
+{
+    // Refill the token bucket and return how long (in seconds) to wait before the
+    // next request may be sent, or 0 if it may be sent now
+
+    NSTimeInterval now = [NSProcessInfo processInfo].systemUptime;
+
+    if (now < rateLimitResumeTime) return rateLimitResumeTime - now;
+
+    // No limit has been learned from the server yet, so there is nothing to apply
+
+    if (rateLimitCapacity <= 0) return 0;
+
+    NSTimeInterval window = rateLimitWindow > 0 ? rateLimitWindow : kRateLimitWindowDefault;
+    double rate = rateLimitCapacity / window;
+
+    rateLimitTokens += (now - rateLimitRefillTime) * rate;
+    if (rateLimitTokens > rateLimitCapacity) rateLimitTokens = rateLimitCapacity;
+    rateLimitRefillTime = now;
+
+    if (rateLimitTokens >= 1.0) return 0;
+
+    return (1.0 - rateLimitTokens) / rate;
+}
+
+
+
+- (void)updateRateLimit:(NSHTTPURLResponse *)response
+{
+    // Learn the rate limit from the headers of an impCentral API response:
+    //   'X-RateLimit-Limit' is the number of requests permitted per window
+    //   'X-RateLimit-Remaining' is the number of requests left in the current window
+    //   'X-RateLimit-Reset' is the time, in milliseconds, until the current window ends
+    // The window's length is taken to be the longest reset time seen
+
+    NSString *limit = [response.allHeaderFields objectForKey:@"X-RateLimit-Limit"];
+
+    if (limit == nil) return;
+
+    NSString *remaining = [response.allHeaderFields objectForKey:@"X-RateLimit-Remaining"];
+    NSString *reset = [response.allHeaderFields objectForKey:@"X-RateLimit-Reset"];
+    NSTimeInterval resetTime = reset != nil ? reset.doubleValue / 1000.0 : 0;
+
+    // Bring the bucket up to date before applying the new values
+
+    [self rateLimitDelay];
+
+    if (resetTime > rateLimitWindow) rateLimitWindow = resetTime;
+
+    if (limit.doubleValue > 0)
+    {
+        if (rateLimitCapacity <= 0) rateLimitTokens = limit.doubleValue;
+
+        rateLimitCapacity = limit.doubleValue;
+        rateLimitRefillTime = [NSProcessInfo processInfo].systemUptime;
+    }
+
+    // The server's count is authoritative if it is lower than ours
+
+    if (remaining != nil && remaining.doubleValue < rateLimitTokens) rateLimitTokens = remaining.doubleValue;
+
+    if (remaining != nil && remaining.integerValue <= 0 && resetTime > 0)
+    {
+        // The window is exhausted, so hold the queue until it resets
+
+        NSTimeInterval resume = [NSProcessInfo processInfo].systemUptime + resetTime;
+
+        if (resume > rateLimitResumeTime) rateLimitResumeTime = resume;
+    }
+}
+
+
+
+- (void)launchPendingConnections
+{
+    // Requests are held in the queue when we attempt to start them but no valid access
+    // token is available. Having elsewhere received the new token, apply it to the queued
+    // requests and restart the queue
+
+    for (NSMutableArray *queue in connexionQueues)
+    {
+        for (Connexion *conn in queue) [self setRequestAuthorization:conn.originalRequest];
+    }
+
+    [self scheduleConnections];
+}
+
+
+
+- (void)setMaxConcurrentConnections:(NSUInteger)max
+{
+    // Sets the maximum number of requests that may be in flight at once (log streams
+    // excepted). 0 removes the limit. Default is 'kConnectConcurrentDefault'
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self setMaxConcurrentConnections:max]; }];
+        return;
+    }
+
+    maxConcurrentConnections = max;
+
+    [self scheduleConnections];
+}
+
+
+
+- (void)killAllConnections
+{
+    // Cancel and clear all in-flight connections and any queued connections. Every request dropped,
+    // including those waiting to be retried, is then failed, so that whatever is waiting on it is released
+    // NOTE the queue is emptied first so that no queued request is started as the others are removed
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self killAllConnections]; }];
+        return;
+    }
+
+    NSMutableArray *dropped = [[NSMutableArray alloc] init];
+
+    for (NSMutableArray *queue in connexionQueues)
+    {
+        [dropped addObjectsFromArray:queue];
+        [queue removeAllObjects];
+    }
+
+    for (Connexion *connexion in connexions.allValues)
+    {
+        // Log streams and access token requests have no callers to release. A hedged copy of a read
+        // shares its original's callers, so only the original is failed
+
+        if (connexion.priority != -1 && !(connexion.isHedge && connexion.hedge != nil)) [dropped addObject:connexion];
+    }
+
+    if (retryingConnexions.count > 0) [dropped addObjectsFromArray:retryingConnexions.allObjects];
+
+    [coalescedReads removeAllObjects];
+    [retryingConnexions removeAllObjects];
+
+    [self cancelTimer:scheduleTimer];
+    scheduleTimer = nil;
+
+    if (connexions.count > 0)
+    {
+        // There are connections that we need to terminate
+
+        if (loggingDevices.count > 0)
+        {
+            // There are devices for which we are streaming logs, so clear the list...
+
+            NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
+            NSMutableArray *lgds = [loggingDevices copy];
+            numberOfLogStreams = 0;
+
+            [loggingDevices removeAllObjects];
+            [self closeStream];
+
+            // ...and notify the host for each device
+
+            for (NSString *loggingDevice in lgds) [nc postNotificationName:@"BuildAPILogStreamEnd" object:loggingDevice];
+        }
+
+        // Kill the remaining connections.
+        // The triggered delegate method didBecomeInvalid: will clear out 'connexions'
+
+        if (sessionPool != nil)
+        {
+            // The pool's sessions are shared with other accounts, so cancel only this instance's tasks
+
+            for (Connexion *connexion in connexions.allValues) [connexion.task cancel];
+
+            [self clearConnexions];
+        }
+        else if (apiSession != nil)
+        {
+            [apiSession invalidateAndCancel];
+        }
+    }
+
+    [self cancelConnexions:dropped];
+}
+
+
+
+- (void)cancelConnexions:(NSArray *)dropped
+{
+    // Fail requests dropped by 'killAllConnections' with a 'cancelled' error. This is passed to their
+    // completion handlers, and those of any callers sharing them; bulk operations and rollouts treat it
+    // as the end of the operation. The host called for the cancellation, so no error notification is posted
+
+    if (dropped.count == 0) return;
+
+    errorMessage = @"The request was cancelled.";
+    lastError = @{ @"message" : errorMessage,
+                   @"code" : [NSNumber numberWithInteger:kErrorRequestCancelled] };
+
+    for (Connexion *connexion in dropped)
+    {
+        [self cancelTimer:connexion.hedgeTimer];
+        connexion.hedgeTimer = nil;
+        connexion.hedge = nil;
+        connexion.task = nil;
+
+        [self requestFailed:connexion];
+
+        connexion.followers = nil;
+    }
+}
+
+
+
+- (void)addConnexion:(Connexion *)connexion
+{
+    // Register a connexion whose task has been created, keyed by the task's identifier,
+    // so that the NSURLSession delegate methods can find it without walking the list
+
+    if (connexion == nil || connexion.task == nil) return;
+
+    connexion.taskIdentifier = (NSInteger)connexion.task.taskIdentifier;
+    [connexions setObject:connexion forKey:[NSNumber numberWithInteger:connexion.taskIdentifier]];
+
+    // Update the public property, numberOfConnections
+
+    numberOfConnections = connexions.count;
+}
+
+
+
+- (void)removeConnexion:(Connexion *)connexion
+{
+    // Remove a connexion from the list of in-flight connections
+    // NOTE we use the identifier recorded when the connexion was added, as the
+    //      connexion's 'task' property may have been cleared by now
+
+    if (connexion == nil || connexion.taskIdentifier == -1) return;
+
+    if (collectMetrics) [self recordMetrics:connexion];
+
+    [self cancelTimer:connexion.hedgeTimer];
+    connexion.hedgeTimer = nil;
+
+    NSNumber *key = [NSNumber numberWithInteger:connexion.taskIdentifier];
+
+    // Only remove the entry if it belongs to this connexion
+
+    if ([connexions objectForKey:key] == connexion) [connexions removeObjectForKey:key];
+
+    connexion.taskIdentifier = -1;
+    numberOfConnections = connexions.count;
+
+    // A slot may have been freed for a queued request
+
+    if (connexion.priority != -1) [self scheduleConnections];
+}
+
+
+
+- (Connexion *)connexionForTask:(NSURLSessionTask *)task
+{
+    // Returns the connexion instance representing the specified task, or nil
+
+    if (task == nil) return nil;
+
+    Connexion *connexion = [connexions objectForKey:[NSNumber numberWithInteger:(NSInteger)task.taskIdentifier]];
+
+    // Task identifiers are only unique within a session, so make sure we have the right one
+
+    return (connexion.task == task) ? connexion : nil;
+}
+
+
+
+#pragma mark - Retry and Hedging Methods
+
+
+- (BOOL)isRetryableRead:(Connexion *)connexion
+{
+    // Returns YES if the connexion is a scheduled GET, which can be sent again without side-effects.
+    // Log streams and access token requests have their own recovery processes
+
+    if (connexion == nil || connexion.priority == -1 || connexion.actionCode == kConnectTypeNone) return NO;
+
+    return ([connexion.originalRequest.HTTPMethod compare:@"GET"] == NSOrderedSame);
+}
+
+
+
+- (BOOL)isTransientError:(NSError *)error
+{
+    // Returns YES if a client-side error is one that may well not recur, eg. a timeout
+
+    if (error == nil || ![error.domain isEqualToString:NSURLErrorDomain]) return NO;
+
+    return (error.code == NSURLErrorTimedOut || error.code == NSURLErrorNetworkConnectionLost ||
+            error.code == NSURLErrorCannotConnectToHost || error.code == NSURLErrorDNSLookupFailed);
+}
+
+
+
+- (BOOL)isTransientStatus:(NSInteger)statusCode
+{
+    // Returns YES if a server error is one that may well not recur, eg. an overloaded load balancer
+
+    return (statusCode == 500 || statusCode == 502 || statusCode == 503 || statusCode == 504);
+}
+
+
+
+- (BOOL)retryConnexion:(Connexion *)connexion
+{
+    // Send a read which has failed in a way that may not recur again, after an exponentially increasing,
+    // randomized delay - provided it has attempts left and the retry budget allows. The read is put back
+    // at the front of its queue, as a rate-limited request is
+    // RETURNS:
+    //   YES if the read will be sent again, or NO if its failure should be reported
+
+    if (!retryReads || ![self isRetryableRead:connexion]) return NO;
+    if (connexion.retryCount >= maxRetries || ![self spendRetryBudget]) return NO;
+
+    NSTimeInterval delay = [self retryBackoff:connexion.retryCount];
+    connexion.retryCount += 1;
+
+    [self removeConnexion:connexion];
+
+    connexion.task = nil;
+    connexion.data = [NSMutableData dataWithCapacity:0];
+    connexion.listParser = nil;
+    connexion.errorCode = -1;
+
+    if (collectMetrics) [self metricsForAction:connexion.initialActionCode].retries += 1;
+
+    // Keep track of the read while it waits, so that it is not sent if the connections are killed meanwhile
+
+    if (retryingConnexions == nil) retryingConnexions = [[NSMutableSet alloc] init];
+    [retryingConnexions addObject:connexion];
+
+    [self performAfterDelay:delay :^{
+        [self resendConnexion:connexion];
+    }];
+
+    return YES;
+}
+
+
+
+- (void)resendConnexion:(Connexion *)connexion
+{
+    // Put a read being retried back at the front of its queue, unless the connections have been killed meanwhile
+
+    if (![retryingConnexions containsObject:connexion]) return;
+
+    [retryingConnexions removeObject:connexion];
+
+    if (collectMetrics) connexion.queuedTime = [NSProcessInfo processInfo].systemUptime;
+
+    [[connexionQueues objectAtIndex:connexion.priority] insertObject:connexion atIndex:0];
+    [self scheduleConnections];
+}
+
+
+
+- (NSTimeInterval)retryBackoff:(NSInteger)attempt
+{
+    // Returns the delay before the specified retry: a random time up to a limit which doubles with
+    // each attempt, so that clients which failed together do not all retry together
+
+    NSTimeInterval limit = kRetryDelayBase * pow(2.0, (double)attempt);
+
+    if (limit > kRetryDelayMax) limit = kRetryDelayMax;
+
+    return limit * ((double)arc4random_uniform(1001) / 1000.0);
+}
+
+
+
+- (BOOL)spendRetryBudget
+{
+    // Take a token from the retry budget for a retry or a hedged read. The budget is refilled by a
+    // fraction of a token for each new request, so that when the impCloud is struggling, the extra
+    // requests are capped at that fraction of the normal load rather than multiplying it
+    // RETURNS:
+    //   YES if a token was available, otherwise NO
+
+    if (retryBudget < 1.0) return NO;
+
+    retryBudget -= 1.0;
+    return YES;
+}
+
+
+
+- (void)depositRetryBudget
+{
+    retryBudget += kRetryBudgetRatio;
+
+    if (retryBudget > kRetryBudgetMax) retryBudget = kRetryBudgetMax;
+}
+
+
+
+- (BOOL)isHedgeableRead:(Connexion *)connexion
+{
+    // Only interactive reads - single records, eg. a device - are hedged: lists are retrieved
+    // page by page, which can't be duplicated mid-stream
+
+    return (hedgeReads && connexion.priority == kConnectPriorityInteractive && [self isRetryableRead:connexion]);
+}
+
+
+
+- (void)armHedge:(Connexion *)connexion
+{
+    // Set a timer to send a second copy of a read if it has had no response by the time that 'hedgePercentile'
+    // of recent reads of the same kind had completed. Such a read is likely to be one of the few stalled
+    // requests which set the tail latency, and a fresh request will usually overtake it
+
+    if (connexion.isHedge || connexion.hedge != nil || ![self isHedgeableRead:connexion]) return;
+
+    NSTimeInterval delay = [self hedgeDelay:connexion.initialActionCode];
+
+    if (delay <= 0) return;
+
+    [self cancelTimer:connexion.hedgeTimer];
+
+    connexion.hedgeTimer = [self makeTimer:delay :^{
+        connexion.hedgeTimer = nil;
+
+        [self launchHedge:connexion];
+    }];
+}
+
+
+
+- (void)launchHedge:(Connexion *)connexion
+{
+    // Send a second copy of a read which is still waiting for a response, if the access token, the rate
+    // limiter and the retry budget allow. The two reads are paired, and whichever completes first is
+    // processed, the other being cancelled
+
+    if (connexion.taskIdentifier == -1 || connexion.errorCode != -1 || connexion.hedge != nil) return;
+    if (![self isAccessTokenValid] || [self rateLimitDelay] > 0 || ![self spendRetryBudget]) return;
+
+    Connexion *hedge = [[Connexion alloc] init];
+    hedge.actionCode = connexion.actionCode;
+    hedge.initialActionCode = connexion.initialActionCode;
+    hedge.originalRequest = connexion.originalRequest;
+    hedge.data = [NSMutableData dataWithCapacity:0];
+    hedge.representedObject = connexion.representedObject;
+    hedge.cachedResponse = connexion.cachedResponse;
+    hedge.cacheGeneration = connexion.cacheGeneration;
+    hedge.priority = connexion.priority;
+    hedge.retryCount = connexion.retryCount;
+    hedge.isHedge = YES;
+    hedge.hedge = connexion;
+    connexion.hedge = hedge;
+
+    if (collectMetrics)
+    {
+        [self metricsForAction:connexion.initialActionCode].hedges += 1;
+        hedge.queuedTime = [NSProcessInfo processInfo].systemUptime;
+    }
+
+    if (rateLimitCapacity > 0) rateLimitTokens -= 1.0;
+
+    [self startConnexion:hedge];
+}
+
+
+
+- (BOOL)dropHedgedConnexion:(Connexion *)connexion
+{
+    // Called when one of a hedged pair of reads has failed. If the other is still in flight, ie. it has a
+    // live task and has not itself received an error status, discard the failed read, leaving the other
+    // to deliver the result. Otherwise the pair is broken up, and the failed read is handled as usual
+    // RETURNS:
+    //   YES if the read has been discarded, or NO if its failure should be handled as usual
+
+    Connexion *twin = connexion.hedge;
+
+    if (twin == nil) return NO;
+
+    BOOL inFlight = (twin.taskIdentifier != -1 && twin.errorCode < 400 &&
+                     [connexions objectForKey:[NSNumber numberWithInteger:twin.taskIdentifier]] == twin);
+
+    if (!inFlight)
+    {
+        twin.hedge = nil;
+        connexion.hedge = nil;
+        return NO;
+    }
+
+    [self unpairHedge:twin :connexion];
+    return YES;
+}
+
+
+
+- (void)settleHedge:(Connexion *)connexion
+{
+    // Called when a read has completed successfully: if it was hedged, cancel the other read of the pair,
+    // so that exactly one result is delivered
+
+    [self cancelTimer:connexion.hedgeTimer];
+    connexion.hedgeTimer = nil;
+
+    if (connexion.hedge != nil) [self unpairHedge:connexion :connexion.hedge];
+}
+
+
+
+- (void)unpairHedge:(Connexion *)survivor :(Connexion *)loser
+{
+    // Break up a hedged pair of reads, cancelling the loser's request. If the loser is the original read,
+    // the survivor takes on any callers which have since been attached to it
+
+    survivor.hedge = nil;
+    loser.hedge = nil;
+
+    if (!loser.isHedge)
+    {
+        survivor.followers = loser.followers;
+        loser.followers = nil;
+
+        if (loser.coalesceKey != nil && [coalescedReads objectForKey:loser.coalesceKey] == loser)
+        {
+            [coalescedReads setObject:survivor forKey:loser.coalesceKey];
+            survivor.coalesceKey = loser.coalesceKey;
+        }
+
+        loser.coalesceKey = nil;
+    }
+
+    NSURLSessionTask *task = loser.task;
+
+    [self removeConnexion:loser];
+
+    loser.task = nil;
+    loser.actionCode = kConnectTypeNone;
+
+    [task cancel];
+}
+
+
+
+- (void)recordLatency:(Connexion *)connexion
+{
+    // Add the time a successful read took to the recent history from which hedging delays are set
+
+    if (connexion.sentTime == 0 || ![self isHedgeableRead:connexion]) return;
+
+    if (latencyHistory == nil) latencyHistory = [[NSMutableDictionary alloc] init];
+
+    NSNumber *key = [NSNumber numberWithInteger:connexion.initialActionCode];
+    RingBuffer *history = [latencyHistory objectForKey:key];
+
+    if (history == nil)
+    {
+        history = [[RingBuffer alloc] initWithCapacity:kHedgeHistorySize];
+        [latencyHistory setObject:history forKey:key];
+    }
+
+    [history addObject:[NSNumber numberWithDouble:([NSProcessInfo processInfo].systemUptime - connexion.sentTime)]];
+}
+
+
+
+- (NSTimeInterval)hedgeDelay:(NSInteger)actionCode
+{
+    // Returns the 'hedgePercentile' latency of recent reads of the specified kind, or 0 if
+    // too few have completed for it to be meaningful
+
+    RingBuffer *history = [latencyHistory objectForKey:[NSNumber numberWithInteger:actionCode]];
+
+    if (history == nil || history.count < kHedgeMinimumSamples) return 0;
+
+    NSArray *latencies = [[history allObjects] sortedArrayUsingSelector:@selector(compare:)];
+    NSUInteger index = (NSUInteger)(hedgePercentile * (double)latencies.count);
+
+    if (index >= latencies.count) index = latencies.count - 1;
+
+    NSTimeInterval delay = [[latencies objectAtIndex:index] doubleValue];
+
+    return (delay < kHedgeMinimumDelay ? kHedgeMinimumDelay : delay);
+}
+
+
+
+#pragma mark - Session Pool Methods
+
+
+- (void)setSessionPool:(SessionPool *)pool
+{
+    // Send the instance's requests through a session pool's shared sessions, or through its own session if
+    // 'pool' is nil. Requests already in flight on the instance's own session are allowed to finish
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self setSessionPool:pool]; }];
+        return;
+    }
+
+    sessionPool = pool;
+
+    if (pool != nil && apiSession != nil)
+    {
+        [apiSession finishTasksAndInvalidate];
+        apiSession = nil;
+    }
+}
+
+
+
+#pragma mark - Processing Queue Methods
+
+
+- (void)setProcessingQueue:(dispatch_queue_t)queue
+{
+    // Set the serial queue on which the instance handles responses, posts its notifications and
+    // manages its state, or nil to use the main queue (the default). Responses are decoded on
+    // a concurrent queue when a processing queue has been set
+    // NOTE the queue can only be changed while no requests are in flight or waiting, so this
+    //      is best called before the first request is made, when it may be called on any thread
+
+    if (processingQueue != nil && ![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the current processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self setProcessingQueue:queue]; }];
+        return;
+    }
+
+    if (queue == processingQueue) return;
+
+    if (connexions.count > 0 || [self numberOfQueuedConnexions] > 0 || logStreams.count > 0)
+    {
+        errorMessage = @"The processing queue cannot be changed while requests are in progress.";
+        [self reportError];
+        return;
+    }
+
+    if (processingQueue != nil) dispatch_queue_set_specific(processingQueue, (__bridge const void *)self, NULL, NULL);
+
+    processingQueue = queue;
+    delegateQueue = nil;
+
+    if (queue != nil)
+    {
+        // Mark the queue so that we can tell when we are running on it, and wrap it
+        // for NSURLSession, which delivers its delegate callbacks to an operation queue
+
+        dispatch_queue_set_specific(queue, (__bridge const void *)self, (__bridge void *)self, NULL);
+
+        delegateQueue = [[NSOperationQueue alloc] init];
+        delegateQueue.underlyingQueue = queue;
+        delegateQueue.maxConcurrentOperationCount = 1;
+    }
+
+    // The session must be re-created to deliver its callbacks to the new queue
+
+    if (apiSession != nil)
+    {
+        [apiSession finishTasksAndInvalidate];
+        apiSession = nil;
+    }
+}
+
+
+
+- (BOOL)isOnProcessingQueue
+{
+    // Returns YES if the caller is running on the queue on which the instance manages its state
+
+    if (processingQueue == nil) return [NSThread isMainThread];
+
+    return (dispatch_get_specific((__bridge const void *)self) != NULL);
+}
+
+
+
+- (void)performOnProcessingQueue:(dispatch_block_t)block
+{
+    // Run the block on the processing queue once the current call has completed
+
+    dispatch_async((processingQueue != nil ? processingQueue : dispatch_get_main_queue()), block);
+}
+
+
+
+- (void)performOnProcessingQueueAndWait:(dispatch_block_t)block
+{
+    // Run the block on the processing queue and wait for it to complete,
+    // or just run it if we are already on the processing queue
+
+    if ([self isOnProcessingQueue])
+    {
+        block();
+        return;
+    }
+
+    dispatch_sync((processingQueue != nil ? processingQueue : dispatch_get_main_queue()), block);
+}
+
+
+
+- (void)performAfterDelay:(NSTimeInterval)delay :(dispatch_block_t)block
+{
+    // Run the block on the processing queue in 'delay' seconds' time
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)),
+                   (processingQueue != nil ? processingQueue : dispatch_get_main_queue()),
+                   block);
+}
+
+
+
+- (dispatch_source_t)makeTimer:(NSTimeInterval)delay :(dispatch_block_t)block
+{
+    // Create and start a one-shot timer which runs the block on the processing queue in 'delay'
+    // seconds' time, unless it is cancelled first with 'cancelTimer:'. Unlike NSTimer, this does
+    // not depend on the calling thread having a run loop
+    // RETURNS:
+    //   The timer
+
+    dispatch_source_t timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0,
+                                                     (processingQueue != nil ? processingQueue : dispatch_get_main_queue()));
+
+    dispatch_source_set_timer(timer, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), DISPATCH_TIME_FOREVER, NSEC_PER_SEC / 100);
+    dispatch_source_set_event_handler(timer, block);
+    dispatch_resume(timer);
+    return timer;
+}
+
+
+
+- (void)cancelTimer:(dispatch_source_t)timer
+{
+    // Stop a timer created with 'makeTimer::' from firing
+
+    if (timer != nil) dispatch_source_cancel(timer);
+}
+
+
+
+#pragma mark Completion Handlers
+
+
+- (void)performRequest:(void (^)(id someObject))request :(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler
+{
+    // Make any request with a completion handler in place of its notification
+    // PARAMETERS:
+    //   'request' is a block that makes the request, passing the object it is given to the request
+    //             method as its 'someObject' argument, eg. ^(id obj){ [api getDevice:devID :obj]; }
+    //   'queue' is the queue on which the completion handler will be called, or nil for the main queue
+    //   'handler' is called once, with the request's result or its error
+    // RETURNS:
+    //   Nothing
+
+    if (request == nil) return;
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self performRequest:request :queue :handler]; }];
+        return;
+    }
+
+    RequestCompletion *completion = [[RequestCompletion alloc] init];
+    completion.handler = handler;
+    completion.queue = queue;
+
+    NSDictionary *previousError = lastError;
+
+    request(completion);
+
+    // If the request method reported an error rather than making the request, eg. because an argument
+    // was missing, pass the error to the handler, which would otherwise never be called
+
+    if (!completion.isComplete && lastError != previousError) [self completeRequest:completion :nil :lastError];
+}
+
+
+
+- (void)getMyAccountWithCompletion:(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler
+{
+    [self performRequest:^(id someObject) { [self getMyAccount:someObject]; } :queue :handler];
+}
+
+
+
+- (void)getProductsWithCompletion:(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler
+{
+    [self performRequest:^(id someObject) { [self getProducts:someObject]; } :queue :handler];
+}
+
+
+
+- (void)getProductWithCompletion:(NSString *)productID :(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler
+{
+    [self performRequest:^(id someObject) { [self getProduct:productID :someObject]; } :queue :handler];
+}
+
+
+
+- (void)getDevicegroupsWithCompletion:(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler
+{
+    [self performRequest:^(id someObject) { [self getDevicegroups:someObject]; } :queue :handler];
+}
+
+
+
+- (void)getDevicegroupWithCompletion:(NSString *)devicegroupID :(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler
+{
+    [self performRequest:^(id someObject) { [self getDevicegroup:devicegroupID :someObject]; } :queue :handler];
+}
+
+
+
+- (void)getDevicesWithCompletion:(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler
+{
+    [self performRequest:^(id someObject) { [self getDevices:someObject]; } :queue :handler];
+}
+
+
+
+- (void)getDeviceWithCompletion:(NSString *)deviceID :(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler
+{
+    [self performRequest:^(id someObject) { [self getDevice:deviceID :someObject]; } :queue :handler];
+}
+
+
+
+- (void)getDeploymentsWithCompletion:(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler
+{
+    [self performRequest:^(id someObject) { [self getDeployments:someObject]; } :queue :handler];
+}
+
+
+
+- (void)getDeploymentWithCompletion:(NSString *)deploymentID :(dispatch_queue_t)queue :(BuildAPICompletionHandler)handler
+{
+    [self performRequest:^(id someObject) { [self getDeployment:deploymentID :someObject]; } :queue :handler];
+}
+
+
+
+- (void)relayResult:(NSString *)name :(NSDictionary *)dict
+{
+    // Deliver the result of a request: to its completion handler if it was made with one,
+    // otherwise to the host by posting the named notification with the result as its object
+
+    id object = [dict isKindOfClass:[NSDictionary class]] ? [dict objectForKey:@"object"] : nil;
+
+    if ([object isKindOfClass:[RequestCompletion class]])
+    {
+        NSMutableDictionary *result = [NSMutableDictionary dictionaryWithDictionary:dict];
+        [result removeObjectForKey:@"object"];
+        [self completeRequest:object :result :nil];
+        return;
+    }
+
+    [[NSNotificationCenter defaultCenter] postNotificationName:name object:dict];
+}
+
+
+
+- (void)completeRequest:(RequestCompletion *)completion :(NSDictionary *)result :(NSDictionary *)error
+{
+    // Call a request's completion handler on its chosen queue. A handler is only ever called once
+
+    if (completion == nil || completion.isComplete) return;
+
+    BuildAPICompletionHandler handler = completion.handler;
+    completion.isComplete = YES;
+    completion.handler = nil;
+
+    if (handler == nil) return;
+
+    dispatch_async((completion.queue != nil ? completion.queue : dispatch_get_main_queue()), ^{
+        handler(result, error);
+    });
+}
+
+
+
+#pragma mark - Metrics Methods
+
+
+- (void)recordMetrics:(Connexion *)connexion
+{
+    // Add a completed request's timings and counts to the metrics for its action
+
+    if (connexion.startTime == 0 || connexion.initialActionCode == kConnectTypeLogStream) return;
+
+    NSTimeInterval now = [NSProcessInfo processInfo].systemUptime;
+    ActionMetrics *action = [self metricsForAction:connexion.initialActionCode];
+
+    action.requests += 1;
+    action.bytesReceived += connexion.bytesReceived;
+
+    if (connexion.queuedTime > 0) [action.queueWait record:(connexion.startTime - connexion.queuedTime)];
+    if (connexion.firstByteTime > 0) [action.firstByte record:(connexion.firstByteTime - connexion.startTime)];
+    if (connexion.decodeTime > 0) [action.decode record:connexion.decodeTime];
+
+    [action.duration record:(now - connexion.startTime)];
+
+    if (connexion.errorCode > 0)
+    {
+        NSString *code = [NSString stringWithFormat:@"%li", (long)connexion.errorCode];
+        NSNumber *count = [action.statusCodes objectForKey:code];
+        [action.statusCodes setObject:[NSNumber numberWithUnsignedInteger:(count.unsignedIntegerValue + 1)] forKey:code];
+    }
+
+    // A request rejected by the rate limiter will be sent again, so it has not failed
+
+    if (connexion.errorCode != 429 && (connexion.errorCode < 200 || connexion.errorCode > 399)) action.failures += 1;
+
+    // Clear the timings, in case the connexion is sent again
+
+    connexion.startTime = 0;
+    connexion.firstByteTime = 0;
+    connexion.decodeTime = 0;
+    connexion.bytesReceived = 0;
+}
+
+
+
+- (ActionMetrics *)metricsForAction:(NSInteger)actionCode
+{
+    // Returns the metrics for the specified action, creating them if necessary
+
+    if (metrics == nil) metrics = [[NSMutableDictionary alloc] init];
+
+    NSNumber *key = [NSNumber numberWithInteger:actionCode];
+    ActionMetrics *action = [metrics objectForKey:key];
+
+    if (action == nil)
+    {
+        action = [[ActionMetrics alloc] init];
+        [metrics setObject:action forKey:key];
+    }
+
+    return action;
+}
+
+
+
+- (NSDictionary *)metricsSnapshot
+{
+    // Returns the metrics recorded since 'collectMetrics' was set or 'resetMetrics' was called
+    // RETURNS:
+    //   A dictionary with the keys 'actions' (a dictionary of each action's metrics, keyed by
+    //   action code), 'streams' (an array of each log stream's metrics) and 'interval' (the
+    //   number of seconds over which the metrics have been recorded)
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        __block NSDictionary *snapshot = nil;
+        [self performOnProcessingQueueAndWait:^{ snapshot = [self metricsSnapshot]; }];
+        return snapshot;
+    }
+
+    NSTimeInterval now = [NSProcessInfo processInfo].systemUptime;
+    NSMutableDictionary *actions = [[NSMutableDictionary alloc] init];
+    NSMutableArray *streams = [[NSMutableArray alloc] init];
+
+    for (NSNumber *key in metrics)
+    {
+        ActionMetrics *action = [metrics objectForKey:key];
+
+        [actions setObject:@{ @"requests" : [NSNumber numberWithUnsignedInteger:action.requests],
+                              @"failures" : [NSNumber numberWithUnsignedInteger:action.failures],
+                              @"retries" : [NSNumber numberWithUnsignedInteger:action.retries],
+                              @"hedges" : [NSNumber numberWithUnsignedInteger:action.hedges],
+                              @"cacheHits" : [NSNumber numberWithUnsignedInteger:action.cacheHits],
+                              @"bytesReceived" : [NSNumber numberWithUnsignedLongLong:action.bytesReceived],
+                              @"statusCodes" : [action.statusCodes copy],
+                              @"queueWait" : [action.queueWait snapshot],
+                              @"firstByte" : [action.firstByte snapshot],
+                              @"duration" : [action.duration snapshot],
+                              @"decode" : [action.decode snapshot] }
+                    forKey:key];
+    }
+
+    // Log stream rates are measured over the period since the previous snapshot
+
+    for (LogStream *stream in logStreams)
+    {
+        NSTimeInterval period = stream.sampleTime > 0 ? now - stream.sampleTime : 0;
+        double eventRate = period > 0 ? (stream.eventCount - stream.sampledEventCount) / period : 0;
+        double byteRate = period > 0 ? (stream.byteCount - stream.sampledByteCount) / period : 0;
+
+        [streams addObject:@{ @"devices" : [NSNumber numberWithUnsignedInteger:stream.devices.count],
+                              @"events" : [NSNumber numberWithUnsignedInteger:stream.eventCount],
+                              @"bytes" : [NSNumber numberWithUnsignedInteger:stream.byteCount],
+                              @"eventsPerSecond" : [NSNumber numberWithDouble:eventRate],
+                              @"bytesPerSecond" : [NSNumber numberWithDouble:byteRate] }];
+
+        stream.sampledEventCount = stream.eventCount;
+        stream.sampledByteCount = stream.byteCount;
+        stream.sampleTime = now;
+    }
+
+    return @{ @"actions" : actions,
+              @"streams" : streams,
+              @"interval" : [NSNumber numberWithDouble:(metricsStartTime > 0 ? now - metricsStartTime : 0)] };
+}
+
+
+
+- (void)resetMetrics
+{
+    // Discard the metrics recorded so far
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self resetMetrics]; }];
+        return;
+    }
+
+    [metrics removeAllObjects];
+    metricsStartTime = [NSProcessInfo processInfo].systemUptime;
+
+    for (LogStream *stream in logStreams)
+    {
+        stream.eventCount = 0;
+        stream.byteCount = 0;
+        stream.sampledEventCount = 0;
+        stream.sampledByteCount = 0;
+        stream.sampleTime = metricsStartTime;
+    }
+}
+
+
+
+- (void)setCollectMetrics:(BOOL)collect
+{
+    // Start or stop recording metrics. Starting discards any previously recorded. Default is NO
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self setCollectMetrics:collect]; }];
+        return;
+    }
+
+    if (collect && !collectMetrics) [self resetMetrics];
+
+    collectMetrics = collect;
+
+    [self setMetricsExportInterval:metricsExportInterval];
+}
+
+
+
+- (void)setMetricsExportInterval:(NSTimeInterval)interval
+{
+    // Sets the period (in seconds) at which, while metrics are being collected, a snapshot
+    // of them is posted to the host via 'BuildAPIMetrics'. 0 disables this. Default is 0
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self setMetricsExportInterval:interval]; }];
+        return;
+    }
+
+    if (interval < 0) interval = 0;
+    metricsExportInterval = interval;
+
+    [self cancelTimer:metricsTimer];
+    metricsTimer = nil;
+
+    if (collectMetrics && interval > 0)
+    {
+        metricsTimer = [self makeTimer:interval :^{
+            [self exportMetrics];
+        }];
+    }
+}
+
+
+
+- (void)exportMetrics
+{
+    // Post a snapshot of the metrics to the host, then schedule the next
+
+    [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPIMetrics" object:[self metricsSnapshot]];
+
+    [self setMetricsExportInterval:metricsExportInterval];
+}
+
+
+
+#pragma mark - Fleet Mirror Methods
+
+
+- (void)setUseFleetMirror:(BOOL)use
+{
+    // Sets whether the instance keeps a mirror of the account's products, device groups, devices
+    // and deployments, updated from every list, record and change it retrieves or makes. Clearing
+    // it discards the mirror. Default is NO
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self setUseFleetMirror:use]; }];
+        return;
+    }
+
+    useFleetMirror = use;
+
+    if (use)
+    {
+        if (fleetMirror == nil) fleetMirror = [[FleetMirror alloc] init];
+    }
+    else
+    {
+        fleetMirror = nil;
+    }
+
+    [self setMirrorSyncInterval:mirrorSyncInterval];
+}
+
+
+
+- (void)setMirrorSyncInterval:(NSTimeInterval)interval
+{
+    // Sets the period (in seconds) at which, while the fleet mirror is in use, the instance
+    // re-retrieves the lists it mirrors to pick up changes made elsewhere. 0 disables this.
+    // Default is 0
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self setMirrorSyncInterval:interval]; }];
+        return;
+    }
+
+    if (interval < 0) interval = 0;
+    mirrorSyncInterval = interval;
+
+    [self cancelTimer:mirrorSyncTimer];
+    mirrorSyncTimer = nil;
+
+    if (useFleetMirror && interval > 0)
+    {
+        mirrorSyncTimer = [self makeTimer:interval :^{
+            [self syncMirror];
+        }];
+    }
+}
+
+
+
+- (void)syncMirror
+{
+    // Re-retrieve the products, device groups and devices lists so that the mirror picks up changes made
+    // elsewhere, eg. in the impCentral web UI. The lists are gathered into arrays of their own, not the
+    // master arrays filled by the host's list requests, and the host is not notified of their results.
+    // With the response cache in use, pages which have not changed are revalidated rather than re-sent.
+    // Deployments are not re-retrieved: their list is capped at 'maxListCount' entries, so it can't be used
+    // to find deleted deployments, and it only changes through this instance's own actions or new builds,
+    // which the mirror records as they happen
+
+    if (isLoggedIn)
+    {
+        [self syncMirrorList:@"products" :kConnectTypeSyncProducts];
+        [self syncMirrorList:@"devicegroups" :kConnectTypeSyncDeviceGroups];
+        [self syncMirrorList:@"devices" :kConnectTypeSyncDevices];
+    }
+
+    [self setMirrorSyncInterval:mirrorSyncInterval];
+}
+
+
+
+- (void)syncMirrorList:(NSString *)path :(NSInteger)actionCode
+{
+    // Set up a GET request for one of the lists re-retrieved by 'syncMirror'. The connexion carries the
+    // array into which the list's pages are gathered, and passes it on to the request for each next page
+    // PARAMETERS:
+    //   'path' is the list's collection, eg. 'devices'
+    //   'actionCode' is the matching sync action, eg. kConnectTypeSyncDevices
+
+    NSMutableURLRequest *request = [self makeGETrequest:path :YES];
+
+    if (request)
+    {
+        [self launchConnection:request :actionCode :@{ @"sync" : [[NSMutableArray alloc] init] }];
+    }
+    else
+    {
+        errorMessage = [NSString stringWithFormat:@"Could not create a request to sync the %@ mirror.", path];
+        [self reportError];
+    }
+}
+
+
+
+- (void)mirrorList:(Connexion *)connexion :(NSArray *)list
+{
+    // Bring the mirror into line with a complete list of products, device groups, devices or deployments.
+    // Mirrored records missing from the list are removed only if the list is known to hold every record
+    // of its type, ie. it was not filtered, capped or missing pages
+    // PARAMETERS:
+    //   'connexion' is the connexion which retrieved the list's last page
+    //   'list' is the array holding all of the list's records
+
+    if (!useFleetMirror) return;
+
+    NSString *type = nil;
+
+    switch (connexion.actionCode)
+    {
+        case kConnectTypeGetProducts:
+        case kConnectTypeSyncProducts:
+            type = kFleetMirrorTypeProduct;
+            break;
+
+        case kConnectTypeGetDeviceGroups:
+        case kConnectTypeSyncDeviceGroups:
+            type = kFleetMirrorTypeDevicegroup;
+            break;
+
+        case kConnectTypeGetDevices:
+        case kConnectTypeSyncDevices:
+            type = kFleetMirrorTypeDevice;
+            break;
+
+        case kConnectTypeGetDeployments:
+            type = kFleetMirrorTypeDeployment;
+            break;
+
+        default:
+            return;
+    }
+
+    NSString *url = connexion.originalRequest.URL.absoluteString.stringByRemovingPercentEncoding;
+    BOOL isComplete = !connexion.isPartialList && [url rangeOfString:@"filter["].location == NSNotFound;
+
+    if (connexion.actionCode == kConnectTypeGetDeployments && list.count >= maxListCount) isComplete = NO;
+
+    [self postMirrorChanges:[fleetMirror updateRecords:list :type :isComplete]];
+}
+
+
+
+- (void)updateMirror:(Connexion *)connexion :(NSDictionary *)data
+{
+    // Apply the outcome of a successful request, other than for a list, to the mirror. A retrieved,
+    // created or updated record is added; otherwise the change is derived from the request itself, as
+    // the server returns no record for deletions or for device (un)assignments
+    // PARAMETERS:
+    //   'connexion' is the connexion which made the request
+    //   'data' is the decoded response
+
+    if (!useFleetMirror) return;
+
+    id record = [data isKindOfClass:[NSDictionary class]] ? [data objectForKey:@"data"] : nil;
+
+    if ([record isKindOfClass:[NSDictionary class]])
+    {
+        NSString *type = [fleetMirror typeOfRecord:record];
+        NSString *recordID = [record objectForKey:@"id"];
+        BOOL isNew = ([fleetMirror record:recordID :type] == nil);
+
+        if ([fleetMirror addRecord:record])
+        {
+            [self postMirrorChanges:@{ @"type" : type,
+                                       @"added" : (isNew ? @[ recordID ] : @[]),
+                                       @"updated" : (isNew ? @[] : @[ recordID ]),
+                                       @"removed" : @[] }];
+        }
+
+        return;
+    }
+
+    NSURLRequest *request = connexion.originalRequest;
+    NSArray *components = request.URL.pathComponents;
+    NSString *type = nil;
+    NSArray *deviceIDs = nil;
+    NSString *devicegroupID = nil;
+    BOOL isRemoval = NO;
+
+    switch (connexion.actionCode)
+    {
+        case kConnectTypeDeleteProduct:
+            type = kFleetMirrorTypeProduct;
+            isRemoval = YES;
+            break;
+
+        case kConnectTypeDeleteDeviceGroup:
+            type = kFleetMirrorTypeDevicegroup;
+            isRemoval = YES;
+            break;
+
+        case kConnectTypeDeleteDevice:
+            type = kFleetMirrorTypeDevice;
+            isRemoval = YES;
+            break;
+
+        case kConnectTypeDeleteDeployment:
+            type = kFleetMirrorTypeDeployment;
+            isRemoval = YES;
+            break;
+
+        case kConnectTypeAssignDevice:
+        case kConnectTypeAssignDevices:
+        case kConnectTypeUnassignDevice:
+        case kConnectTypeUnassignDevices:
+        {
+            // The request body lists the devices; the path, '.../devicegroups/{id}/relationships/devices',
+            // the device group they have been assigned to
+
+            NSDictionary *body = request.HTTPBody != nil ? [NSJSONSerialization JSONObjectWithData:request.HTTPBody options:0 error:nil] : nil;
+            NSArray *items = [body isKindOfClass:[NSDictionary class]] ? [body objectForKey:@"data"] : nil;
+
+            if (![items isKindOfClass:[NSArray class]]) return;
+
+            deviceIDs = [items valueForKey:@"id"];
+            type = kFleetMirrorTypeDevice;
+
+            if (connexion.actionCode == kConnectTypeAssignDevice || connexion.actionCode == kConnectTypeAssignDevices)
+            {
+                if (components.count < 4) return;
+
+                devicegroupID = [components objectAtIndex:(components.count - 3)];
+            }
+
+            break;
+        }
+
+        case kConnectTypeBulkOperation:
+        {
+            // Only bulk renames return records, which have been added above
+
+            BulkOperation *bulk = [connexion.representedObject objectForKey:@"bulk"];
+            NSDictionary *chunk = [connexion.representedObject objectForKey:@"chunk"];
+
+            deviceIDs = [chunk objectForKey:@"devices"];
+            type = kFleetMirrorTypeDevice;
+
+            if (bulk.operation == kBulkOperationDelete)
+            {
+                isRemoval = YES;
+            }
+            else if (bulk.operation == kBulkOperationAssign)
+            {
+                NSArray *pathComponents = [[chunk objectForKey:@"path"] pathComponents];
+
+                if (pathComponents.count < 4) return;
+
+                devicegroupID = [pathComponents objectAtIndex:(pathComponents.count - 3)];
+            }
+            else if (bulk.operation != kBulkOperationUnassign)
+            {
+                return;
+            }
+
+            break;
+        }
+
+        default:
+            return;
+    }
+
+    NSMutableArray *changed = [[NSMutableArray alloc] init];
+
+    if (isRemoval)
+    {
+        if (deviceIDs == nil) deviceIDs = @[ [components lastObject] ];
+
+        for (NSString *recordID in deviceIDs)
+        {
+            if ([fleetMirror removeRecord:recordID :type]) [changed addObject:recordID];
+        }
+
+        if (changed.count > 0) [self postMirrorChanges:@{ @"type" : type, @"added" : @[], @"updated" : @[], @"removed" : changed }];
+    }
+    else
+    {
+        [changed addObjectsFromArray:[fleetMirror moveDevices:deviceIDs :devicegroupID]];
+
+        if (changed.count > 0) [self postMirrorChanges:@{ @"type" : type, @"added" : @[], @"updated" : changed, @"removed" : @[] }];
+    }
+}
+
+
+
+- (void)postMirrorChanges:(NSDictionary *)changes
+{
+    // Notify the host of changes to the mirror, if there are any
+
+    if (changes == nil) return;
+
+    [self scheduleSnapshotSave];
+
+    [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPIFleetMirrorChanged" object:changes];
+}
+
+
+
+- (NSDictionary *)mirroredRecord:(NSString *)recordID :(NSString *)type
+{
+    // Returns the mirrored record of the specified type and ID, eg. a device's record, without a request
+    // PARAMETERS:
+    //   'recordID' is the record's ID
+    //   'type' is the record's type, eg. kFleetMirrorTypeDevice
+    // RETURNS:
+    //   The record, or nil if it is not mirrored
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        __block NSDictionary *record = nil;
+        [self performOnProcessingQueueAndWait:^{ record = [self mirroredRecord:recordID :type]; }];
+        return record;
+    }
+
+    return [fleetMirror record:recordID :type];
+}
+
+
+
+- (NSArray *)mirroredRecords:(NSString *)type
+{
+    // Returns all of the mirrored records of the specified type, eg. kFleetMirrorTypeProduct
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        __block NSArray *records = nil;
+        [self performOnProcessingQueueAndWait:^{ records = [self mirroredRecords:type]; }];
+        return records;
+    }
+
+    return fleetMirror != nil ? [fleetMirror records:type] : @[];
+}
+
+
+
+- (NSArray *)mirroredChildren:(NSString *)parentID :(NSString *)type
+{
+    // Returns the mirrored records of the specified type which belong to the specified parent
+    // PARAMETERS:
+    //   'parentID' is the ID of a product (for device groups) or a device group (for devices and
+    //              deployments), or nil for the records with no parent, eg. unassigned devices
+    //   'type' is the type of the records to return, eg. kFleetMirrorTypeDevice
+    // RETURNS:
+    //   An array of records, which is empty if there are none
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        __block NSArray *children = nil;
+        [self performOnProcessingQueueAndWait:^{ children = [self mirroredChildren:parentID :type]; }];
+        return children;
+    }
+
+    return fleetMirror != nil ? [fleetMirror children:parentID :type] : @[];
+}
+
+
+
+#pragma mark - Snapshot Methods
+
+
+- (BOOL)restoreSnapshot
+{
+    // Restore the access token and the fleet mirror saved by an earlier session at 'snapshotPath', so
+    // that the instance can be used, and the mirror read, at once without logging in or listing the fleet.
+    // The mirror's lists are then re-retrieved in the background to bring it up to date
+    // RETURNS:
+    //   YES if the snapshot was restored, otherwise NO, eg. if there is no snapshot or it is out of date
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        __block BOOL restored = NO;
+        [self performOnProcessingQueueAndWait:^{ restored = [self restoreSnapshot]; }];
+        return restored;
+    }
+
+    if (snapshotPath == nil || isLoggedIn) return NO;
+
+    // The file is mapped rather than copied into memory. NOTE the whole snapshot is still decoded, so
+    // restoring a large fleet costs one full JSON decode of its records
+
+    NSData *data = [NSData dataWithContentsOfFile:snapshotPath options:NSDataReadingMappedIfSafe error:nil];
+
+    if (data == nil) return NO;
+
+    NSDictionary *snapshot = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+
+    if (![snapshot isKindOfClass:[NSDictionary class]] || [[snapshot objectForKey:@"version"] integerValue] != kSnapshotVersion)
+    {
+        [self deleteSnapshot];
+        return NO;
+    }
+
+    // A snapshot made with a different endpoint, eg. a local test server, is of no use
+
+    NSString *endpoint = [snapshot objectForKey:@"endpoint"];
+    NSDictionary *savedToken = [snapshot objectForKey:@"token"];
+    NSString *refreshToken = [savedToken objectForKey:@"refreshToken"];
+    NSString *loginKey = [savedToken objectForKey:@"loginKey"];
+
+    if (![endpoint isKindOfClass:[NSString class]] || [[snapshot objectForKey:@"customEndpoint"] boolValue] != useCustomEndpoint
+        || (useCustomEndpoint && ![endpoint isEqualToString:baseURL]))
+    {
+        [self deleteSnapshot];
+        return NO;
+    }
+
+    if (![savedToken isKindOfClass:[NSDictionary class]] || (refreshToken.length == 0 && loginKey.length == 0))
+    {
+        [self deleteSnapshot];
+        return NO;
+    }
+
+    // Restore the token: its expiry is recalculated from its expiry date
+
+    token = [[Token alloc] init];
+    token.accessToken = [savedToken objectForKey:@"accessToken"];
+    token.expiryDate = [savedToken objectForKey:@"expiryDate"];
+    token.refreshToken = refreshToken;
+    token.loginKey = loginKey;
+    token.account = [savedToken objectForKey:@"account"];
+    token.lifetime = 0;
+    token.hasExpiryTime = NO;
+
+    NSString *account = [snapshot objectForKey:@"account"];
+
+    baseURL = endpoint;
+    impCloudCode = [[snapshot objectForKey:@"cloud"] integerValue];
+    currentAccount = account.length > 0 ? account : nil;
+    snapshotAccount = currentAccount;
+    snapshotCloudCode = impCloudCode;
+    isLoggedIn = YES;
+
+    [self scheduleTokenRefresh];
+
+    // Restore the mirror. Its records are not removed from the lists when they are re-retrieved
+
+    NSDictionary *records = [snapshot objectForKey:@"records"];
+
+    if ([records isKindOfClass:[NSDictionary class]])
+    {
+        [self setUseFleetMirror:YES];
+
+        for (NSString *type in records)
+        {
+            NSArray *list = [records objectForKey:type];
+            if ([list isKindOfClass:[NSArray class]]) [fleetMirror updateRecords:list :type :NO];
+        }
+
+        // Revalidate the mirror in the background
+
+        [self performOnProcessingQueue:^{
+            [self syncMirror];
+        }];
+    }
+
+    return YES;
+}
+
+
+
+- (void)saveSnapshot
+{
+    // Write the access token and the fleet mirror to 'snapshotPath'. The snapshot is gathered here,
+    // on the processing queue, but it is encoded and written on 'snapshotQueue'. The file is
+    // readable only by its owner, as it contains the token
+
+    [self cancelTimer:snapshotTimer];
+    snapshotTimer = nil;
+
+    if (snapshotPath == nil || token == nil || !isLoggedIn) return;
+
+    NSMutableDictionary *savedToken = [[NSMutableDictionary alloc] init];
+
+    if (token.accessToken != nil) [savedToken setObject:token.accessToken forKey:@"accessToken"];
+    if (token.expiryDate != nil) [savedToken setObject:token.expiryDate forKey:@"expiryDate"];
+    if (token.refreshToken != nil) [savedToken setObject:token.refreshToken forKey:@"refreshToken"];
+    if (token.loginKey != nil) [savedToken setObject:token.loginKey forKey:@"loginKey"];
+    if (token.account != nil) [savedToken setObject:token.account forKey:@"account"];
+
+    NSMutableDictionary *records = [[NSMutableDictionary alloc] init];
+
+    if (fleetMirror != nil)
+    {
+        for (NSString *type in @[ kFleetMirrorTypeProduct, kFleetMirrorTypeDevicegroup, kFleetMirrorTypeDevice, kFleetMirrorTypeDeployment ])
+        {
+            [records setObject:[fleetMirror records:type] forKey:type];
+        }
+    }
+
+    NSDictionary *snapshot = @{ @"version" : [NSNumber numberWithInteger:kSnapshotVersion],
+                                @"account" : (currentAccount != nil ? currentAccount : @""),
+                                @"cloud" : [NSNumber numberWithInteger:impCloudCode],
+                                @"endpoint" : baseURL,
+                                @"customEndpoint" : [NSNumber numberWithBool:useCustomEndpoint],
+                                @"token" : savedToken,
+                                @"records" : records };
+
+    NSString *path = snapshotPath;
+
+    dispatch_async(snapshotQueue, ^{
+        NSError *error = nil;
+        NSData *data = [NSJSONSerialization dataWithJSONObject:snapshot options:0 error:&error];
+
+        if (data != nil && [self writeSnapshotFile:data :path]) return;
+
+#ifdef DEBUG
+        NSLog(@"Could not save snapshot: %@", (error != nil ? error.localizedDescription : [NSString stringWithUTF8String:strerror(errno)]));
+#endif
+    });
+}
+
+
+
+- (BOOL)writeSnapshotFile:(NSData *)data :(NSString *)path
+{
+    // Write the snapshot to a new temporary file, which is created readable only by its owner, as it
+    // contains the token, and then move it into place, so the snapshot is never partly written.
+    // Called on 'snapshotQueue'
+    // RETURNS:
+    //   YES if the snapshot was written, otherwise NO
+
+    NSString *tempPath = [path stringByAppendingFormat:@".%@", [NSUUID UUID].UUIDString];
+    int fd = open(tempPath.fileSystemRepresentation, O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+
+    if (fd == -1) return NO;
+
+    const uint8_t *bytes = data.bytes;
+    NSUInteger remaining = data.length;
+    BOOL success = YES;
+
+    while (remaining > 0)
+    {
+        ssize_t written = write(fd, bytes, remaining);
+
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+
+            success = NO;
+            break;
+        }
+
+        bytes += written;
+        remaining -= (NSUInteger)written;
+    }
+
+    if (success && fsync(fd) != 0) success = NO;
+    if (close(fd) != 0) success = NO;
+
+    if (success && rename(tempPath.fileSystemRepresentation, path.fileSystemRepresentation) == 0) return YES;
+
+    unlink(tempPath.fileSystemRepresentation);
+    return NO;
+}
+
+
+
+- (void)scheduleSnapshotSave
+{
+    // Save the snapshot shortly, so that a burst of changes, eg. the pages of a list, is saved once
+
+    if (snapshotPath == nil || snapshotTimer != nil) return;
+
+    snapshotTimer = [self makeTimer:kSnapshotSaveDelay :^{
+        [self saveSnapshot];
+    }];
+}
+
+
+
+- (void)deleteSnapshot
+{
+    // Remove the snapshot file, cancelling any pending save
+
+    [self cancelTimer:snapshotTimer];
+    snapshotTimer = nil;
+
+    if (snapshotPath == nil) return;
+
+    NSString *path = snapshotPath;
+
+    dispatch_async(snapshotQueue, ^{
+        [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    });
+}
+
+
+
+- (void)validateSnapshot
+{
+    // Called when the account or the impCloud in use may have changed. If either differs from
+    // the one the mirror and snapshot were made for, discard them, as they are another fleet's
+
+    BOOL accountChanged = (snapshotAccount != nil && currentAccount != nil && ![currentAccount isEqualToString:snapshotAccount]);
+    BOOL cloudChanged = (snapshotCloudCode != -1 && impCloudCode != -1 && impCloudCode != snapshotCloudCode);
+
+    if (accountChanged || cloudChanged)
+    {
+        [fleetMirror clear];
+        [self deleteSnapshot];
+    }
+
+    if (currentAccount != nil) snapshotAccount = currentAccount;
+    if (impCloudCode != -1) snapshotCloudCode = impCloudCode;
+
+    [self scheduleSnapshotSave];
+}
+
+
+
+- (void)setCurrentAccount:(NSString *)account
+{
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self setCurrentAccount:account]; }];
+        return;
+    }
+
+    currentAccount = account;
+
+    [self validateSnapshot];
+}
+
+
+
+#pragma mark - Compact Record Methods
+
+
+- (NSString *)collectionForAction:(NSInteger)actionCode
+{
+    // Returns the name of the collection retrieved by a product, device group, device or deployment
+    // list request, or nil for any other action
+
+    switch (actionCode)
+    {
+        case kConnectTypeGetProducts:
+        case kConnectTypeSyncProducts:
+            return @"products";
+
+        case kConnectTypeGetDeviceGroups:
+        case kConnectTypeSyncDeviceGroups:
+            return @"devicegroups";
+
+        case kConnectTypeGetDevices:
+        case kConnectTypeSyncDevices:
+            return @"devices";
+
+        case kConnectTypeGetDeployments:
+            return @"deployments";
+
+        default:
+            return nil;
+    }
+}
+
+
+
+- (NSSet *)fieldsForAction:(NSInteger)actionCode
+{
+    // Returns the fields the host has asked for in the records of the list retrieved by the
+    // specified action, or nil if it wants every field
+
+    NSString *collection = [self collectionForAction:actionCode];
+    NSArray *fields = collection != nil ? [listFields objectForKey:collection] : nil;
+
+    return ([fields isKindOfClass:[NSArray class]] && fields.count > 0) ? [NSSet setWithArray:fields] : nil;
+}
+
+
+
+- (NSString *)addFieldsToPath:(NSString *)path
+{
+    // Add a JSON:API sparse fieldset to the path of a list request, eg. 'devices?fields[device]=name,device_online',
+    // if the host has specified the fields it needs from that collection's records
+    // NOTE The paths of further pages come from the server's links, which may already include the fieldset
+    // RETURNS:
+    //   The path, with or without the fieldset
+
+    if (listFields == nil || path == nil) return path;
+    if ([path containsString:@"fields["] || [path containsString:@"fields%5B"]) return path;
+
+    NSRange queryRange = [path rangeOfString:@"?"];
+    NSString *collection = queryRange.location != NSNotFound ? [path substringToIndex:queryRange.location] : path;
+
+    if (baseURL != nil && [collection hasPrefix:baseURL]) collection = [collection substringFromIndex:baseURL.length];
+    if ([collection hasPrefix:@"/"]) collection = [collection substringFromIndex:1];
+
+    NSArray *fields = [listFields objectForKey:collection];
+
+    if (![fields isKindOfClass:[NSArray class]] || fields.count == 0) return path;
+
+    // Fieldsets are keyed by record type, and device groups come in several types
+
+    NSArray *types = nil;
+
+    if ([collection isEqualToString:@"products"]) types = @[ @"product" ];
+    if ([collection isEqualToString:@"devices"]) types = @[ @"device" ];
+    if ([collection isEqualToString:@"deployments"]) types = @[ @"deployment" ];
+    if ([collection isEqualToString:@"devicegroups"]) types = @[ @"development_devicegroup", @"pre_production_devicegroup", @"pre_dut_devicegroup",
+                                                                 @"pre_factoryfixture_devicegroup", @"production_devicegroup", @"dut_devicegroup",
+                                                                 @"factoryfixture_devicegroup" ];
+
+    if (types == nil) return path;
+
+    NSString *fieldList = [fields componentsJoinedByString:@","];
+    NSMutableArray *fieldsets = [[NSMutableArray alloc] initWithCapacity:types.count];
+
+    for (NSString *type in types) [fieldsets addObject:[NSString stringWithFormat:@"fields[%@]=%@", type, fieldList]];
+
+    return [path stringByAppendingFormat:@"%@%@", (queryRange.location != NSNotFound ? @"&" : @"?"), [fieldsets componentsJoinedByString:@"&"]];
+}
+
+
+
+- (NSDictionary *)compactListData:(Connexion *)connexion :(NSDictionary *)data
+{
+    // Convert the records in a page of a product, device group, device or deployment list to CompactRecords,
+    // unless they were converted as they arrived
+    // RETURNS:
+    //   The page, with its records converted
+
+    if (!useCompactRecords || [self collectionForAction:connexion.actionCode] == nil) return data;
+
+    NSArray *records = [data objectForKey:@"data"];
+
+    if (![records isKindOfClass:[NSArray class]] || records.count == 0) return data;
+    if ([records.firstObject isKindOfClass:[CompactRecord class]]) return data;
+
+    NSMutableDictionary *compactData = [NSMutableDictionary dictionaryWithDictionary:data];
+    [compactData setObject:[recordDecoder decodeRecords:records :[self fieldsForAction:connexion.actionCode]] forKey:@"data"];
+    return compactData;
+}
+
+
+
+#pragma mark - Response Cache Methods
+
+
+- (NSString *)cacheKeyForConnexion:(Connexion *)connexion
+{
+    // Returns the key under which the response to the connexion's request is cached, or nil if
+    // the response is not cacheable, ie. the request is not a GET, or it is for a page of a list.
+    // List pages are decoded as they arrive, so caching them would mean keeping their raw bytes too
+
+    NSURLRequest *request = connexion.originalRequest;
+
+    if (!useResponseCache || request == nil) return nil;
+    if ([request.HTTPMethod compare:@"GET"] != NSOrderedSame) return nil;
+    if ([self isListAction:connexion.actionCode]) return nil;
+
+    return request.URL.absoluteString;
+}
+
+
+
+- (BOOL)serveFromCache:(Connexion *)connexion
+{
+    // If the response to the connexion's request is cached and has been validated by the server within
+    // the last 'responseCacheLifetime' seconds, complete the connexion from the cache without a request
+    // RETURNS:
+    //   YES if the connexion will be completed from the cache, otherwise NO
+
+    if (responseCacheLifetime <= 0) return NO;
+
+    NSString *key = [self cacheKeyForConnexion:connexion];
+
+    if (key == nil) return NO;
+
+    CachedResponse *cachedResponse = [responseCache objectForKey:key];
+
+    if (cachedResponse == nil || cachedResponse.data == nil) return NO;
+    if ([NSProcessInfo processInfo].systemUptime - cachedResponse.timestamp > responseCacheLifetime) return NO;
+
+    connexion.cachedResponse = cachedResponse;
+
+    // Complete the connexion once the current call has completed, so that whoever
+    // launched it has had the chance to finish setting up its connexion
+
+    [self performOnProcessingQueue:^{
+        [self completeFromCache:connexion];
+    }];
+    return YES;
+}
+
+
+
+- (void)completeFromCache:(Connexion *)connexion
+{
+    // Process a cached response as if it had just been received from the server
+
+    connexion.data = [connexion.cachedResponse.data mutableCopy];
+    connexion.errorCode = 200;
+
+    if (collectMetrics) [self metricsForAction:connexion.actionCode].cacheHits += 1;
+
+    [self processResult:connexion :[self processConnection:connexion]];
+}
+
+
+
+- (void)applyCacheValidators:(Connexion *)connexion
+{
+    // Add the validators of any cached response to the connexion's request, so that the server
+    // can respond with status code 304 and no body if the response has not changed
+
+    NSString *key = [self cacheKeyForConnexion:connexion];
+
+    if (key == nil) return;
+
+    CachedResponse *cachedResponse = [responseCache objectForKey:key];
+
+    if (cachedResponse != nil && cachedResponse.data != nil)
+    {
+        if (cachedResponse.etag != nil) [connexion.originalRequest setValue:cachedResponse.etag forHTTPHeaderField:@"If-None-Match"];
+        if (cachedResponse.lastModified != nil) [connexion.originalRequest setValue:cachedResponse.lastModified forHTTPHeaderField:@"If-Modified-Since"];
+    }
+    else
+    {
+        [connexion.originalRequest setValue:nil forHTTPHeaderField:@"If-None-Match"];
+        [connexion.originalRequest setValue:nil forHTTPHeaderField:@"If-Modified-Since"];
+    }
+
+    // Hold on to the cached response (it may be invalidated before the server responds)
+    // and note the cache generation so we know whether this response may be stored
+
+    connexion.cachedResponse = cachedResponse;
+    connexion.cacheGeneration = cacheGeneration;
+}
+
+
+
+- (BOOL)validateCachedResponse:(Connexion *)connexion :(NSHTTPURLResponse *)response
+{
+    // Called when the server has responded to a cacheable request. For a 304, load the cached response into
+    // the connexion; for a 200, prepare a new cache entry from the response's validators
+    // RETURNS:
+    //   YES if the connexion has been loaded from the cache, otherwise NO
+
+    if ([self cacheKeyForConnexion:connexion] == nil) return NO;
+
+    if (response.statusCode == 304)
+    {
+        if (connexion.cachedResponse == nil || connexion.cachedResponse.data == nil) return NO;
+
+        connexion.cachedResponse.timestamp = [NSProcessInfo processInfo].systemUptime;
+        connexion.data = [connexion.cachedResponse.data mutableCopy];
+        return YES;
+    }
+
+    connexion.cachedResponse = nil;
+
+    if (response.statusCode == 200)
+    {
+        NSString *etag = [response.allHeaderFields objectForKey:@"ETag"];
+        NSString *lastModified = [response.allHeaderFields objectForKey:@"Last-Modified"];
+
+        // A response without validators can only be re-used within the lifetime
+
+        if (etag == nil && lastModified == nil && responseCacheLifetime <= 0) return NO;
+
+        CachedResponse *cachedResponse = [[CachedResponse alloc] init];
+        cachedResponse.etag = etag;
+        cachedResponse.lastModified = lastModified;
+        cachedResponse.generation = connexion.cacheGeneration;
+        connexion.cachedResponse = cachedResponse;
+    }
+
+    return NO;
+}
+
+
+
+- (void)cacheResponse:(Connexion *)connexion
+{
+    // Store the completed response prepared by 'validateCachedResponse::', unless the cache
+    // has been invalidated since the request was sent, in which case it may already be stale
+
+    CachedResponse *cachedResponse = connexion.cachedResponse;
+
+    if (cachedResponse == nil || cachedResponse.data != nil || connexion.errorCode != 200) return;
+    if (cachedResponse.generation != cacheGeneration) return;
+
+    NSString *key = [self cacheKeyForConnexion:connexion];
+
+    if (key == nil) return;
+
+    cachedResponse.data = [connexion.data copy];
+    cachedResponse.timestamp = [NSProcessInfo processInfo].systemUptime;
+
+    if (responseCache == nil) responseCache = [[NSMutableDictionary alloc] init];
+
+    if (responseCache.count >= kResponseCacheMaxEntries && [responseCache objectForKey:key] == nil)
+    {
+        // Make room by evicting the least recently validated response
+
+        NSString *oldestKey = nil;
+        NSTimeInterval oldest = 0;
+
+        for (NSString *aKey in responseCache)
+        {
+            CachedResponse *aResponse = [responseCache objectForKey:aKey];
+
+            if (oldestKey == nil || aResponse.timestamp < oldest)
+            {
+                oldestKey = aKey;
+                oldest = aResponse.timestamp;
+            }
+        }
+
+        if (oldestKey != nil) [responseCache removeObjectForKey:oldestKey];
+    }
+
+    [responseCache setObject:cachedResponse forKey:key];
+}
+
+
+
+- (void)invalidateCacheForAction:(NSInteger)actionCode
+{
+    // Remove the cached responses that may have been made stale by a successful mutation: every
+    // response for the resource types the action affects, including lists and related resources
+
+    NSArray *types = nil;
+
+    switch (actionCode)
+    {
+        case kConnectTypeCreateProduct:
+        case kConnectTypeUpdateProduct:
+        case kConnectTypeDeleteProduct:
+            types = @[ @"products", @"devicegroups" ];
+            break;
+
+        case kConnectTypeCreateDeviceGroup:
+        case kConnectTypeUpdateDeviceGroup:
+        case kConnectTypeDeleteDeviceGroup:
+        case kConnectTypeRestartDevices:
+            types = @[ @"devicegroups", @"devices", @"deployments" ];
+            break;
+
+        case kConnectTypeCreateDeployment:
+        case kConnectTypeUpdateDeployment:
+        case kConnectTypeDeleteDeployment:
+        case kConnectTypeSetMinDeployment:
+            types = @[ @"deployments", @"devicegroups" ];
+            break;
+
+        case kConnectTypeUpdateDevice:
+        case kConnectTypeDeleteDevice:
+        case kConnectTypeAssignDevice:
+        case kConnectTypeAssignDevices:
+        case kConnectTypeUnassignDevice:
+        case kConnectTypeUnassignDevices:
+        case kConnectTypeRestartDevice:
+        case kConnectTypeBulkOperation:
+            types = @[ @"devices", @"devicegroups" ];
+            break;
+
+        case kConnectTypeCreateWebhook:
+        case kConnectTypeUpdateWebhook:
+        case kConnectTypeDeleteWebhook:
+            types = @[ @"webhooks" ];
+            break;
+
+        default:
+            return;
+    }
+
+    // Responses in flight must not now be stored
+
+    ++cacheGeneration;
+
+    if (responseCache.count == 0) return;
+
+    NSMutableArray *staleKeys = [[NSMutableArray alloc] init];
+
+    for (NSString *key in responseCache)
+    {
+        NSArray *components = [NSURL URLWithString:key].pathComponents;
+
+        for (NSString *type in types)
+        {
+            if ([components containsObject:type])
+            {
+                [staleKeys addObject:key];
+                break;
+            }
+        }
+    }
+
+    [responseCache removeObjectsForKeys:staleKeys];
+}
+
+
+
+- (void)clearResponseCache
+{
+    // Empty the response cache, eg. when the user logs out
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self clearResponseCache]; }];
+        return;
+    }
+
+    [responseCache removeAllObjects];
+    ++cacheGeneration;
+}
+
+
+
+#pragma mark - Log Stream Methods
+
+
+- (void)startLogging:(NSString *)deviceID
+{
+    [self startLogging:deviceID :nil];
+}
+
+
+
+- (void)startLogging:(NSString *)deviceID :(id)someObject
+{
+    // Begin logging for the specified device ID. Logging devices are spread across as many
+    // log streams as are needed to accommodate them, up to 'kLogMaxDevicesPerLog' per stream
+    // PARAMETERS:
+    //   'deviceID' is the device's ID
+    //   'someObject' is an optional object, supplied by the host app, that is bound to this request
+    //                and follows it through sending and processing the response from the server
+    // RETURNS:
+    //   Nothing
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self startLogging:deviceID :someObject]; }];
+        return;
+    }
+
+    if (deviceID == nil || deviceID.length == 0)
+    {
+        // No device ID? Can't proceed
+
+        errorMessage = @"Could not create a request to stream the device logs: no device specified.";
+        [self reportError];
+        return;
+    }
+
+    if (loggingDevices == nil) loggingDevices = [[NSMutableArray alloc] init];
+
+    [self addDeviceToLogStream:deviceID :someObject];
+}
+
+
+
+- (void)addDeviceToLogStream:(NSString *)deviceID :(id)someObject
+{
+    // Add a device to a log stream that has room for it, or to a new log stream if
+    // none of the existing streams do
+    // PARAMETERS:
+    //   'deviceID' is the device's ID
+    //   'someObject' is an optional object, supplied by the host app, that is bound to this request
+    //                and follows it through sending and processing the response from the server
+    // RETURNS:
+    //   Nothing
+
+    // First check that the device is not already logging (or about to be); if it is, bail
+
+    if ([self logStreamForDevice:deviceID] != nil) return;
+
+    // Find a stream with room for the device
+
+    LogStream *stream = nil;
+
+    for (LogStream *aStream in logStreams)
+    {
+        if (aStream.devices.count < kLogMaxDevicesPerLog)
+        {
+            stream = aStream;
+            break;
+        }
+    }
+
+    if (stream == nil)
+    {
+        // All of the streams are full, or there are none, so we need a new one
+
+        if (logStreams.count >= kLogMaxStreams)
+        {
+            errorMessage = @"Maximum number of logging devices already reached";
+            [self reportError];
+            return;
+        }
+
+        // We first need to get the new stream's ID and URL
+
+        NSMutableURLRequest *request = [self makePOSTrequest:@"logstream?format=json" :nil];
+
+        if (request == nil)
+        {
+            errorMessage = @"Could not create a request to stream the specified device logs.";
+            [self reportError];
+            return;
+        }
+
+        if (logStreams == nil) logStreams = [[NSMutableArray alloc] init];
+
+        stream = [[LogStream alloc] init];
+        stream.retryInterval = logRetryInterval;
+
+        [logStreams addObject:stream];
+
+        // Pass in the stream so we have it to use after the stream ID has been received
+
+        [self launchConnection:request :kConnectTypeLogGetStreamID :@{ @"stream" : stream }];
+    }
+
+    // Reserve the device's place in the stream
+
+    [stream.devices addObject:deviceID];
+
+    if (stream.isOpen)
+    {
+        [self subscribeDevice:deviceID :someObject :stream];
+    }
+    else
+    {
+        // The stream has yet to open, so hold the device until it has
+
+        NSDictionary *dict = someObject != nil
+        ? @{ @"device" : deviceID, @"object" : someObject }
+        : @{ @"device" : deviceID };
+
+        [stream.pendingDevices addObject:dict];
+    }
+}
+
+
+
+- (void)subscribeDevice:(NSString *)deviceID :(id)someObject :(LogStream *)stream
+{
+    // Add a device to an open log stream
+    // Make a PUT request with {device identifier} to /logstream/{stream_id}
+    // {device identifier} eg. { id: ‘d9f6f253-d203-487f-bdb0-70ea1529ee1b’, type: ‘device’ }
+    // PARAMETERS:
+    //   'deviceID' is the device's ID
+    //   'someObject' is an optional object, supplied by the host app, that is bound to this request
+    //                and follows it through sending and processing the response from the server
+    //   'stream' is the log stream the device has been assigned to
+    // RETURNS:
+    //   Nothing
+
+    NSDictionary *dict = @{ @"id" : deviceID,
+                            @"type" : @"device" };
+
+    NSMutableURLRequest *request = [self makePUTrequest:[NSString stringWithFormat:@"%@/%@", stream.url.absoluteString, deviceID] :dict];
+
+    if (request)
+    {
+        dict = (someObject != nil)
+        ? @{ @"device" : deviceID, @"object" : someObject, @"stream" : stream }
+        : @{ @"device" : deviceID, @"stream" : stream };
+
+        [self launchConnection:request :kConnectTypeLogStreamAdd :dict];
+    }
+    else
+    {
+        [stream.devices removeObject:deviceID];
+
+        errorMessage = @"Could not create a request to stream the specified device logs.";
+        [self reportError];
+    }
+}
+
+
+
+- (void)stopLogging:(NSString *)deviceID
+{
+    [self stopLogging:deviceID :nil];
+}
+
+
+
+- (void)stopLogging:(NSString *)deviceID :(id)someObject
+{
+    // Remove the specified device from the log stream it has been assigned to
+    // ie. make a DELETE reqyest to /logstream/{stream_id}/{device_identifier}
+    // {device_identifier} eg. {id: ‘d9f6f253-d203-487f-bdb0-70ea1529ee1b’, type: ‘device’}
+    // PARAMETERS:
+    //   'deviceID' is the device's ID
+    //   'someObject' is an optional object, supplied by the host app, that is bound to this request
+    //                and follows it through sending and processing the response from the server
+    // RETURNS:
+    //   Nothing
+
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self stopLogging:deviceID :someObject]; }];
+        return;
+    }
+
+    LogStream *stream = [self logStreamForDevice:deviceID];
+
+    if (stream == nil)
+    {
+        errorMessage = @"Could not create a request to stop streaming the specified device logs: the device is not logging.";
+        [self reportError];
+        return;
+    }
+
+    NSDictionary *dict = @{ @"id" : deviceID,
+                            @"type" : @"device" };
+
+    NSMutableURLRequest *request = [self makeRequest:@"DELETE" :[NSString stringWithFormat:@"%@/%@", stream.url.absoluteString, deviceID] :NO :NO];
+    NSError *error;
+
+    request.HTTPBody = [NSJSONSerialization dataWithJSONObject:dict options:0 error:&error];
+
+    if (error)
+    {
+        errorMessage = @"Could not create a request to stop streaming the specified device logs: bad JSON data.";
+        [self reportError];
+        return;
+    }
+
+    if (request)
+    {
+        dict = (someObject != nil)
+        ? @{ @"device" : deviceID, @"object" : someObject }
+        : @{ @"device" : deviceID };
+
+        [self launchConnection:request :kConnectTypeLogStreamEnd :dict];
+    }
+    else
+    {
+        errorMessage = @"Could not create a request to stop streaming the specified device logs.";
+        [self reportError];
+    }
+}
+
+
+
+- (void)restartLogging:(LogStream *)stream
+{
+    // This is called if a log stream signals its closure, so enable logging to auto-restart:
+    // get a new stream for the closed stream's devices, which will be re-subscribed when it opens
+    // POST-ing to /logstream will return a stream ID by way of a 302, which we will trap later
+
+    NSMutableURLRequest *request = [self makePOSTrequest:@"logstream?format=json" :nil];
+
+    if (request)
+    {
+        [stream.pendingDevices removeAllObjects];
+
+        for (NSString *deviceID in stream.devices) [stream.pendingDevices addObject:@{ @"device" : deviceID }];
+
+        stream.lastEventID = nil;
+        stream.reconnectAttempts = 0;
+
+        if (logStreams == nil) logStreams = [[NSMutableArray alloc] init];
+        if (![logStreams containsObject:stream]) [logStreams addObject:stream];
+
+        [self launchConnection:request :kConnectTypeLogGetStreamID :@{ @"stream" : stream }];
+    }
+    else
+    {
+        errorMessage = @"Could not create a request to stream the specified device logs.";
+        [self reportError];
+    }
+}
+
+
+
+- (void)startStream:(LogStream *)stream
+{
+    // This method sets up a log stream which will receive and handle server-sent events (SSE) from the API
+    // At this point we have no connection to pipe the SSEs, just the URL for the stream (sent by the server)
+
+    if (eventQueue == nil)
+    {
+        // Establish an single-tier operation to handle incoming log messages in order
+
+        eventQueue = [[NSOperationQueue alloc] init];
+        eventQueue.maxConcurrentOperationCount = 1;
+    }
+
+    // Create the stream's connexion. The stream is its represented object, so we
+    // know which stream incoming data and events belong to
+
+    Connexion *aConnexion = [[Connexion alloc] init];
+    aConnexion.actionCode = kConnectTypeLogStream;
+    aConnexion.representedObject = stream;
+    stream.connexion = aConnexion;
+
+    // Open the SSE connection
+    // NOTE openStream: is a separate method so it can be called elsewhere too.
+    //      The stream's connexion is added to the list there, once it has a task
+
+    [self openStream:stream];
+}
+
+
+
+- (void)openStream:(LogStream *)stream
+{
+    // Here we actually open the connection through which events from the server will pass
+    // NOTE We have not added any devices to the stream yet - we have to do this part first
+
+    stream.isClosed = NO;
+    stream.isOpen = NO;
+
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:stream.url
+                                                           cachePolicy:NSURLRequestReloadIgnoringCacheData
+                                                       timeoutInterval:logTimeout];
+    request.HTTPMethod = @"GET";
+
+    // If we are re-opening the stream, ask the server to resume from the last event we received
+
+    if (stream.lastEventID != nil) [request setValue:stream.lastEventID forHTTPHeaderField:@"Last-Event-ID"];
+
+    Connexion *aConnexion = stream.connexion;
+
+    // If the stream is being re-opened, drop the entry for its previous task
+
+    [self removeConnexion:aConnexion];
+
+    // Any partial event held from the previous connection is discarded, as per the SSE specification
+
+    aConnexion.streamParser = [[LogStreamParser alloc] init];
+    aConnexion.task = [self makeTask:request];
+
+    [aConnexion.task resume];
+
+    // Add the stream's connection to the list
+
+    if (connexions.count == 0)
+    {
+        // Notify the main app to start the progress indicator
+
+        [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPIProgressStart" object:nil];
+    }
+
+    [self addConnexion:aConnexion];
+
+    // Create a new event to record the state change (connecting) and issue it
+    // TODO Do we need to do this??
+
+    LogStreamEvent *event = [[LogStreamEvent alloc] init];
+    event.state = kLogStreamEventStateConnecting;
+    event.type = kLogStreamEventTypeStateChange;
+    event.stream = stream;
+
+    // Place the event in the the event queue to guarantee displayed order = received order
+
+    [eventQueue addOperationWithBlock:^{
+        [self dispatchEvent:event];
+    }];
+}
+
+
+
+- (void)reopenStream:(LogStream *)stream
+{
+    // Called some time after a log stream's connection has dropped: re-open the stream
+    // if it has not been closed in the meantime
+
+    if (stream.isClosed || ![logStreams containsObject:stream]) return;
+
+    [self openStream:stream];
+}
+
+
+
+- (void)streamDropped:(Connexion *)connexion :(NSError *)error
+{
+    // Called when a log stream's connection has ended unexpectedly. Re-open the stream, picking up from
+    // the last event received, a few times before giving up and reporting the closure to the host
+
+    LogStream *stream = (LogStream *)connexion.representedObject;
+
+    // Is the stream already closed? If so, just bail
+
+    if (stream == nil || stream.isClosed) return;
+
+    stream.isOpen = NO;
+
+    if (stream.reconnectAttempts < kLogMaxReconnectAttempts)
+    {
+        // Attempt to re-open the connection in 'retryInterval' seconds
+
+        stream.reconnectAttempts += 1;
+
+        [self performAfterDelay:stream.retryInterval :^{
+            [self reopenStream:stream];
+        }];
+        return;
+    }
+
+    stream.isClosed = YES;
+
+    // Create an error event
+
+    LogStreamEvent *event = [[LogStreamEvent alloc] init];
+    event.type = kLogStreamEventTypeError;
+    event.stream = stream;
+    event.error = error != nil ? error : [NSError errorWithDomain:@"NSURLErrorDomain" code:event.state userInfo:@{ NSLocalizedDescriptionKey: @"Connection with the event source was closed." } ];
+
+    // Add an error event to the event queue
+
+    [eventQueue addOperationWithBlock:^{
+        [self dispatchEvent:event];
+    }];
+}
+
+
+
+- (void)closeStream
+{
+    // Close all of the log streams
+
+    NSArray *streams = [logStreams copy];
+
+    for (LogStream *stream in streams) [self closeStream:stream];
+}
+
+
+
+- (void)closeStream:(LogStream *)stream
+{
+    // Deliver any entries gathered from the stream before it goes
+
+    if (logBatch.count > 0) [self flushLogBatch];
+
+    // Flag the closure (prevents an error report from the 'didComplete:' delegate method)
+    // and perform a clean-up of the stream connection
+
+    stream.isClosed = YES;
+    stream.isOpen = NO;
+
+    // Cancel the saved task to close it
+
+    if (stream.connexion != nil)
+    {
+        [stream.connexion.task cancel];
+        [self removeConnexion:stream.connexion];
+
+        // Notify the main app to stop the progress indicator
+
+        if (connexions.count == 0) [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPIProgressStop" object:nil];
+
+        stream.connexion = nil;
+    }
+
+    stream.url = nil;
+    stream.streamID = nil;
+
+    [logStreams removeObject:stream];
+}
+
+
+
+- (void)logRequestFailed:(Connexion *)connexion
+{
+    // Called when a request to set up a log stream, or to add a device to one, has failed
+    // (the error will already have been reported), to release what was reserved for it
+
+    NSDictionary *dict = (NSDictionary *)connexion.representedObject;
+    LogStream *stream = [dict objectForKey:@"stream"];
+    NSString *deviceID = [dict objectForKey:@"device"];
+
+    if (deviceID != nil)
+    {
+        // A device could not be added to the stream, so free up its place
+
+        if (![loggingDevices containsObject:deviceID]) [stream.devices removeObject:deviceID];
+        return;
+    }
+
+    // The stream could not be set up, so none of its devices are logging
+
+    NSArray *lgds = [stream.devices copy];
+
+    [loggingDevices removeObjectsInArray:lgds];
+    [self closeStream:stream];
+
+    numberOfLogStreams = loggingDevices.count;
+
+    NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
+
+    for (NSString *loggingDevice in lgds) [nc postNotificationName:@"BuildAPILogStreamEnd" object:loggingDevice];
+}
+
+
+
+- (void)dispatchEvent:(LogStreamEvent *)event
+{
+    // Dispactches an event from the event queue by passing it to the processing queue for processing in 'processEvent:'
+
+    [self performOnProcessingQueue:^{
+        [self processEvent:event];
+    }];
+}
+
+
+
+- (void)processEvent:(LogStreamEvent *)event
+{
+    // Processes the supplied event when it is called from the connection queue
+
+    NSDictionary *dict = nil;
+
+    switch (event.type)
+    {
+        case kLogStreamEventTypeStateChange:
+
+            // A stream state change has been signalled (by us or by the stream)
+
+            switch (event.state)
+            {
+                case kLogStreamEventStateConnecting:
+#ifdef DEBUG
+    NSLog(@"%@", @"Log State: Connecting");
+#endif
+                    break;
+
+                case kLogStreamEventStateOpen:
+#ifdef DEBUG
+    NSLog(@"%@", @"Log State: Connection open");
+#endif
+                    // The log stream signals that it is open, so we can now add the devices
+                    // which have been held through the stream set-up process. Calling logOpened: does this
+
+                    [self performOnProcessingQueue:^{
+                        [self logOpened:event.stream];
+                    }];
+                    break;
+
+                case kLogStreamEventStateSubscribed:
+#ifdef DEBUG
+    NSLog(@"%@", @"Log State: Device added");
+#endif
+                    break;
+
+                case kLogStreamEventStateUnsubscribed:
+#ifdef DEBUG
+    NSLog(@"%@", @"Log State: Device removed");
+#endif
+                    break;
+
+                case kLogStreamEventStateClosed:
+#ifdef DEBUG
+    NSLog(@"%@", @"Log State: Connection closed");
+#endif
+                    // Log stream has signalled closure for some reason, so we need to re-open it
+
+                    if (event.stream != nil)
+                    {
+                        [self closeStream:event.stream];
+                        [self restartLogging:event.stream];
+                    }
+            }
+
+            break;
+
+        case kLogStreamEventTypeMessage:
+
+            // A mesage has been received from the server. Relay it to the host app via relayLogEntry:
+
+            if (event.data != nil)
+            {
+                dict = @{ @"message" : event.data };
+
+                [self performOnProcessingQueue:^{
+                    [self relayLogEntry:dict];
+                }];
+            }
+
+            break;
+
+        case kLogStreamEventTypeError:
+            // An error has broken the stream. Relay the error to the host app via logClosed:
+
+            dict = event.stream != nil
+            ? @{ @"message" : event.error, @"code" : [NSNumber numberWithInteger:event.state], @"stream" : event.stream }
+            : @{ @"message" : event.error, @"code" : [NSNumber numberWithInteger:event.state] };
+
+            [self performOnProcessingQueue:^{
+                [self logClosed:dict];
+            }];
+            break;
+    }
+}
+
+
+
+- (void)relayLogEntry:(NSDictionary *)entry
+{
+    // Called on the processing queue to pass a received log entry to the host app
+
+    [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPILogEntryReceived" object:entry];
+}
+
+
+
+- (void)logOpened:(LogStream *)stream
+{
+    // Called on the processing queue when a log stream has been successfully opened
+
+    if (stream == nil || stream.isClosed) return;
+
+    stream.isOpen = YES;
+    stream.reconnectAttempts = 0;
+
+    // Add the devices that have been waiting for the stream to open
+
+    NSArray *pending = [stream.pendingDevices copy];
+    [stream.pendingDevices removeAllObjects];
+
+    for (NSDictionary *dict in pending)
+    {
+        [self subscribeDevice:[dict objectForKey:@"device"] :[dict objectForKey:@"object"] :stream];
+    }
+
+    // If every device was removed while the stream was opening, we no longer need it
+
+    if (stream.devices.count == 0) [self closeStream:stream];
+}
+
+
+
+- (void)logClosed:(NSDictionary *)error
+{
+    // Called on the processing queue to notify the host that a log stream is closed - possibly because of an error
+
+    errorMessage = @"Log stream closed due to a connection error";
+    [self reportError];
+
+    // Only the devices on the closed stream have stopped logging
+
+    LogStream *stream = [error objectForKey:@"stream"];
+    NSArray *lgds = stream != nil ? [stream.devices copy] : [loggingDevices copy];
+
+    [loggingDevices removeObjectsInArray:lgds];
+
+    if (stream != nil)
+    {
+        [self closeStream:stream];
+    }
+    else
+    {
+        [self closeStream];
+    }
+
+    numberOfLogStreams = loggingDevices.count;
+
+    // ...and notify the host for each device
 
-    NSDictionary *dict = (NSDictionary *)userInfo;
-    NSMutableURLRequest *request = [dict objectForKey:@"request"];
-    NSInteger actionCode = [[dict objectForKey:@"actioncode"] integerValue];
+    NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
 
-    [self launchConnection:request :actionCode :[dict objectForKey:@"object"]];
+    for (NSString *loggingDevice in lgds) [nc postNotificationName:@"BuildAPILogStreamEnd" object:loggingDevice];
 }
 
 
 
-- (void)launchPendingConnections
+- (BOOL)isDeviceLogging:(NSString *)deviceID
 {
-    // Pending connections are cached when we attempt to create a connection but no session
-    // token has yet been received. Having elsewhere received the new token, we can now
-    // launch the pending connections, if there are any
+    // Check if a device, specified by ID, is one of those currently logging,
+    // responding with YES or NO as appropriate
 
-    if (pendingConnections != nil && pendingConnections.count > 0)
+    if (![self isOnProcessingQueue])
     {
-        for (Connexion *conn in pendingConnections)
-        {
-            [self setRequestAuthorization:conn.originalRequest];
-
-            if (apiSession == nil)
-            {
-                NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
-                configuration.URLCache = [[NSURLCache alloc] initWithMemoryCapacity:0 diskCapacity:0 diskPath:nil];
-                apiSession = [NSURLSession sessionWithConfiguration:configuration
-                                                                  delegate:self
-                                                             delegateQueue:[NSOperationQueue mainQueue]];
-            }
+        // Called on another thread, so make the call on the processing queue
 
-            conn.task = [apiSession dataTaskWithRequest:conn.originalRequest];
-
-            [conn.task resume];
-            [connexions addObject:conn];
+        __block BOOL isLogging = NO;
+        [self performOnProcessingQueueAndWait:^{ isLogging = [self isDeviceLogging:deviceID]; }];
+        return isLogging;
+    }
 
-            numberOfConnections = connexions.count;
-        }
+    if (deviceID == nil || deviceID.length == 0) return NO;
 
-        [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPIProgressStart" object:nil];
-        [pendingConnections removeAllObjects];
+    for (NSString *dvid in loggingDevices)
+    {
+        if ([dvid compare:deviceID] == NSOrderedSame) return YES;
     }
+
+    return NO;
 }
 
 
 
-- (void)killAllConnections
+- (NSInteger)indexOfLoggedDevice:(NSString *)deviceID
 {
-    // Cancel and clear all in-flight connections and any pending connections
+    // Returns the index within the list of logging devices of the specified device (by ID)
+    // Returns -1 in the event of an error - the device is not on the list
 
-    if (connexions.count > 0)
+    for (NSUInteger i = 0 ; i < loggingDevices.count ; ++i)
     {
-        // There are connections that we need to terminate
+        NSString *dvid = [loggingDevices objectAtIndex:i];
 
-        if (loggingDevices.count > 0)
+        if ([deviceID compare:dvid] == NSOrderedSame)
         {
-            // There are devices for which we are streaming logs, so clear the list...
+            return i;
+        }
+    }
 
-            NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
-            NSMutableArray *lgds = [loggingDevices copy];
-            numberOfLogStreams = 0;
+    return -1;
+}
 
-            [loggingDevices removeAllObjects];
-            [self closeStream];
 
-            // ...and notify the host for each device
 
-            for (NSString *loggingDevice in lgds) [nc postNotificationName:@"BuildAPILogStreamEnd" object:loggingDevice];
-        }
+- (LogStream *)logStreamForDevice:(NSString *)deviceID
+{
+    // Returns the log stream to which the specified device (by ID) has been assigned,
+    // or nil if the device is not logging
 
-        // Kill the remaining connections.
-        // The triggered delegate method didBecomeInvalid: will clear out 'connexions'
+    if (deviceID == nil || deviceID.length == 0) return nil;
 
-        if (apiSession != nil) [apiSession invalidateAndCancel];
+    for (LogStream *stream in logStreams)
+    {
+        if ([stream.devices containsObject:deviceID]) return stream;
     }
 
-    // Remove any pending connections
-
-    if (pendingConnections != nil && pendingConnections.count > 0) [pendingConnections removeAllObjects];
+    return nil;
 }
 
 
 
-#pragma mark - Log Stream Methods
-
-
-- (void)startLogging:(NSString *)deviceID
-{
-    [self startLogging:deviceID :nil];
-}
-
+#pragma mark Log Entry Batching
 
 
-- (void)startLogging:(NSString *)deviceID :(id)someObject
+- (void)setLogBatchInterval:(NSTimeInterval)interval
 {
-    // Begin logging for the specified device ID
-    // PARAMETERS:
-    //   'deviceID' is the device's ID
-    //   'someObject' is an optional object, supplied by the host app, that is bound to this request
-    //                and follows it through sending and processing the response from the server
-    // RETURNS:
-    //   Nothing
+    // Sets the period (in seconds) over which streamed log entries are gathered before they
+    // are delivered to the host as a single batch. 0 disables batching, ie. each entry is
+    // posted as it arrives via 'BuildAPILogEntryReceived'. Default is 0
 
-    if (deviceID == nil || deviceID.length == 0)
+    if (![self isOnProcessingQueue])
     {
-        // No device ID? Can't proceed
+        // Called on another thread, so make the call on the processing queue
 
-        errorMessage = @"Could not create a request to stream the device logs: no device specified.";
-        [self reportError];
+        [self performOnProcessingQueueAndWait:^{ [self setLogBatchInterval:interval]; }];
         return;
     }
 
-    if (loggingDevices == nil) loggingDevices = [[NSMutableArray alloc] init];
+    if (interval < 0) interval = 0;
+    logBatchInterval = interval;
 
-    // Check whether this is first device we're starting logging for, ie. whether we have a stream ID
+    // Deliver anything held under the old setting
 
-    if (logStreamID == nil || logStreamID.length == 0)
-    {
-        // This is the first device, so we need to first get the stream ID and stream URL
+    if (logBatch.count > 0) [self flushLogBatch];
+}
 
-        NSMutableURLRequest *request = [self makePOSTrequest:@"logstream?format=json" :nil];
 
-        if (request)
+
+- (void)queueLogEntry:(NSString *)entry
+{
+    // Add a streamed log entry to the batch awaiting delivery to the host, applying the overflow
+    // policy if too many entries are waiting - those in the batch plus those in batches handed to
+    // the host but not yet consumed. Called on the processing queue from 'parseStreamData::'
+
+    if (logBatch == nil) logBatch = [[NSMutableArray alloc] init];
+
+    if (logQueueLimit > 0 && logBatch.count + logEntriesDelivering >= logQueueLimit)
+    {
+        if (logOverflowPolicy == kLogOverflowPolicyDrop)
         {
-            // Pass in the first device's ID so we have it to use after the stream has been established
+            // Discard the oldest entry to make room, and record that we have done so. Batches already
+            // handed to the host can't be recalled, so if the batch is empty, the new entry is discarded
 
-            NSDictionary *dict = someObject != nil
-            ? @{ @"device" : deviceID, @"object" : someObject }
-            : @{ @"device" : deviceID };
+            logBatchDropped++;
+            logEntriesDropped++;
+
+            if (logBatch.count == 0) return;
 
-            [self launchConnection:request :kConnectTypeLogGetStreamID :dict];
+            [logBatch removeObjectAtIndex:0];
         }
-        else
+        else if (!logStreamsBlocked)
         {
-            errorMessage = @"Could not create a request to stream the specified device logs.";
-            [self reportError];
+            // Stop reading from the log streams until the host has caught up. Entries already
+            // received are still queued, so the limit may be exceeded by the remainder of the
+            // current chunk of data
+
+            logStreamsBlocked = YES;
+
+            for (LogStream *stream in logStreams) [stream.connexion.task suspend];
         }
     }
-    else
+
+    [logBatch addObject:entry];
+
+    if (logBatchSize > 0 && logBatch.count >= logBatchSize)
     {
-        // We are already streaming from one or more devices, so just add the new one to the list
+        [self flushLogBatch];
+        return;
+    }
 
-        [self addDeviceToLogStream:deviceID :someObject];
+    // Start the batch window with the first entry, so the timer does not run while the streams are idle
+
+    if (logBatchTimer == nil)
+    {
+        logBatchTimer = [self makeTimer:logBatchInterval :^{
+            [self flushLogBatch];
+        }];
     }
 }
 
 
 
-- (void)addDeviceToLogStream:(NSString *)deviceID :(id)someObject
+- (void)flushLogBatch
 {
-    // Add a new device to an existing stream (already checked for in 'startLogging:'
-    // Make a PUT request with {device identifier} to /logstream/{stream_id}
-    // {device identifier} eg. { id: ‘d9f6f253-d203-487f-bdb0-70ea1529ee1b’, type: ‘device’ }
-    // PARAMETERS:
-    //   'deviceID' is the device's ID
-    //   'someObject' is an optional object, supplied by the host app, that is bound to this request
-    //                and follows it through sending and processing the response from the server
-    // RETURNS:
-    //   Nothing
+    // Hand the batched log entries to the host in a single notification, whose object is a
+    // dictionary with the keys 'messages' (an array of raw log entries, oldest first) and
+    // 'dropped' (the number of entries discarded since the last delivery). Like every other
+    // notification, it is posted on the processing queue. If 'acknowledgeLogBatches' is set, the
+    // entries count against 'logQueueLimit' until the host calls 'logBatchDelivered:'
 
-    if (loggingDevices.count > 0)
-    {
-        // First check that the device is not already logging; if it is, bail
+    [self cancelTimer:logBatchTimer];
+    logBatchTimer = nil;
 
-        for (NSString *devid in loggingDevices)
-        {
-            if ([devid compare:deviceID] == NSOrderedSame) return;
-        }
+    if (logBatch.count == 0 && logBatchDropped == 0) return;
 
-        // Check that maximum number of devices hasn't been reached.
+    NSArray *messages = logBatch != nil ? [logBatch copy] : @[];
+    NSDictionary *dict = @{ @"messages" : messages,
+                            @"dropped" : [NSNumber numberWithUnsignedInteger:logBatchDropped] };
 
+    [logBatch removeAllObjects];
+    logBatchDropped = 0;
 
-        if (loggingDevices.count == kLogMaxDevicesPerLog)
-        {
-            errorMessage = @"Maximum number of logging devices already reached";
-            [self reportError];
-            return;
-        }
-    }
+    // Count the entries before posting, in case the host acknowledges them from its observer
 
-    NSDictionary *dict = @{ @"id" : deviceID,
-                            @"type" : @"device" };
+    if (acknowledgeLogBatches) logEntriesDelivering += messages.count;
 
-    NSMutableURLRequest *request = [self makePUTrequest:[NSString stringWithFormat:@"%@/%@", logStreamURL.absoluteString, deviceID] :dict];
+    [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPILogEntriesReceived" object:dict];
 
-    if (request)
+    // Otherwise the batch has been handled once the notification returns, so just check whether
+    // the log streams can be resumed
+
+    if (!acknowledgeLogBatches) [self logBatchDelivered:0];
+}
+
+
+
+- (void)logBatchDelivered:(NSUInteger)count
+{
+    // A batch of log entries has been consumed by the host. If 'acknowledgeLogBatches' is set,
+    // the host calls this, on any thread, with the number of entries in the batch it has finished
+    // with. If the log streams were suspended because too many entries were waiting, resume
+    // reading from them once there is room
+    // PARAMETERS:
+    //    count - The number of log entries consumed
+
+    if (![self isOnProcessingQueue])
     {
-        dict = (someObject != nil)
-        ? @{ @"device" : deviceID, @"object" : someObject }
-        : @{ @"device" : deviceID };
+        // Called on another thread, so make the call on the processing queue
 
-        [self launchConnection:request :kConnectTypeLogStreamAdd :dict];
+        [self performOnProcessingQueue:^{ [self logBatchDelivered:count]; }];
+        return;
     }
-    else
+
+    logEntriesDelivering = count < logEntriesDelivering ? logEntriesDelivering - count : 0;
+
+    if (logStreamsBlocked && (logQueueLimit == 0 || logBatch.count + logEntriesDelivering < logQueueLimit))
     {
-        errorMessage = @"Could not create a request to stream the specified device logs.";
-        [self reportError];
+        logStreamsBlocked = NO;
+
+        for (LogStream *stream in logStreams) [stream.connexion.task resume];
     }
 }
 
 
 
-- (void)stopLogging:(NSString *)deviceID
-{
-    [self stopLogging:deviceID :nil];
-}
-
+#pragma mark - Device Timeline Methods
 
 
-- (void)stopLogging:(NSString *)deviceID :(id)someObject
+- (DeviceTimeline *)timelineForDevice:(NSString *)deviceID
 {
-    // Remove the specified device from an existing log stream
-    // ie. make a DELETE reqyest to /logstream/{stream_id}/{device_identifier}
-    // {device_identifier} eg. {id: ‘d9f6f253-d203-487f-bdb0-70ea1529ee1b’, type: ‘device’}
-    // PARAMETERS:
-    //   'deviceID' is the device's ID
-    //   'someObject' is an optional object, supplied by the host app, that is bound to this request
-    //                and follows it through sending and processing the response from the server
-    // RETURNS:
-    //   Nothing
+    // Returns the specified device's timeline, creating it if necessary
 
-    NSDictionary *dict = @{ @"id" : deviceID,
-                            @"type" : @"device" };
+    if (deviceID == nil || deviceID.length == 0) return nil;
 
-    NSMutableURLRequest *request = [self makeRequest:@"DELETE" :[NSString stringWithFormat:@"%@/%@", logStreamURL, deviceID] :NO :NO];
-    NSError *error;
+    if (timelines == nil) timelines = [[NSMutableDictionary alloc] init];
 
-    request.HTTPBody = [NSJSONSerialization dataWithJSONObject:dict options:0 error:&error];
+    DeviceTimeline *timeline = [timelines objectForKey:deviceID];
 
-    if (error)
+    if (timeline == nil)
     {
-        errorMessage = @"Could not create a request to stop streaming the specified device logs: bad JSON data.";
-        [self reportError];
-        return;
+        timeline = [[DeviceTimeline alloc] init];
+        timeline.deviceID = deviceID;
+        timeline.logs = [[RingBuffer alloc] initWithCapacity:timelineCapacity];
+        timeline.history = [[RingBuffer alloc] initWithCapacity:timelineCapacity];
+        [timelines setObject:timeline forKey:deviceID];
     }
 
-    if (request)
-    {
-        dict = (someObject != nil)
-        ? @{ @"device" : deviceID, @"object" : someObject }
-        : @{ @"device" : deviceID };
-
-        [self launchConnection:request :kConnectTypeLogStreamEnd :dict];
-    }
-    else
-    {
-        errorMessage = @"Could not create a request to stop streaming the specified device logs.";
-        [self reportError];
-    }
+    return timeline;
 }
 
 
 
-- (void)restartLogging
+- (DeviceTimeline *)timelineForRequest:(Connexion *)connexion
 {
-    // This is called if a log connection breaks for some reason, so enable logging to auto-restart
-    // POST-ing to /logstream will return a stream ID by way of a 302, which we will trap later
+    // Returns the timeline of the device whose logs or history a connexion is retrieving.
+    // The device's ID is read from the request's path, '.../devices/{id}/logs' or '.../devices/{id}/history'
 
-    NSMutableURLRequest *request = [self makePOSTrequest:@"logstream?format=json" :nil];
+    NSArray *components = connexion.originalRequest.URL.pathComponents;
 
-    if (request)
-    {
-        // Pass in the first device's ID so we have it to use after the stream has been established
+    if (components.count < 3) return nil;
 
-        restartingLog = YES;
-        [self launchConnection:request :kConnectTypeLogGetStreamID :nil];
-    }
-    else
-    {
-        errorMessage = @"Could not create a request to stream the specified device logs.";
-        [self reportError];
-    }
+    return [self timelineForDevice:[components objectAtIndex:(components.count - 2)]];
 }
 
 
 
-- (void)startStream
+- (NSString *)addTimelinePage:(NSMutableArray *)pending :(NSDictionary *)data :(NSString *)cursor :(NSSet *)cursorKeys
 {
-    // This method sets up the log stream which will receive and handle server-sent events (SSE) from the API
-    // At this point we have no connection to pipe the SSEs, just the URL for the stream (sent by the server)
+    // Add the entries of a page of a device's logs or history which are newer than the cursor to the
+    // entries being gathered by the retrieval, and return the URL of the next page. This is nil if there
+    // are no more pages, or if the page has reached the cursor, ie. there are no newer entries to come
+    // PARAMETERS:
+    //   'pending' is the array of entries being gathered, which is emptied by a list's first page
+    //   'data' is the decoded page
+    //   'cursor' is the timestamp of the newest entry already retrieved, or nil if there is none
+    //   'cursorKeys' are the keys of the entries retrieved with that timestamp
+    // RETURNS:
+    //   The URL of the next page to request, or nil
 
-    logIsClosed = YES;
+    NSDictionary *links = [data objectForKey:@"links"];
+    NSArray *page = [data objectForKey:@"data"];
 
-    if (eventQueue == nil)
+    if ([self isFirstPage:links]) [pending removeAllObjects];
+
+    if (![page isKindOfClass:[NSArray class]]) return nil;
+
+    NSArray *entries = [self newTimelineEntries:page :cursor :cursorKeys];
+    [pending addObjectsFromArray:entries];
+
+    // Entries are listed newest first, so a page holding older entries has reached the cursor. If the
+    // page is not in that order, keep going: the next page may still hold newer entries
+
+    if (cursor != nil && entries.count < page.count)
     {
-        // Establish an single-tier operation to handle incoming log messages in order
+        NSString *first = [self timestampOfEntry:[page firstObject]];
+        NSString *last = [self timestampOfEntry:[page lastObject]];
 
-        eventQueue = [[NSOperationQueue alloc] init];
-        eventQueue.maxConcurrentOperationCount = 1;
+        if ([first compare:last] != NSOrderedAscending) return nil;
     }
 
-    // Create the only connexion for streaming
+    return [self getNextURL:[self nextPageLink:links]];
+}
+
 
-    logConnexion = [[Connexion alloc] init];
-    logConnexion.actionCode = kConnectTypeLogStream;
 
-    // Add the stream's connection to the list
+- (NSArray *)newTimelineEntries:(NSArray *)entries :(NSString *)cursor :(NSSet *)cursorKeys
+{
+    // Returns those of the entries which are newer than the cursor, and not already retrieved at its timestamp
+
+    if (cursor == nil) return entries;
 
-    [connexions addObject:logConnexion];
+    NSMutableArray *newEntries = [[NSMutableArray alloc] initWithCapacity:entries.count];
 
-    if (connexions.count == 1)
+    for (NSDictionary *entry in entries)
     {
-        // Notify the main app to start the progress indicator
+        NSComparisonResult order = [[self timestampOfEntry:entry] compare:cursor];
 
-        [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPIProgressStart" object:nil];
+        if (order == NSOrderedDescending || (order == NSOrderedSame && ![cursorKeys containsObject:[self keyOfEntry:entry]]))
+        {
+            [newEntries addObject:entry];
+        }
     }
 
-    // Open the SSE connection
-    // NOTE openStream: is a separate method so it can be called elsewhere too
-
-    [self openStream];
+    return newEntries;
 }
 
 
 
-- (void)openStream
+- (NSArray *)mergeTimelineEntries:(DeviceTimeline *)timeline :(BOOL)isHistory
 {
-    // Here we actually open the connection through which events from the server will pass
-    // NOTE We have not added any devices to the stream yet - we have to do this part first
+    // A retrieval of a device's logs or history is complete, so add the new entries it has gathered
+    // to the device's timeline, and advance the cursor to the newest of them
+    // RETURNS:
+    //   The new entries, in the order the server listed them
 
-    logIsClosed = NO;
+    NSMutableArray *pending = isHistory ? timeline.pendingHistory : timeline.pendingLogs;
+    NSString *cursor = isHistory ? timeline.historyCursor : timeline.logCursor;
+    NSSet *cursorKeys = isHistory ? timeline.historyCursorKeys : timeline.logCursorKeys;
 
-    if (apiSession == nil)
-    {
-        NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
-        configuration.URLCache = [[NSURLCache alloc] initWithMemoryCapacity:0 diskCapacity:0 diskPath:nil];
-        apiSession = [NSURLSession sessionWithConfiguration:configuration
-                                                   delegate:self
-                                              delegateQueue:[NSOperationQueue mainQueue]];
-    }
+    // Filter the entries again, in case another retrieval has completed in the meantime
 
-    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:logStreamURL
-                                                           cachePolicy:NSURLRequestReloadIgnoringCacheData
-                                                       timeoutInterval:logTimeout];
-    request.HTTPMethod = @"GET";
+    NSArray *entries = [NSArray arrayWithArray:[self newTimelineEntries:pending :cursor :cursorKeys]];
+    [pending removeAllObjects];
 
-    if (logLastEventID) [request setValue:logLastEventID forHTTPHeaderField:@"Last-Event-ID"];
+    if (entries.count == 0) return entries;
 
-    logConnexion.task = [apiSession dataTaskWithRequest:request];
+    // Advance the cursor, noting the entries at its timestamp
 
-    [logConnexion.task resume];
+    NSArray *sorted = [self sortTimelineEntries:entries];
+    NSString *newCursor = [self timestampOfEntry:[sorted lastObject]];
+    NSMutableSet *newKeys = [[NSMutableSet alloc] init];
 
-    // Create a new event to record the state change (connecting) and issue it
-    // TODO Do we need to do this??
+    if ([newCursor isEqualToString:cursor] && cursorKeys != nil) [newKeys unionSet:cursorKeys];
 
-    LogStreamEvent *event = [[LogStreamEvent alloc] init];
-    event.state = kLogStreamEventStateConnecting;
-    event.type = kLogStreamEventTypeStateChange;
+    for (NSDictionary *entry in [sorted reverseObjectEnumerator])
+    {
+        if (![[self timestampOfEntry:entry] isEqualToString:newCursor]) break;
+        [newKeys addObject:[self keyOfEntry:entry]];
+    }
 
-    // Place the event in the the event queue to guarantee displayed order = received order
+    if (isHistory)
+    {
+        timeline.historyCursor = newCursor;
+        timeline.historyCursorKeys = newKeys;
+    }
+    else
+    {
+        timeline.logCursor = newCursor;
+        timeline.logCursorKeys = newKeys;
+    }
 
-    [eventQueue addOperationWithBlock:^{
-        [self dispatchEvent:event];
-    }];
+    [self addTimelineEntries:sorted :(isHistory ? timeline.history : timeline.logs)];
+    return entries;
 }
 
 
 
-- (void)closeStream
+- (void)addTimelineEntries:(NSArray *)entries :(RingBuffer *)buffer
 {
-    // Flag the closure (prevents an error report from the 'didComplete:' delegate method)
-    // and perform a clean-up of the stream connection
+    // Add entries, oldest first, to a timeline's ring buffer, which is kept in timestamp order. Entries
+    // no older than all those in the buffer, eg. streamed log entries, are simply added, less any already
+    // held at the newest timestamp; otherwise, as when historical entries overlap streamed ones, entries
+    // already in the buffer are skipped and the rest are merged in order
 
-    logIsClosed = YES;
+    if (entries.count == 0) return;
 
-    // Cancel the saved task to close it
+    NSString *first = [self timestampOfEntry:[entries firstObject]];
+    NSDictionary *newest = [buffer lastObject];
+    NSComparisonResult order = newest != nil ? [first compare:[self timestampOfEntry:newest]] : NSOrderedDescending;
 
-    if (logConnexion != nil)
+    if (order == NSOrderedDescending)
     {
-        [logConnexion.task cancel];
-        [connexions removeObject:logConnexion];
+        [buffer addObjectsFromArray:entries];
+        return;
+    }
 
-        // Notify the main app to stop the progress indicator
+    if (order == NSOrderedSame)
+    {
+        // Only the buffer's entries at the newest timestamp can match, so there is no need to re-sort
 
-        if (connexions.count == 0) [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPIProgressStop" object:nil];
+        NSMutableSet *keys = [[NSMutableSet alloc] init];
 
-        logConnexion = nil;
-        logStreamURL = nil;
-        logStreamID = nil;
+        for (NSUInteger i = buffer.count ; i > 0 ; --i)
+        {
+            NSDictionary *entry = [buffer objectAtIndex:(i - 1)];
+
+            if (![[self timestampOfEntry:entry] isEqualToString:first]) break;
+            [keys addObject:[self keyOfEntry:entry]];
+        }
+
+        for (NSDictionary *entry in entries)
+        {
+            if (![keys containsObject:[self keyOfEntry:entry]]) [buffer addObject:entry];
+        }
+
+        return;
     }
-}
 
+    NSArray *existing = [buffer allObjects];
+    NSMutableSet *keys = [[NSMutableSet alloc] init];
 
+    for (NSDictionary *entry in [existing reverseObjectEnumerator])
+    {
+        if ([[self timestampOfEntry:entry] compare:first] == NSOrderedAscending) break;
+        [keys addObject:[self keyOfEntry:entry]];
+    }
 
-- (void)dispatchEvent:(LogStreamEvent *)event
-{
-    // Dispactches an event from the event queue by passing it to the main thread for processing in 'processEvent:'
+    NSMutableArray *merged = [NSMutableArray arrayWithArray:existing];
+
+    for (NSDictionary *entry in entries)
+    {
+        if (![keys containsObject:[self keyOfEntry:entry]]) [merged addObject:entry];
+    }
 
-    [self performSelectorOnMainThread:@selector(processEvent:) withObject:event waitUntilDone:NO];
+    [buffer replaceAllObjects:[self sortTimelineEntries:merged]];
 }
 
 
 
-- (void)processEvent:(LogStreamEvent *)event
+- (void)addStreamedLogEntry:(NSString *)message
 {
-    // Processes the supplied event when it is called from the connection queue
-
-    NSDictionary *dict = nil;
-
-    switch (event.type)
-    {
-        case kLogStreamEventTypeStateChange:
+    // Add a log entry received from a log stream to its device's timeline. Streamed entries have the form
+    // '<device ID> <timestamp> <environment> <type> <message>', which we convert to the form of entries
+    // retrieved by 'getDeviceLogs:'. They don't move the log cursor: entries logged before the device was
+    // added to the stream may not have been retrieved yet
 
-            // A stream state change has been signalled (by us or by the stream)
+    // Split off the four leading fields only: the message itself may contain any number of spaces
 
-            switch (event.state)
-            {
-                case kLogStreamEventStateConnecting:
-#ifdef DEBUG
-    NSLog(@"%@", @"Log State: Connecting");
-#endif
-                    break;
+    NSMutableArray *parts = [[NSMutableArray alloc] initWithCapacity:4];
+    NSUInteger start = 0;
 
-                case kLogStreamEventStateOpen:
-#ifdef DEBUG
-    NSLog(@"%@", @"Log State: Connection open");
-#endif
-                    // The log stream signals that it is open, so we can now add the first device,
-                    // whose ID has been retained through the stream set-up process. Calling logOpened: does this
+    while (parts.count < 4)
+    {
+        NSRange space = [message rangeOfString:@" " options:NSLiteralSearch range:NSMakeRange(start, message.length - start)];
 
-                    [self performSelectorOnMainThread:@selector(logOpened) withObject:nil waitUntilDone:NO];
-                    break;
+        if (space.location == NSNotFound) return;
 
-                case kLogStreamEventStateSubscribed:
-#ifdef DEBUG
-    NSLog(@"%@", @"Log State: Device added");
-#endif
-                    break;
+        [parts addObject:[message substringWithRange:NSMakeRange(start, space.location - start)]];
+        start = NSMaxRange(space);
+    }
 
-                case kLogStreamEventStateUnsubscribed:
-#ifdef DEBUG
-    NSLog(@"%@", @"Log State: Device removed");
-#endif
-                    break;
+    DeviceTimeline *timeline = [self timelineForDevice:[parts objectAtIndex:0]];
+    NSString *msg = [message substringFromIndex:start];
 
-                case kLogStreamEventStateClosed:
-#ifdef DEBUG
-    NSLog(@"%@", @"Log State: Connection closed");
-#endif
-                    // Log stream has signalled closure for some reason, so we need to re-open it
+    [self addTimelineEntries:@[ @{ @"ts" : [parts objectAtIndex:1], @"type" : [parts objectAtIndex:3], @"msg" : msg } ] :timeline.logs];
+}
 
-                    [self closeStream];
-                    [self restartLogging];
-            }
 
-            break;
 
-        case kLogStreamEventTypeMessage:
+- (NSArray *)sortTimelineEntries:(NSArray *)entries
+{
+    // Returns the entries sorted oldest first. Entries with the same timestamp keep their order
 
-            // A mesage has been received from the server. Relay it to the host app via relayLogEntry:
+    return [entries sortedArrayWithOptions:NSSortStable usingComparator:^NSComparisonResult(id a, id b) {
+        return [[self timestampOfEntry:a] compare:[self timestampOfEntry:b]];
+    }];
+}
 
-            if (event.data != nil)
-            {
-                dict = @{ @"message" : event.data };
 
-                [self performSelectorOnMainThread:@selector(relayLogEntry:) withObject:dict waitUntilDone:NO];
-            }
 
-            break;
+- (NSString *)timestampOfEntry:(NSDictionary *)entry
+{
+    // Returns a log or history entry's timestamp. These are ISO 8601 UTC strings, so they sort as strings
 
-        case kLogStreamEventTypeError:
-            // An error has broken the stream. Relay the error to the host app via logClosed:
+    id ts = [entry objectForKey:@"ts"];
 
-            dict = @{ @"message" : event.error,
-                      @"code" : [NSNumber numberWithInteger:event.state] };
+    if (ts == nil) ts = [entry objectForKey:@"timestamp"];
 
-            [self performSelectorOnMainThread:@selector(logClosed:) withObject:dict waitUntilDone:NO];
-            break;
-    }
+    return [ts isKindOfClass:[NSString class]] ? ts : @"";
 }
 
 
 
-- (void)relayLogEntry:(NSDictionary *)entry
+- (id)keyOfEntry:(NSDictionary *)entry
 {
-    // Called on the main thread to pass a received log entry to the host app
+    // Returns a key identifying an entry. Log entries are identified by their timestamp, type and message
+    // alone, so that historical and streamed copies of the same entry match; others by their whole content
 
-    [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPILogEntryReceived" object:entry];
+    id msg = [entry objectForKey:@"msg"];
+
+    if (msg == nil) return entry;
+
+    return [NSString stringWithFormat:@"%@ %@ %@", [self timestampOfEntry:entry], [entry objectForKey:@"type"], msg];
 }
 
 
 
-- (void)logOpened
+- (NSArray *)timelineLogs:(NSString *)deviceID
 {
-    // Called on the main thread when the log stream has been successfully opened
+    // Returns the log entries held for the specified device, oldest first, without making a request
 
-    // If we have been passed an object, we should unpack it
-
-    if (savedObject != nil)
+    if (![self isOnProcessingQueue])
     {
-        NSMutableDictionary *dict = (NSMutableDictionary *)savedObject;
-        NSString *deviceID = [dict objectForKey:@"device"];
-        [self addDeviceToLogStream:deviceID :[dict objectForKey:@"object"]];
-        savedObject = nil;
+        // Called on another thread, so make the call on the processing queue
+
+        __block NSArray *entries = nil;
+        [self performOnProcessingQueueAndWait:^{ entries = [self timelineLogs:deviceID]; }];
+        return entries;
     }
 
-    if (restartingLog)
-    {
-        if (loggingDevices.count > 0)
-        {
-            for (NSString *deviceId in loggingDevices)
-            {
-                [self addDeviceToLogStream:deviceId :nil];
-            }
-        }
+    DeviceTimeline *timeline = deviceID != nil ? [timelines objectForKey:deviceID] : nil;
 
-        restartingLog = NO;
-    }
+    return timeline != nil ? [timeline.logs allObjects] : @[];
 }
 
 
 
-- (void)logClosed:(NSDictionary *)error
+- (NSArray *)timelineHistory:(NSString *)deviceID
 {
-    // Called on the main thread to notify the host that the log stream is closed - possibly because of an error
-
-    errorMessage = @"Log stream closed due to a connection error";
-    [self reportError];
-
-    NSMutableArray *lgds = [loggingDevices copy];
-    [loggingDevices removeAllObjects];
-    [self closeStream];
+    // Returns the history entries held for the specified device, oldest first, without making a request
 
-    numberOfLogStreams = 0;
+    if (![self isOnProcessingQueue])
+    {
+        // Called on another thread, so make the call on the processing queue
 
-    // ...and notify the host for each device
+        __block NSArray *entries = nil;
+        [self performOnProcessingQueueAndWait:^{ entries = [self timelineHistory:deviceID]; }];
+        return entries;
+    }
 
-    NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
+    DeviceTimeline *timeline = deviceID != nil ? [timelines objectForKey:deviceID] : nil;
 
-    for (NSString *loggingDevice in lgds) [nc postNotificationName:@"BuildAPILogStreamEnd" object:loggingDevice];
+    return timeline != nil ? [timeline.history allObjects] : @[];
 }
 
 
 
-- (BOOL)isDeviceLogging:(NSString *)deviceID
+- (void)clearTimeline:(NSString *)deviceID
 {
-    // Check if a device, specified by ID, is one of those currently logging,
-    // responding with YES or NO as appropriate
-
-    if (deviceID == nil || deviceID.length == 0) return NO;
+    // Discard the entries and cursors held for the specified device, or for every device if 'deviceID' is nil,
+    // so that the next retrieval starts again from the newest entry
 
-    for (NSString *dvid in loggingDevices)
+    if (![self isOnProcessingQueue])
     {
-        if ([dvid compare:deviceID] == NSOrderedSame) return YES;
+        // Called on another thread, so make the call on the processing queue
+
+        [self performOnProcessingQueueAndWait:^{ [self clearTimeline:deviceID]; }];
+        return;
     }
 
-    return NO;
+    if (deviceID != nil)
+    {
+        [timelines removeObjectForKey:deviceID];
+    }
+    else
+    {
+        [timelines removeAllObjects];
+    }
 }
 
 
 
-- (NSInteger)indexOfLoggedDevice:(NSString *)deviceID
+- (void)setTimelineCapacity:(NSUInteger)capacity
 {
-    // Returns the index within the list of logging devices of the specified device (by ID)
-    // Returns -1 in the event of an error - the device is not on the list
+    // Sets the number of log entries, and of history entries, held for each device. Default is 1000
 
-    for (NSUInteger i = 0 ; i < loggingDevices.count ; ++i)
+    if (![self isOnProcessingQueue])
     {
-        NSString *dvid = [loggingDevices objectAtIndex:i];
+        // Called on another thread, so make the call on the processing queue
 
-        if ([deviceID compare:dvid] == NSOrderedSame)
-        {
-            return i;
-        }
+        [self performOnProcessingQueueAndWait:^{ [self setTimelineCapacity:capacity]; }];
+        return;
     }
 
-    return -1;
+    if (capacity == 0) capacity = 1;
+    timelineCapacity = capacity;
+
+    for (NSString *deviceID in timelines)
+    {
+        DeviceTimeline *timeline = [timelines objectForKey:deviceID];
+        timeline.logs.capacity = capacity;
+        timeline.history.capacity = capacity;
+    }
 }
 
 
@@ -3107,22 +7554,23 @@ didReceiveResponse:(NSURLResponse *)response
 
     // Get the connexion instance representing this connection task
 
-    Connexion *connexion = nil;
+    Connexion *connexion = [self connexionForTask:dataTask];
 
-    for (Connexion *aConnexion in connexions)
-    {
-        if (aConnexion.task == dataTask)
-        {
-            connexion = aConnexion;
-            break;
-        }
-    }
+    if (collectMetrics) connexion.firstByteTime = [NSProcessInfo processInfo].systemUptime;
 
     // Get the HTTP status code
 
     NSHTTPURLResponse *resp = (NSHTTPURLResponse *)response;
     NSInteger statusCode = resp.statusCode;
 
+    // Keep the client-side rate limiter in step with the server
+
+    [self updateRateLimit:resp];
+
+    // If the server tells us the cached response is still current, use it
+
+    if ([self validateCachedResponse:connexion :resp]) statusCode = 200;
+
 #ifdef DEBUG
     NSLog(@"Status: %li (%@)", (long)statusCode, dataTask.originalRequest.URL.absoluteString);
 #endif
@@ -3132,6 +7580,23 @@ didReceiveResponse:(NSURLResponse *)response
         // The API has responded with a status code that indicates an error.
         // Examine the status code to deal with specific errors
 
+        if (statusCode > 399 && statusCode != 429 && connexion != nil)
+        {
+            // A read whose hedged twin may yet succeed, or which may succeed if it is sent again, is not reported.
+            // Rate-limited requests are dealt with below: the limit has to be honoured whatever the request
+
+            if ([self dropHedgedConnexion:connexion] || ([self isTransientStatus:statusCode] && [self retryConnexion:connexion]))
+            {
+                if (connexions.count == 0) [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPIProgressStop" object:nil];
+
+                // Run the completion handler with a 'cancel' response becuase we are killing this connection
+
+                if (completionHandler != nil) completionHandler(NSURLSessionResponseCancel);
+
+                return;
+            }
+        }
+
         if (statusCode == 302)
         {
             // TODO Is this ever called now?
@@ -3163,8 +7628,7 @@ didReceiveResponse:(NSURLResponse *)response
 
                 [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPILoginRejected" object:nil];
 
-                [connexions removeObject:connexion];
-                numberOfConnections = connexions.count;
+                [self removeConnexion:connexion];
 
                 if (connexions.count == 0) [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPIProgressStop" object:nil];
 
@@ -3182,32 +7646,63 @@ didReceiveResponse:(NSURLResponse *)response
 
         if (statusCode == 429)
         {
-            // impCentral API rate limit has been exceeded, which we neeed to deal with here
-            // Bundle up connection data and pass it to 'relauchConnection:' in 'limit' * 1000 seconds' time
-            // 'limit' is the milliseconds time to wait before reconnecting that has been submitted by
-            // the server
+            // impCentral API rate limit has been exceeded, which we neeed to deal with here.
+            // Hold the queue until the window resets - 'X-RateLimit-Reset' is the time in milliseconds
+            // to wait that has been submitted by the server - and put the request back at the front
+            // of its queue, so that it is the next of its class to be sent
 
-            NSDictionary *dict = connexion.representedObject != nil
-            ? @{ @"request" : [dataTask.originalRequest copy],
-                 @"actioncode" : [NSNumber numberWithInteger:connexion.actionCode],
-                 @"object" : connexion.representedObject }
-            : @{ @"request" : [dataTask.originalRequest copy],
-                 @"actioncode" : [NSNumber numberWithInteger:connexion.actionCode] };
+            NSString *reset = [resp.allHeaderFields objectForKey:@"X-RateLimit-Reset"];
+            NSTimeInterval resetTime = reset.doubleValue > 0 ? reset.doubleValue / 1000.0 : kRateLimitRetryDefault;
+            NSTimeInterval resume = [NSProcessInfo processInfo].systemUptime + resetTime;
 
-            NSInteger limit = [[resp.allHeaderFields valueForKey:@"X-RateLimit-Reset"] integerValue];
+            if (resume > rateLimitResumeTime) rateLimitResumeTime = resume;
+            rateLimitTokens = 0;
 
-            // Wait ('limit' * 1000) seconds and re-access the impCloud
+            // One of a hedged pair of reads whose twin is still in flight is simply discarded: the twin
+            // will deliver the result, so there is no need to send the read again
 
-            [NSTimer scheduledTimerWithTimeInterval:(limit * 1000)
-                                             target:self
-                                           selector:@selector(relaunchConnection:)
-                                           userInfo:dict
-                                            repeats:NO];
+            if (connexion != nil && [self dropHedgedConnexion:connexion])
+            {
+                if (connexions.count == 0) [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPIProgressStop" object:nil];
+                if (completionHandler != nil) completionHandler(NSURLSessionResponseCancel);
+                return;
+            }
 
             if (connexion != nil)
             {
-                [connexions removeObject:connexion];
-                numberOfConnections = connexions.count;
+                connexion.errorCode = 429;
+
+                [self removeConnexion:connexion];
+
+                connexion.task = nil;
+                connexion.data = [NSMutableData dataWithCapacity:0];
+                connexion.errorCode = -1;
+
+                if (collectMetrics)
+                {
+                    [self metricsForAction:connexion.initialActionCode].retries += 1;
+                    connexion.queuedTime = [NSProcessInfo processInfo].systemUptime;
+                }
+
+                if (connexion.priority != -1)
+                {
+                    [[connexionQueues objectAtIndex:connexion.priority] insertObject:connexion atIndex:0];
+                    [self scheduleConnections];
+                }
+                else if (connexion.actionCode == kConnectTypeLogStream)
+                {
+                    // Log streams have their own reconnection process
+
+                    [self streamDropped:connexion :nil];
+                }
+                else
+                {
+                    // Access token requests are not queued, so just retry once the window has reset
+
+                    [self performAfterDelay:resetTime :^{
+                        [self startConnexion:connexion];
+                    }];
+                }
             }
 
             if (connexions.count == 0) [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPIProgressStop" object:nil];
@@ -3220,6 +7715,21 @@ didReceiveResponse:(NSURLResponse *)response
         }
     }
 
+    // List responses are decoded as they arrive, so their raw bytes are not kept
+
+    if (resp.statusCode == 200 && [self isListAction:connexion.actionCode])
+    {
+        connexion.listParser = [[JSONListParser alloc] init];
+
+        if (useCompactRecords && [self collectionForAction:connexion.actionCode] != nil)
+        {
+            // Convert the records straight to CompactRecords, so the full records are never all held at once
+
+            connexion.listParser.decoder = recordDecoder;
+            connexion.listParser.fields = [self fieldsForAction:connexion.actionCode];
+        }
+    }
+
     // For all other server-issued errors, record the error code to deal with later
 
     connexion.errorCode = statusCode;
@@ -3239,16 +7749,9 @@ didReceiveResponse:(NSURLResponse *)response
 
     // Get the connexion instance representing this NSURLSessionDataTask
 
-    Connexion *connexion = nil;
+    Connexion *connexion = [self connexionForTask:dataTask];
 
-    for (Connexion *aConnexion in connexions)
-    {
-        if (aConnexion.task == dataTask)
-        {
-            connexion = aConnexion;
-            break;
-        }
-    }
+    if (collectMetrics) connexion.bytesReceived += data.length;
 
     if (connexion.actionCode == kConnectTypeLogStream)
     {
@@ -3256,6 +7759,16 @@ didReceiveResponse:(NSURLResponse *)response
 
         [self parseStreamData:data :connexion];
     }
+    else if (connexion.listParser != nil)
+    {
+        // For list connections, decode the elements of the list as they arrive
+
+        NSTimeInterval start = collectMetrics ? [NSProcessInfo processInfo].systemUptime : 0;
+
+        [connexion.listParser parseData:data];
+
+        if (collectMetrics) connexion.decodeTime += [NSProcessInfo processInfo].systemUptime - start;
+    }
     else
     {
         // For non-logging connections, append the incoming data chunk to the store
@@ -3276,18 +7789,11 @@ didCompleteWithError:(NSError *)error
 
     // Get the connexion instance representing this connection task
 
-    Connexion *connexion = nil;
+    Connexion *connexion = [self connexionForTask:task];
 
-    for (Connexion *aConnexion in connexions)
-    {
-        // Run through the connections in the list and find the one that has just finished loading
+    // The request is no longer in flight, so identical reads must no longer be attached to it
 
-        if (aConnexion.task == task)
-        {
-            connexion = aConnexion;
-            break;
-        }
-    }
+    if (error == nil || error.code != NSURLErrorCancelled) [self releaseCoalescedConnexion:connexion];
 
     // Complete the finished NSURLSessionTask - this may be redundant, but just in case...
 
@@ -3314,45 +7820,26 @@ didCompleteWithError:(NSError *)error
         {
             if (connexion.actionCode == kConnectTypeLogStream)
             {
-                // Are we logging? If so, handle this type of connection here
-                // Is the connection already closed? If so, just bail
-
-                if (logIsClosed) return;
-
-                logIsClosed = YES;
-                logStreamURL = nil;
-                logStreamID = nil;
-
-                // Create an error event
-
-                LogStreamEvent *event = [[LogStreamEvent alloc] init];
-                event.type = kLogStreamEventTypeError;
-                event.error = error != nil ? error : [NSError errorWithDomain:@"NSURLErrorDomain" code:event.state userInfo:@{ NSLocalizedDescriptionKey: @"Connection with the event source was closed." } ];
-
-                // Add an error event to the event queue
-
-                [eventQueue addOperationWithBlock:^{
-                    [self dispatchEvent:event];
-                }];
+                // Are we logging? If so, handle this type of connection here.
+                // Bail because we will handle connection clear-up later
 
-                /*
-                 // Attempt to re-open the connection in 'retryInterval' seconds
+                [self streamDropped:connexion :error];
+                return;
+            }
 
-                 [NSTimer timerWithTimeInterval:logRetryInterval
-                 repeats:NO
-                 block:^(NSTimer * _Nonnull timer) {
-                 [self openStream];
-                 }];
-                 */
+            // A read whose hedged twin may yet succeed, or which may succeed if it is sent again, is not reported
 
-                // Bail because we will handle connection clear-up later
+            if ([self dropHedgedConnexion:connexion] || ([self isTransientError:error] && [self retryConnexion:connexion]))
+            {
+                if (connexions.count == 0) [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPIProgressStop" object:nil];
 
                 return;
             }
 
-            // Make sure we're not logged in if we haven't been able to get an access token
+            // Make sure we're not logged in if we haven't been able to get an access token - unless
+            // this was a refresh made in the background while the current token is still good
 
-            if (connexion.actionCode == kConnectTypeGetAccessToken || connexion.actionCode == kConnectTypeRefreshAccessToken)
+            if (connexion.actionCode == kConnectTypeGetAccessToken || (connexion.actionCode == kConnectTypeRefreshAccessToken && ![self isAccessTokenValid]))
             {
                 isLoggedIn = NO;
 
@@ -3363,9 +7850,11 @@ didCompleteWithError:(NSError *)error
 
             [self reportError:kErrorNetworkError];
 
-            [connexions removeObject:connexion];
+            [self removeConnexion:connexion];
 
-            numberOfConnections = connexions.count;
+            // Release anything that was waiting on the request
+
+            [self requestFailed:connexion];
         }
 
         // If there are no more active connections, tell the host app
@@ -3380,19 +7869,58 @@ didCompleteWithError:(NSError *)error
 
     if (connexion != nil)
     {
-        if (connexion.actionCode != kConnectTypeNone)
+        if (connexion.actionCode == kConnectTypeLogStream)
+        {
+            // The server has ended a log stream's connection, so we need to re-open it
+
+            [self streamDropped:connexion :nil];
+        }
+        else if (connexion.actionCode != kConnectTypeNone)
         {
-            // Handle the received data
+            // If the read was hedged, it has beaten its twin, which must not deliver a second result
 
-            [self processResult:connexion :[self processConnection:connexion]];
+            [self settleHedge:connexion];
+            [self recordLatency:connexion];
+
+            // Handle the received data, keeping a copy if it is cacheable
+
+            [self cacheResponse:connexion];
+
+            if (processingQueue != nil && connexion.listParser == nil && connexion.data.length > 0)
+            {
+                // Decode the data on a concurrent queue, leaving the processing queue free to handle
+                // other responses - so that several can be decoded at once - and return with the result
+
+                NSData *data = connexion.data;
+                BOOL timed = collectMetrics;
+
+                dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+                    NSError *dataDecodeError = nil;
+                    NSTimeInterval start = timed ? [NSProcessInfo processInfo].systemUptime : 0;
+                    id parsedData = [NSJSONSerialization JSONObjectWithData:data options:kNilOptions error:&dataDecodeError];
+                    NSTimeInterval decodeTime = timed ? [NSProcessInfo processInfo].systemUptime - start : 0;
+
+                    [self performOnProcessingQueue:^{
+                        // Connections killed while the data was being decoded are ignored
+
+                        if (connexion.taskIdentifier == -1) return;
+
+                        connexion.decodeTime = decodeTime;
+
+                        [self completeConnexion:connexion :[self processConnection:connexion :parsedData :dataDecodeError]];
+                    }];
+                });
+            }
+            else
+            {
+                [self completeConnexion:connexion :[self processConnection:connexion]];
+            }
         }
         else
         {
             // This might be redundant - can a connexion ever have 'actionCode == kConnectTypeNone' at this point?
 
-            [connexions removeObject:connexion];
-
-            numberOfConnections = connexions.count;
+            [self removeConnexion:connexion];
 
             // If there are no more active connections, tell the host app
 
@@ -3406,9 +7934,22 @@ didCompleteWithError:(NSError *)error
 - (void)URLSession:(NSURLSession *)session didBecomeInvalidWithError:(NSError *)error
 {
     // This method is called after we have called invalidateAndCancel on an NSURLSession, eg. in 'killAllConnections:'
+    // NOTE a session replaced when the processing queue was changed may invalidate after its replacement is in use
 
+    if (session != apiSession) return;
+
+    apiSession = nil;
+
+    [self clearConnexions];
+}
+
+
+
+- (void)clearConnexions
+{
     // Clear all the connexions from the list
 
+    for (Connexion *connexion in connexions.allValues) connexion.taskIdentifier = -1;
     [connexions removeAllObjects];
 
     // Tell the host app
@@ -3417,7 +7958,6 @@ didCompleteWithError:(NSError *)error
 
     // Zero all the other connection-related properties
 
-    apiSession = nil;
     numberOfConnections = 0;
 }
 
@@ -3426,168 +7966,67 @@ didCompleteWithError:(NSError *)error
 #pragma mark - Connection Result Processing Methods
 
 
-- (void)parseStreamData:(NSData *)data :(Connexion *)connexion
+- (void)completeConnexion:(Connexion *)connexion :(NSDictionary *)result
 {
-    // Wrangle an incoming batch of streamed data to pull out server-sent events and extract
-    // the data from them (and defer incomplete events until the rest of them arrives)
-
-    NSString *eventString;
-
-    if (connexion.data != nil && connexion.data.length > 0)
-    {
-        // Add in existing data from the last streamed chunk, if there is any
-
-        [connexion.data appendData:data];
-        eventString = [[NSString alloc] initWithData:connexion.data encoding:NSUTF8StringEncoding];
-        connexion.data = [NSMutableData dataWithLength:0];
-    }
-    else
-    {
-        // Otherwise, just work with the freshly passed in data alone
-
-        eventString = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
-    }
-
-    // Check the last two characters of the string: are they newlines? If not, the data
-    // is truncated and needs to be retained for the next pass
-
-    NSString *lastTwoChars = @"";
-    if (eventString.length > 2) lastTwoChars = [eventString substringFromIndex:eventString.length - 2];
-    BOOL lastMessageTruncated = ([lastTwoChars compare:kLogStreamEventSeparatorLFLF] == NSOrderedSame) ? NO : YES;
-
-    // Separate the string into individual events (separated by newline pairs)
-    // If there are no newlines, events.count == 1, which we trap quickly
-
-    NSArray *events = [eventString componentsSeparatedByString:kLogStreamEventSeparatorLFLF];
-
-    if (events.count > 1)
-    {
-        for (NSUInteger i = 0 ; i < events.count ; ++i)
-        {
-            NSString *event = [events objectAtIndex:i];
-
-            // Empty event? Continue to the next in the series
-
-            if (event.length == 0) continue;
-
-            // Check if the last event on the list has been terminated correctly
-
-            if (i == events.count - 1 && lastMessageTruncated)
-            {
-                // This is the last detected event and it MIGHT be truncated, so just hold it for the next pass
+    // Pass a completed connexion's processed data on to the host
 
-                connexion.data = [NSMutableData dataWithData:[event dataUsingEncoding:NSUTF8StringEncoding]];
+    // Let the host start work on this page of a list while any later pages are retrieved
 
-#ifdef DEBUG
-     NSLog(@"Holding data for next stream chunk\nEvent -> %@", event);
-#endif
-
-            }
-            else
-            {
-                // We have an event that we KNOW has been terminated with a \n\n,
-                // ie. it is complete and can be processed
+    if (notifyListPages && connexion.actionCode != kConnectTypeNone && [self isListAction:connexion.actionCode]) [self notifyListPage:connexion :result];
 
-                LogStreamEvent *logStreamEvent = [[LogStreamEvent alloc] init];
-                logStreamEvent.type = kLogStreamEventTypeMessage;
+    [self processResult:connexion :result];
 
-                // Separate the key-value pairs (separated by newlines)
+    // Pass the result on to any callers that shared the request
 
-                NSArray *lines = [event componentsSeparatedByString:kLogStreamEventKeyValuePairSeparator];
+    [self fanOutResult:connexion :result];
+}
 
-#ifdef DEBUG
-    NSLog(@"Lines -> %lu", (long)lines.count);
-#endif
 
-                // Run through each of the event's lines and extract the information into the
-                // relevant logStreamEvent object properties
 
-                for (NSString *line in lines)
-                {
+- (void)parseStreamData:(NSData *)data :(Connexion *)connexion
+{
+    // Pass an incoming batch of streamed data to the connexion's SSE parser, which extracts
+    // any complete server-sent events and defers incomplete events until the rest arrives
 
-#ifdef DEBUG
-    NSLog(@"Line  -> %@ (%li)", line, (long)line.length);
-#endif
+    if (connexion.streamParser == nil) connexion.streamParser = [[LogStreamParser alloc] init];
 
-                    if ([line hasPrefix:@":"]) continue;
+    LogStream *stream = (LogStream *)connexion.representedObject;
+    NSArray *events = [connexion.streamParser parseData:data];
 
-                    NSString *key, *value;
-                    NSRange fieldSeparatorRange = [line rangeOfString:kLogStreamKeyValueDelimiter];
+    if (collectMetrics)
+    {
+        stream.eventCount += events.count;
+        stream.byteCount += data.length;
+        if (stream.sampleTime == 0) stream.sampleTime = [NSProcessInfo processInfo].systemUptime;
+    }
 
-                    if (fieldSeparatorRange.location != NSNotFound)
-                    {
-                        key = [line substringToIndex:fieldSeparatorRange.location];
-                        value = [line substringFromIndex:fieldSeparatorRange.location + 2];
+    // Record the stream's 'id' and 'retry' values for when the stream needs to be re-opened
 
-                        if (key != nil && value != nil)
-                        {
-                            if ([key isEqualToString:kLogStreamEventEventKey])
-                            {
-                                // 'event' - value will be 'message' or 'state_change'
-
-                                logStreamEvent.event = value;
-                            }
-                            else if ([key isEqualToString:kLogStreamEventDataKey])
-                            {
-                                // 'data' - value will be, eg. 'opened', 'closed', '40000c2a69109f08 subscribed', or '<log entry>'
-
-                                logStreamEvent.data = logStreamEvent.data != nil ? [logStreamEvent.data stringByAppendingFormat:@"\n%@", value] : value;
-                            }
-                            else if ([key isEqualToString:kLogStreamEventIDKey])
-                            {
-                                // 'id'
-
-                                logLastEventID = value;
-                            }
-                            else if ([key isEqualToString:kLogStreamEventRetryKey])
-                            {
-                                // 'retry'
-
-                                logRetryInterval = [value doubleValue];
-                            }
-                        }
-                    }
-                    else
-                    {
+    if (connexion.streamParser.lastEventID != nil) stream.lastEventID = connexion.streamParser.lastEventID;
+    if (connexion.streamParser.retryInterval > 0) stream.retryInterval = connexion.streamParser.retryInterval;
 
-#ifdef DEBUG
-    // No field separator????
-                        NSLog(@"Incoming event malformed - no field separator (: )");
-#endif
-                    }
-                }
+    for (LogStreamEvent *logStreamEvent in events)
+    {
+        logStreamEvent.stream = stream;
 
-                if (logStreamEvent.data != nil)
-                {
-                    // Change the logStreamEvent's 'state' according to type
-                    // NOTE 'type' is set to kLogStreamEventTypeMessage above; 'state' doesn't matter for messages
+        // Add log entries to their device's timeline, which merges them with its historical entries
 
-                    if ([logStreamEvent.event compare:@"state_change"] == NSOrderedSame)
-                    {
-                        logStreamEvent.type = kLogStreamEventTypeStateChange;
-                        if ([logStreamEvent.data compare:@"opened"] == NSOrderedSame) logStreamEvent.state = kLogStreamEventStateOpen;
-                        if ([logStreamEvent.data compare:@"closed"] == NSOrderedSame) logStreamEvent.state = kLogStreamEventStateClosed;
-                        if ([logStreamEvent.data hasSuffix:@"subscribed"]) logStreamEvent.state = kLogStreamEventStateSubscribed;
-                        if ([logStreamEvent.data hasSuffix:@"unsubscribed"]) logStreamEvent.state = kLogStreamEventStateUnsubscribed;
-                    }
+        if (logStreamEvent.type == kLogStreamEventTypeMessage && logStreamEvent.data != nil) [self addStreamedLogEntry:logStreamEvent.data];
 
-                    // Place the event in the the event queue to guarantee displayed order = received order
+        if (logBatchInterval > 0 && logStreamEvent.type == kLogStreamEventTypeMessage)
+        {
+            // When batching, messages are gathered here (we are already on the processing queue)
+            // rather than being relayed individually via the event queue
 
-                    [eventQueue addOperationWithBlock:^{
-                        [self dispatchEvent:logStreamEvent];
-                    }];
-                }
-            }
+            if (logStreamEvent.data != nil) [self queueLogEntry:logStreamEvent.data];
+            continue;
         }
-    }
-    else
-    {
-        // Partial event (no \n\n in received data) so preserve it in the connexion
-        // so it's ready to be added to the next chunk of data received from the server
 
-        if (connexion.data == nil) connexion.data = [[NSMutableData alloc] init];
+        // Place the event in the the event queue to guarantee displayed order = received order
 
-        [connexion.data appendData:data];
+        [eventQueue addOperationWithBlock:^{
+            [self dispatchEvent:logStreamEvent];
+        }];
     }
 }
 
@@ -3595,28 +8034,52 @@ didCompleteWithError:(NSError *)error
 
 - (NSDictionary *)processConnection:(Connexion *)connexion
 {
-    // Process the data returned by the current connection
-    // This may include an API error, so this is where we do the main impCentral API error
-    // handling, eg. for code compilation errors
+    // Decode the data returned by the current connection, then process it
 
     id parsedData = nil;
     NSError *dataDecodeError = nil;
-    NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
 
-    if (connexion.data != nil && connexion.data.length > 0)
+    if (connexion.listParser != nil)
+    {
+        // The list has been decoded as it arrived, so just collect the result
+
+        parsedData = [connexion.listParser result];
+        dataDecodeError = connexion.listParser.error;
+        connexion.listParser = nil;
+    }
+    else if (connexion.data != nil && connexion.data.length > 0)
     {
         // If we have received data, so attempt to decode it assuming that it is JSON
         // If it's not JSON, 'dataDecodeError' will not be nil
 
+        NSTimeInterval start = collectMetrics ? [NSProcessInfo processInfo].systemUptime : 0;
+
         parsedData = [NSJSONSerialization JSONObjectWithData:connexion.data options:kNilOptions error:&dataDecodeError];
+
+        if (collectMetrics) connexion.decodeTime = [NSProcessInfo processInfo].systemUptime - start;
     }
 
+    return [self processConnection:connexion :parsedData :dataDecodeError];
+}
+
+
+
+- (NSDictionary *)processConnection:(Connexion *)connexion :(id)parsedData :(NSError *)dataDecodeError
+{
+    // Process the decoded data returned by the current connection
+    // This may include an API error, so this is where we do the main impCentral API error
+    // handling, eg. for code compilation errors
+
+    NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
+
     if (dataDecodeError != nil)
     {
         // If the incoming data could not be decoded to JSON for some reason.
         // NOTE Most likely this is caused by a malformed request which returns a block of HTML
 
-        errorMessage = [NSString stringWithFormat:@"[SERVER ERROR] Received data could not be decoded: %@", [[NSString alloc] initWithData:connexion.data encoding:NSUTF8StringEncoding]];
+        errorMessage = connexion.data.length > 0
+        ? [NSString stringWithFormat:@"[SERVER ERROR] Received data could not be decoded: %@", [[NSString alloc] initWithData:connexion.data encoding:NSUTF8StringEncoding]]
+        : [NSString stringWithFormat:@"[SERVER ERROR] Received data could not be decoded: %@", dataDecodeError.localizedDescription];
         [self reportError];
 
         connexion.errorCode = -1;
@@ -3675,7 +8138,7 @@ didCompleteWithError:(NSError *)error
                         NSMutableDictionary *errorDict = [NSMutableDictionary dictionaryWithDictionary:error];
                         NSString *action = @"N/A";
 
-                        if (connexion.representedObject != nil)
+                        if ([connexion.representedObject isKindOfClass:[NSDictionary class]])
                         {
                             NSString *act = [connexion.representedObject objectForKey:@"action"];
 
@@ -3704,6 +8167,7 @@ didCompleteWithError:(NSError *)error
                     [nc postNotificationName:@"BuildAPICodeErrors" object:returnData];
 
                     errorMessage = nil;
+                    lastError = @{ @"message" : @"The code contains errors", @"code" : @-1, @"data" : codeErrors };
                 }
             }
         }
@@ -3722,7 +8186,7 @@ didCompleteWithError:(NSError *)error
 
         // Report the error to the host if we have one (code compilation errors clear 'errorMessage')
 
-        if (connexion.representedObject != nil)
+        if ([connexion.representedObject isKindOfClass:[NSDictionary class]])
         {
             NSDictionary *dict = connexion.representedObject;
             NSString *action = [dict objectForKey:@"action"];
@@ -3734,9 +8198,7 @@ didCompleteWithError:(NSError *)error
 
     // Tidy up the connection list by removing the current connexion from the list of connexions
 
-    [connexions removeObject:connexion];
-
-    numberOfConnections = connexions.count;
+    [self removeConnexion:connexion];
 
     // Signal the host app if the number of connections is zero
 
@@ -3749,6 +8211,76 @@ didCompleteWithError:(NSError *)error
 
 
 
+- (void)notifyListPage:(Connexion *)connexion :(NSDictionary *)data
+{
+    // Post a notification carrying a single page of a list as soon as it has been received,
+    // for the connexion's caller and for any callers sharing the request. The notification's
+    // object contains the keys 'data' (the page's items), 'page' (its number), 'list' (the
+    // type of list) and, if the caller supplied one, 'object'
+
+    NSArray *items = [data objectForKey:@"data"];
+    NSString *list = nil;
+
+    if (![items isKindOfClass:[NSArray class]]) return;
+
+    switch (connexion.actionCode)
+    {
+        case kConnectTypeGetProducts:
+            list = @"products";
+            break;
+        case kConnectTypeGetDeviceGroups:
+            list = @"devicegroups";
+            break;
+        case kConnectTypeGetDeployments:
+            list = @"deployments";
+            break;
+        case kConnectTypeGetDevices:
+            list = @"devices";
+            break;
+        case kConnectTypeGetDeviceLogs:
+            list = @"logs";
+            break;
+        case kConnectTypeGetDeviceHistory:
+            list = @"history";
+            break;
+        case kConnectTypeSyncProducts:
+        case kConnectTypeSyncDeviceGroups:
+        case kConnectTypeSyncDevices:
+            // Fleet mirror syncs are not the host's lists
+            return;
+        default:
+            list = @"libraries";
+    }
+
+    // Pages retrieved one at a time carry their number in their URL; the first page does not
+
+    NSInteger page = connexion.pageNumber;
+
+    if (page == 0)
+    {
+        NSString *url = connexion.originalRequest.URL.absoluteString;
+        NSRange range = [self rangeOfPageNumber:url];
+
+        page = range.location != NSNotFound ? [[url substringWithRange:range] integerValue] : 1;
+    }
+
+    NSMutableArray *callers = [NSMutableArray arrayWithObject:connexion];
+
+    if (connexion.followers != nil) [callers addObjectsFromArray:connexion.followers];
+    if (connexion.pagedList.followers != nil) [callers addObjectsFromArray:connexion.pagedList.followers];
+
+    for (Connexion *caller in callers)
+    {
+        NSDictionary *dict = caller.representedObject != nil
+        ? @{ @"data" : items, @"page" : [NSNumber numberWithInteger:page], @"list" : list, @"object" : caller.representedObject }
+        : @{ @"data" : items, @"page" : [NSNumber numberWithInteger:page], @"list" : list };
+
+        [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPIGotListPage" object:dict];
+    }
+}
+
+
+
 - (void)processResult:(Connexion *)connexion :(NSDictionary *)data
 {
     // If there has been no error recorded, we can now process the real data returned by the server
@@ -3761,12 +8293,28 @@ didCompleteWithError:(NSError *)error
     //   "data" - The data retrieved from the server, eg. the updated product, or
     //            a useful message string (in cases where these is no returned data)
 
-    // Avoid processing the connection if it has no action code
+    // Avoid processing the connection if it has no action code, ie. it has failed, but
+    // release anything that was waiting on it
 
-    if (connexion.actionCode == kConnectTypeNone) return;
+    if (connexion.actionCode == kConnectTypeNone)
+    {
+        [self requestFailed:connexion];
+        return;
+    }
+
+    // Convert list records to CompactRecords if they were not converted as they arrived
+
+    data = [self compactListData:connexion :data];
+
+    // Discard any cached responses the action may have made stale
+
+    [self invalidateCacheForAction:connexion.actionCode];
+
+    // Record any record the action has retrieved, or any change it has made, in the fleet mirror
+
+    [self updateMirror:connexion :data];
 
     NSDictionary *returnData;
-    NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
 
     switch (connexion.actionCode)
     {
@@ -3777,34 +8325,60 @@ didCompleteWithError:(NSError *)error
             // to check for the supplied URL of the next page in sequence
 
             if (products == nil) products = [[NSMutableArray alloc] init];
-            NSString *nextURL = [self addDataToList:products :data];
-            
-            if (nextURL.length != 0)
-            {
-                // We found a 'next' field in the 'links' list. This will get us the next page of data
-                // which we do by making a new request using the provided 'next' link
 
-                NSMutableURLRequest *request = [self makeGETrequest:nextURL :NO];
+            if (connexion.pagedList != nil)
+            {
+                // This is one of several pages being retrieved concurrently: add it, and only
+                // notify the host once all of the list's pages have arrived
 
-                if (request)
-                {
-                    [self launchConnection:request :kConnectTypeGetProducts :connexion.representedObject];
-                    break;
-                }
-                else
+                if (![self addPageToPagedList:connexion :data]) break;
+            }
+            else
+            {
+                NSString *nextURL = [self addDataToList:products :data];
+            
+                if (nextURL.length != 0)
                 {
-                    errorMessage = @"Could not create a request to list all of your products — the list may be incomplete.";
-                    [self reportError];
+                    // Retrieve all of the remaining pages at once if we can...
+
+                    if ([self fetchRemainingPages:connexion :data :products]) break;
+
+                    // ...otherwise request the next page only. We found a 'next' field in the 'links' list.
+                    // This will get us the next page of data which we do by making a new request using
+                    // the provided 'next' link
+
+                    NSMutableURLRequest *request = [self makeGETrequest:nextURL :NO];
+
+                    if (request)
+                    {
+                        Connexion *nextConnexion = [self launchConnection:request :kConnectTypeGetProducts :connexion.representedObject];
+                        nextConnexion.followers = connexion.followers;
+                        connexion.followers = nil;
+                        break;
+                    }
+                    else
+                    {
+                        errorMessage = @"Could not create a request to list all of your products — the list may be incomplete.";
+                        [self reportError];
+                    }
                 }
             }
 
             // Send the array of products to the host
 
             returnData = connexion.representedObject != nil
-            ? @{ @"data" : products, @"object" : connexion.representedObject }
-            : @{ @"data" : products };
+            ? @{ @"data" : [NSArray arrayWithArray:products], @"object" : connexion.representedObject }
+            : @{ @"data" : [NSArray arrayWithArray:products] };
+
+            [self mirrorList:connexion :products];
+
+            // The list is complete, so empty the decoder's table of shared strings: the records keep
+            // the strings they use, and the table does not grow with every list retrieved
+
+            [recordDecoder clear];
 
-            [nc postNotificationName:@"BuildAPIGotProductsList" object:returnData];
+            [self relayResult:@"BuildAPIGotProductsList" :returnData];
+            [self notifyFollowers:connexion :@"BuildAPIGotProductsList" :returnData];
             break;
         }
 
@@ -3818,7 +8392,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : data, @"object" : connexion.representedObject }
             : @{ @"data" : data };
 
-            [nc postNotificationName:@"BuildAPIProductCreated" object:returnData];
+            [self relayResult:@"BuildAPIProductCreated" :returnData];
             break;
         }
 
@@ -3832,7 +8406,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : data, @"object" : connexion.representedObject }
             : @{ @"data" : data };
 
-            [nc postNotificationName:@"BuildAPIProductUpdated" object:returnData];
+            [self relayResult:@"BuildAPIProductUpdated" :returnData];
             break;
         }
 
@@ -3844,7 +8418,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : @"deleted", @"object" : connexion.representedObject }
             : @{ @"data" : @"deleted" };
 
-            [nc postNotificationName:@"BuildAPIProductDeleted" object:returnData];
+            [self relayResult:@"BuildAPIProductDeleted" :returnData];
             break;
         }
 
@@ -3859,7 +8433,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : product, @"object" : connexion.representedObject }
             : @{ @"data" : product };
 
-            [nc postNotificationName:@"BuildAPIGotProduct" object:returnData];
+            [self relayResult:@"BuildAPIGotProduct" :returnData];
             break;
         }
 
@@ -3870,29 +8444,51 @@ didCompleteWithError:(NSError *)error
             // to check for the supplied URL of the next page in sequence
             
             if (devicegroups == nil) devicegroups = [[NSMutableArray alloc] init];
-            NSString *nextURL = [self addDataToList:devicegroups :data];
-            
-            if (nextURL.length != 0)
+
+            if (connexion.pagedList != nil)
             {
-                NSMutableURLRequest *request = [self makeGETrequest:nextURL :YES];
+                // This is one of several pages being retrieved concurrently: add it, and only
+                // notify the host once all of the list's pages have arrived
 
-                if (request)
-                {
-                    [self launchConnection:request :kConnectTypeGetDeviceGroups :connexion.representedObject];
-                    break;
-                }
-                else
+                if (![self addPageToPagedList:connexion :data]) break;
+            }
+            else
+            {
+                NSString *nextURL = [self addDataToList:devicegroups :data];
+            
+                if (nextURL.length != 0)
                 {
-                    errorMessage = @"Could not create a request to list all of your device groups — the list may be incomplete.";
-                    [self reportError];
+                    // Retrieve all of the remaining pages at once if we can...
+
+                    if ([self fetchRemainingPages:connexion :data :devicegroups]) break;
+
+                    // ...otherwise request the next page only
+
+                    NSMutableURLRequest *request = [self makeGETrequest:nextURL :YES];
+
+                    if (request)
+                    {
+                        Connexion *nextConnexion = [self launchConnection:request :kConnectTypeGetDeviceGroups :connexion.representedObject];
+                        nextConnexion.followers = connexion.followers;
+                        connexion.followers = nil;
+                        break;
+                    }
+                    else
+                    {
+                        errorMessage = @"Could not create a request to list all of your device groups — the list may be incomplete.";
+                        [self reportError];
+                    }
                 }
             }
 
             returnData = connexion.representedObject != nil
-            ? @{ @"data" : devicegroups, @"object" : connexion.representedObject }
-            : @{ @"data" : devicegroups };
+            ? @{ @"data" : [NSArray arrayWithArray:devicegroups], @"object" : connexion.representedObject }
+            : @{ @"data" : [NSArray arrayWithArray:devicegroups] };
 
-            [nc postNotificationName:@"BuildAPIGotDeviceGroupsList" object:returnData];
+            [self mirrorList:connexion :devicegroups];
+            [recordDecoder clear];
+            [self relayResult:@"BuildAPIGotDeviceGroupsList" :returnData];
+            [self notifyFollowers:connexion :@"BuildAPIGotDeviceGroupsList" :returnData];
             break;
         }
 
@@ -3906,7 +8502,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : data, @"object" : connexion.representedObject }
             : @{ @"data" : data };
 
-            [nc postNotificationName:@"BuildAPIDeviceGroupCreated" object:returnData];
+            [self relayResult:@"BuildAPIDeviceGroupCreated" :returnData];
             break;
         }
 
@@ -3920,7 +8516,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : data, @"object" : connexion.representedObject }
             : @{ @"data" : data };
 
-            [nc postNotificationName:@"BuildAPIDeviceGroupUpdated" object:returnData];
+            [self relayResult:@"BuildAPIDeviceGroupUpdated" :returnData];
             break;
         }
 
@@ -3932,7 +8528,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"object" : connexion.representedObject }
             : nil;
 
-            [nc postNotificationName:@"BuildAPIDeviceGroupDeleted" object:returnData];
+            [self relayResult:@"BuildAPIDeviceGroupDeleted" :returnData];
             break;
         }
 
@@ -3946,7 +8542,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : dg, @"object" : connexion.representedObject }
             : @{ @"data" : dg };
 
-            [nc postNotificationName:@"BuildAPIGotDevicegroup" object:returnData];
+            [self relayResult:@"BuildAPIGotDevicegroup" :returnData];
             break;
         }
 
@@ -3958,7 +8554,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : @"restarted", @"object" : connexion.representedObject }
             : @{ @"data" : @"restarted" };
 
-            [nc postNotificationName:@"BuildAPIDeviceGroupRestarted" object:returnData];
+            [self relayResult:@"BuildAPIDeviceGroupRestarted" :returnData];
             break;
         }
 
@@ -3969,29 +8565,51 @@ didCompleteWithError:(NSError *)error
             // to check for the supplied URL of the next page in sequence
             
             if (deployments == nil) deployments = [[NSMutableArray alloc] init];
-            NSString *nextURL = [self addDataToList:deployments :data];
-            
-            if (nextURL.length != 0 && deployments.count < maxListCount)
+
+            if (connexion.pagedList != nil)
             {
-                NSMutableURLRequest *request = [self makeGETrequest:nextURL :YES];
+                // This is one of several pages being retrieved concurrently: add it, and only
+                // notify the host once all of the list's pages have arrived
 
-                if (request)
-                {
-                    [self launchConnection:request :kConnectTypeGetDeployments :connexion.representedObject];
-                    break;
-                }
-                else
+                if (![self addPageToPagedList:connexion :data]) break;
+            }
+            else
+            {
+                NSString *nextURL = [self addDataToList:deployments :data];
+            
+                if (nextURL.length != 0 && deployments.count < maxListCount)
                 {
-                    errorMessage = @"Could not create a request to list all of your deployments — the list may be incomplete.";
-                    [self reportError];
+                    // Retrieve all of the remaining pages at once if we can...
+
+                    if ([self fetchRemainingPages:connexion :data :deployments]) break;
+
+                    // ...otherwise request the next page only
+
+                    NSMutableURLRequest *request = [self makeGETrequest:nextURL :YES];
+
+                    if (request)
+                    {
+                        Connexion *nextConnexion = [self launchConnection:request :kConnectTypeGetDeployments :connexion.representedObject];
+                        nextConnexion.followers = connexion.followers;
+                        connexion.followers = nil;
+                        break;
+                    }
+                    else
+                    {
+                        errorMessage = @"Could not create a request to list all of your deployments — the list may be incomplete.";
+                        [self reportError];
+                    }
                 }
             }
 
             returnData = connexion.representedObject != nil
-            ? @{ @"data" : deployments, @"object" : connexion.representedObject }
-            : @{ @"data" : deployments };
+            ? @{ @"data" : [NSArray arrayWithArray:deployments], @"object" : connexion.representedObject }
+            : @{ @"data" : [NSArray arrayWithArray:deployments] };
 
-            [nc postNotificationName:@"BuildAPIGotDeploymentsList" object:returnData];
+            [self mirrorList:connexion :deployments];
+            [recordDecoder clear];
+            [self relayResult:@"BuildAPIGotDeploymentsList" :returnData];
+            [self notifyFollowers:connexion :@"BuildAPIGotDeploymentsList" :returnData];
             break;
         }
 
@@ -4005,7 +8623,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : data, @"object" : connexion.representedObject }
             : @{ @"data" : data };
 
-            [nc postNotificationName:@"BuildAPIDeploymentCreated" object:returnData];
+            [self relayResult:@"BuildAPIDeploymentCreated" :returnData];
             break;
         }
 
@@ -4019,7 +8637,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : data, @"object" : connexion.representedObject }
             : @{ @"data" : data };
 
-            [nc postNotificationName:@"BuildAPIDeploymentUpdated" object:returnData];
+            [self relayResult:@"BuildAPIDeploymentUpdated" :returnData];
             break;
         }
 
@@ -4031,7 +8649,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : @"deleted", @"object" : connexion.representedObject }
             : @{ @"data" : @"deleted" };
 
-            [nc postNotificationName:@"BuildAPIDeploymentDeleted" object:returnData];
+            [self relayResult:@"BuildAPIDeploymentDeleted" :returnData];
             break;
         }
 
@@ -4045,7 +8663,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : dp, @"object" : connexion.representedObject }
             : @{ @"data" : dp };
 
-            [nc postNotificationName:@"BuildAPIGotDeployment" object:returnData];
+            [self relayResult:@"BuildAPIGotDeployment" :returnData];
             break;
         }
 
@@ -4059,7 +8677,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : dp, @"object" : connexion.representedObject }
             : @{ @"data" : dp };
 
-            [nc postNotificationName:@"BuildAPISetMinDeployment" object:returnData];
+            [self relayResult:@"BuildAPISetMinDeployment" :returnData];
             break;
         }
 
@@ -4070,29 +8688,51 @@ didCompleteWithError:(NSError *)error
             // to check for the supplied URL of the next page in sequence
 
             if (devices == nil) devices = [[NSMutableArray alloc] init];
-            NSString *nextURL = [self addDataToList:devices :data];
-            
-            if (nextURL.length != 0)
+
+            if (connexion.pagedList != nil)
             {
-                NSMutableURLRequest *request = [self makeGETrequest:nextURL :YES];
+                // This is one of several pages being retrieved concurrently: add it, and only
+                // notify the host once all of the list's pages have arrived
 
-                if (request)
-                {
-                    [self launchConnection:request :kConnectTypeGetDevices :connexion.representedObject];
-                    break;
-                }
-                else
+                if (![self addPageToPagedList:connexion :data]) break;
+            }
+            else
+            {
+                NSString *nextURL = [self addDataToList:devices :data];
+            
+                if (nextURL.length != 0)
                 {
-                    errorMessage = @"Could not create a request to list all of your devices — the list may be incomplete.";
-                    [self reportError];
+                    // Retrieve all of the remaining pages at once if we can...
+
+                    if ([self fetchRemainingPages:connexion :data :devices]) break;
+
+                    // ...otherwise request the next page only
+
+                    NSMutableURLRequest *request = [self makeGETrequest:nextURL :YES];
+
+                    if (request)
+                    {
+                        Connexion *nextConnexion = [self launchConnection:request :kConnectTypeGetDevices :connexion.representedObject];
+                        nextConnexion.followers = connexion.followers;
+                        connexion.followers = nil;
+                        break;
+                    }
+                    else
+                    {
+                        errorMessage = @"Could not create a request to list all of your devices — the list may be incomplete.";
+                        [self reportError];
+                    }
                 }
             }
 
             returnData = connexion.representedObject != nil
-            ? @{ @"data" : devices, @"object" : connexion.representedObject }
-            : @{ @"data" : devices };
+            ? @{ @"data" : [NSArray arrayWithArray:devices], @"object" : connexion.representedObject }
+            : @{ @"data" : [NSArray arrayWithArray:devices] };
 
-            [nc postNotificationName:@"BuildAPIGotDevicesList" object:returnData];
+            [self mirrorList:connexion :devices];
+            [recordDecoder clear];
+            [self relayResult:@"BuildAPIGotDevicesList" :returnData];
+            [self notifyFollowers:connexion :@"BuildAPIGotDevicesList" :returnData];
             break;
         }
 
@@ -4106,7 +8746,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : data, @"object" : connexion.representedObject }
             : @{ @"data" : data };
 
-            [nc postNotificationName:@"BuildAPIDeviceUpdated" object:returnData];
+            [self relayResult:@"BuildAPIDeviceUpdated" :returnData];
             break;
         }
 
@@ -4118,7 +8758,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : @"deleted", @"object" : connexion.representedObject }
             : @{ @"data" : @"deleted" };
 
-            [nc postNotificationName:@"BuildAPIDeviceDeleted" object:returnData];
+            [self relayResult:@"BuildAPIDeviceDeleted" :returnData];
             break;
         }
 
@@ -4130,7 +8770,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : @"assigned", @"object" : connexion.representedObject }
             : @{ @"data" : @"assigned" };
 
-            [nc postNotificationName:@"BuildAPIDeviceAssigned" object:returnData];
+            [self relayResult:@"BuildAPIDeviceAssigned" :returnData];
             break;
         }
 
@@ -4142,7 +8782,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : @"assigned", @"object" : connexion.representedObject }
             : @{ @"data" : @"assigned" };
 
-            [nc postNotificationName:@"BuildAPIDevicesAssigned" object:returnData];
+            [self relayResult:@"BuildAPIDevicesAssigned" :returnData];
             break;
         }
 
@@ -4154,7 +8794,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : @"unassigned", @"object" : connexion.representedObject }
             : @{ @"data" : @"unassigned" };
 
-            [nc postNotificationName:@"BuildAPIDeviceUnassigned" object:returnData];
+            [self relayResult:@"BuildAPIDeviceUnassigned" :returnData];
             break;
         }
 
@@ -4166,7 +8806,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : @"unassigned", @"object" : connexion.representedObject }
             : @{ @"data" : @"unassigned" };
 
-            [nc postNotificationName:@"BuildAPIDevicesUnassigned" object:returnData];
+            [self relayResult:@"BuildAPIDevicesUnassigned" :returnData];
             break;
         }
 
@@ -4178,7 +8818,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : @"restarted", @"object" : connexion.representedObject }
             : @{ @"data" : @"restarted" };
 
-            [nc postNotificationName:@"BuildAPIDeviceRestarted" object:returnData];
+            [self relayResult:@"BuildAPIDeviceRestarted" :returnData];
             break;
         }
 
@@ -4192,26 +8832,63 @@ didCompleteWithError:(NSError *)error
             ? @{ @"data" : device, @"object" : connexion.representedObject }
             : @{ @"data" : device };
 
-            [nc postNotificationName:@"BuildAPIGotDevice" object:returnData];
+            [self relayResult:@"BuildAPIGotDevice" :returnData];
+            break;
+        }
+
+        case kConnectTypeSyncProducts:
+        case kConnectTypeSyncDeviceGroups:
+        case kConnectTypeSyncDevices:
+        {
+            // The server returns a page of a list being re-retrieved for the fleet mirror. The pages are
+            // gathered into the sync's own array, one at a time, and once the list is complete the mirror
+            // is brought into line with it. The host is not notified
+
+            NSMutableArray *list = [connexion.representedObject objectForKey:@"sync"];
+            NSString *nextURL = [self addDataToList:list :data];
+
+            if (nextURL.length != 0)
+            {
+                NSMutableURLRequest *request = [self makeGETrequest:nextURL :YES];
+
+                if (request)
+                {
+                    [self launchConnection:request :connexion.actionCode :connexion.representedObject];
+                    break;
+                }
+
+                // The list is incomplete, so the mirror must not drop records missing from it
+
+                connexion.isPartialList = YES;
+            }
+
+            [self mirrorList:connexion :list];
+            [recordDecoder clear];
             break;
         }
 
         case kConnectTypeGetDeviceLogs:
         {
-            // The server returns an array of one or more log entries, which we add to an
-            // emptied master array. The list is returned one page at a time, so we need
-            // to check for the supplied URL of the next page in sequence
+            // The server returns a page of the device's log entries, newest first. Only entries newer than
+            // the device's log cursor are gathered, and pages are requested until one reaches the cursor,
+            // the list ends or 'maxListCount' entries have been gathered. The new entries are relayed to the
+            // host in the server's order, and added to the device's timeline, which is relayed alongside
 
-            if (logs == nil) logs = [[NSMutableArray alloc] init];
-            NSString *nextURL = [self addDataToList:logs :data];
-            
-            if (nextURL.length != 0 && logs.count < maxListCount)
+            DeviceTimeline *timeline = [self timelineForRequest:connexion];
+
+            if (timeline == nil) break;
+
+            NSString *nextURL = [self addTimelinePage:timeline.pendingLogs :data :timeline.logCursor :timeline.logCursorKeys];
+
+            if (nextURL.length != 0 && timeline.pendingLogs.count < maxListCount)
             {
                 NSMutableURLRequest *request = [self makeGETrequest:nextURL :YES];
 
                 if (request)
                 {
-                    [self launchConnection:request :kConnectTypeGetDeviceLogs :connexion.representedObject];
+                    Connexion *nextConnexion = [self launchConnection:request :kConnectTypeGetDeviceLogs :connexion.representedObject];
+                    nextConnexion.followers = connexion.followers;
+                    connexion.followers = nil;
                     break;
                 }
                 else
@@ -4221,46 +8898,73 @@ didCompleteWithError:(NSError *)error
                 }
             }
 
+            NSArray *entries = [self mergeTimelineEntries:timeline :NO];
+            NSArray *merged = [timeline.logs allObjects];
+
             NSDictionary *dict = connexion.representedObject != nil
-            ? @{ @"data" : logs, @"count" : [NSNumber numberWithInteger:logs.count], @"object" : connexion.representedObject }
-            : @{ @"data" : logs, @"count" : [NSNumber numberWithInteger:logs.count] };
+            ? @{ @"data" : entries, @"count" : [NSNumber numberWithInteger:entries.count], @"timeline" : merged, @"device" : timeline.deviceID, @"object" : connexion.representedObject }
+            : @{ @"data" : entries, @"count" : [NSNumber numberWithInteger:entries.count], @"timeline" : merged, @"device" : timeline.deviceID };
 
-            [nc postNotificationName:@"BuildAPIGotLogs" object:dict];
+            [self relayResult:@"BuildAPIGotLogs" :dict];
+            [self notifyFollowers:connexion :@"BuildAPIGotLogs" :dict];
             break;
         }
 
         case kConnectTypeGetDeviceHistory:
         {
-            // The server returns an array of one or more log entries, which we add to an
-            // emptied master array. The list is returned one page at a time, so we need
-            // to check for the supplied URL of the next page in sequence
+            // The server returns a page of the device's history entries, which are gathered as for logs
+            // (see above). The first time a device's history is retrieved, there is no cursor to stop at,
+            // so the pages may be retrieved concurrently
 
-            if (history == nil) history = [[NSMutableArray alloc] init];
-            NSString *nextURL = [self addDataToList:history :data];
-            
-            if (nextURL.length != 0 && history.count < maxListCount)
+            DeviceTimeline *timeline = [self timelineForRequest:connexion];
+
+            if (timeline == nil) break;
+
+            if (connexion.pagedList != nil)
             {
-                // There is at least one more page of data, so go and get it
+                // This is one of several pages being retrieved concurrently: add it, and only
+                // notify the host once all of the list's pages have arrived
 
-                NSMutableURLRequest *request = [self makeGETrequest:nextURL :YES];
+                if (![self addPageToPagedList:connexion :data]) break;
+            }
+            else
+            {
+                NSString *nextURL = [self addTimelinePage:timeline.pendingHistory :data :timeline.historyCursor :timeline.historyCursorKeys];
 
-                if (request)
-                {
-                    [self launchConnection:request :kConnectTypeGetDeviceHistory :connexion.representedObject];
-                    break;
-                }
-                else
+                if (nextURL.length != 0 && timeline.pendingHistory.count < maxListCount)
                 {
-                    errorMessage = @"Could not create a request to list all of a device's history — the list may be incomplete.";
-                    [self reportError];
+                    // Retrieve all of the remaining pages at once if we can...
+
+                    if (timeline.historyCursor == nil && [self fetchRemainingPages:connexion :data :timeline.pendingHistory]) break;
+
+                    // ...otherwise request the next page only
+
+                    NSMutableURLRequest *request = [self makeGETrequest:nextURL :YES];
+
+                    if (request)
+                    {
+                        Connexion *nextConnexion = [self launchConnection:request :kConnectTypeGetDeviceHistory :connexion.representedObject];
+                        nextConnexion.followers = connexion.followers;
+                        connexion.followers = nil;
+                        break;
+                    }
+                    else
+                    {
+                        errorMessage = @"Could not create a request to list all of a device's history — the list may be incomplete.";
+                        [self reportError];
+                    }
                 }
             }
 
+            NSArray *entries = [self mergeTimelineEntries:timeline :YES];
+            NSArray *merged = [timeline.history allObjects];
+
             NSDictionary *dict = connexion.representedObject != nil
-            ? @{ @"data" : history, @"object" : connexion.representedObject }
-            : @{ @"data" : history };
+            ? @{ @"data" : entries, @"timeline" : merged, @"device" : timeline.deviceID, @"object" : connexion.representedObject }
+            : @{ @"data" : entries, @"timeline" : merged, @"device" : timeline.deviceID };
 
-            [nc postNotificationName:@"BuildAPIGotHistory" object:dict];
+            [self relayResult:@"BuildAPIGotHistory" :dict];
+            [self notifyFollowers:connexion :@"BuildAPIGotHistory" :dict];
             break;
         }
 
@@ -4283,7 +8987,7 @@ didCompleteWithError:(NSError *)error
                 ? @{ @"action" : @"needotp", @"token" : loginToken, @"object" : connexion.representedObject }
                 : @{ @"action" : @"needotp", @"token" : loginToken };
 
-                [nc postNotificationName:@"BuildAPINeedOTP" object:dict];
+                [self relayResult:@"BuildAPINeedOTP" :dict];
 
                 useTwoFactor = YES;
                 
@@ -4296,9 +9000,13 @@ didCompleteWithError:(NSError *)error
             token.refreshToken = [data valueForKey:@"refresh_token"];
             NSNumber *n = [data valueForKey:@"expires_in"];
             token.lifetime = n.integerValue;
+            token.hasExpiryTime = NO;
             isLoggedIn = YES;
             tokenConnexion = nil;
 
+            [self cacheTokenExpiry];
+            [self scheduleTokenRefresh];
+
             // TODO check that we actually have the data we require
 
 #ifdef DEBUG
@@ -4311,6 +9019,16 @@ didCompleteWithError:(NSError *)error
 
             impCloudCode = tempImpCloudCode;
 
+            // Discard the fleet mirror if it's another cloud's. If it was restored from a snapshot, check
+            // the account too: this is only known once retrieved, so do so without notifying the host
+
+            [self validateSnapshot];
+
+            if (snapshotAccount != nil)
+            {
+                [self performRequest:^(id someObject) { [self getMyAccount:someObject]; } :nil :nil];
+            }
+
             // Get user's account information before we do anything else
 
             // [self getMyAccount];
@@ -4324,7 +9042,7 @@ didCompleteWithError:(NSError *)error
             ? @{ @"action" : @"loggedin", @"object" : connexion.representedObject }
             : @{ @"action" : @"loggedin" };
 
-            [nc postNotificationName:@"BuildAPILoggedIn" object:dict];
+            [self relayResult:@"BuildAPILoggedIn" :dict];
             break;
         }
 
@@ -4336,15 +9054,21 @@ didCompleteWithError:(NSError *)error
             token.expiryDate = [data valueForKey:@"expires_at"];
             NSNumber *n = [data valueForKey:@"expires_in"];
             token.lifetime = n.integerValue;
+            token.hasExpiryTime = NO;
             tokenConnexion = nil;
 
+            [self cacheTokenExpiry];
+            [self scheduleTokenRefresh];
+            [self scheduleSnapshotSave];
+
 #ifdef DEBUG
     NSLog(@"Refreshed Token: %@", token.accessToken);
     NSLog(@"        Expires: %@", token.expiryDate);
 NSLog(@"   Expires in: %li", (long)token.lifetime);
 #endif
 
-            // Do we have any pending connections we need to process?
+            // Do we have any pending connections we need to process? There will only be
+            // some if the token actually expired before the new one was received
             // NOTE 'launchPendingConnections' returns immediately if there are no pending connections
 
             [self launchPendingConnections];
@@ -4365,6 +9089,8 @@ NSLog(@"   Expires in: %li", (long)token.lifetime);
             token.account = aid;
             currentAccount = aid;
 
+            [self validateSnapshot];
+
 #ifdef DEBUG
     NSLog(@"My Account ID: %@", [me objectForKey:@"id"]);
 #endif
@@ -4373,7 +9099,7 @@ NSLog(@"   Expires in: %li", (long)token.lifetime);
             ? @{ @"account" : data, @"object" : connexion.representedObject }
             : @{ @"account" : data };
 
-            [nc postNotificationName:@"BuildAPIGotMyAccount" object:dict];
+            [self relayResult:@"BuildAPIGotMyAccount" :dict];
 
             break;
         }
@@ -4389,7 +9115,7 @@ NSLog(@"   Expires in: %li", (long)token.lifetime);
             ? @{ @"account" : data, @"object" : connexion.representedObject }
             : @{ @"account" : data };
 
-            [nc postNotificationName:@"BuildAPIGotAnAccount" object:dict];
+            [self relayResult:@"BuildAPIGotAnAccount" :dict];
 
             break;
         }
@@ -4399,20 +9125,25 @@ NSLog(@"   Expires in: %li", (long)token.lifetime);
             // We've got the stream ID and URL so we are ready to activate the log stream
             // NOTE no devices have yet been subscribed - this happens after connection
 
+            LogStream *stream = [connexion.representedObject objectForKey:@"stream"];
+
+            // Has the stream been abandoned in the meantime? Then there's nothing to do
+
+            if (stream == nil || ![logStreams containsObject:stream]) break;
+
             data = [data objectForKey:@"data"];
-            logStreamID = [data objectForKey:@"id"];
+            stream.streamID = [data objectForKey:@"id"];
 
             NSDictionary *attributes = [data objectForKey:@"attributes"];
-            logStreamURL = [NSURL URLWithString:[attributes objectForKey:@"url"]];
+            stream.url = [NSURL URLWithString:[attributes objectForKey:@"url"]];
 
 #ifdef DEBUG
-            NSLog(@"Log Stream URL received: %@", logStreamURL);
+            NSLog(@"Log Stream URL received: %@", stream.url);
 #endif
 
             // Now set up the log stream, ie. open it (have to do this before adding devices
 
-            savedObject = connexion.representedObject;
-            [self startStream];
+            [self startStream:stream];
 
             break;
         }
@@ -4431,6 +9162,10 @@ NSLog(@"   Expires in: %li", (long)token.lifetime);
                 id source = [connexion.representedObject objectForKey:@"object"];
                 NSString *devid = [connexion.representedObject objectForKey:@"device"];
 
+                // Devices re-added to a restarted stream are already on the list
+
+                if ([loggingDevices containsObject:devid]) break;
+
                 NSDictionary *dict = source != nil
                 ? @{ @"device" : devid, @"object" : source }
                 : @{ @"device" : devid };
@@ -4439,7 +9174,7 @@ NSLog(@"   Expires in: %li", (long)token.lifetime);
 
                 numberOfLogStreams = loggingDevices.count;
 
-                [nc postNotificationName:@"BuildAPIDeviceAddedToStream" object:dict];
+                [self relayResult:@"BuildAPIDeviceAddedToStream" :dict];
             }
 
             break;
@@ -4451,23 +9186,35 @@ NSLog(@"   Expires in: %li", (long)token.lifetime);
             {
                 id source = [connexion.representedObject objectForKey:@"object"];
                 NSString *devid = [connexion.representedObject objectForKey:@"device"];
+                LogStream *stream = [self logStreamForDevice:devid];
 
                 NSDictionary *dict = source != nil
                 ? @{ @"device" : devid, @"object" : source }
                 : @{ @"device" : devid };
 
                 [loggingDevices removeObject:devid];
+                [stream.devices removeObject:devid];
 
                 numberOfLogStreams = loggingDevices.count;
 
-                if (loggingDevices.count == 0) [self closeStream];
+                // Close the device's stream if it no longer has any devices
 
-                [nc postNotificationName:@"BuildAPIDeviceRemovedFromStream" object:dict];
+                if (stream != nil && stream.devices.count == 0) [self closeStream:stream];
+
+                [self relayResult:@"BuildAPIDeviceRemovedFromStream" :dict];
             }
 
             break;
         }
 
+        case kConnectTypeBulkOperation:
+        {
+            // One of a bulk operation's requests has succeeded
+
+            [self bulkChunkComplete:connexion :YES];
+            break;
+        }
+
         case kConnectTypeGetLoginToken:
         {
             // The server returns the requested access token directly
@@ -4481,7 +9228,7 @@ NSLog(@"   Expires in: %li", (long)token.lifetime);
             
             // Pass the loginKey to the host app
             
-            [nc postNotificationName:@"BuildAPILoginKey" object:data];
+            [self relayResult:@"BuildAPILoginKey" :data];
             
             break;
         }
@@ -4503,7 +9250,9 @@ NSLog(@"   Expires in: %li", (long)token.lifetime);
 
                 if (request)
                 {
-                    [self launchConnection:request :kConnectTypeGetLibraries :nil];
+                    Connexion *nextConnexion = [self launchConnection:request :kConnectTypeGetLibraries :nil];
+                    nextConnexion.followers = connexion.followers;
+                    connexion.followers = nil;
                     break;
                 }
                 else
@@ -4513,9 +9262,10 @@ NSLog(@"   Expires in: %li", (long)token.lifetime);
                 }
             }
 
-            returnData = @{ @"data" : eiLibs };
+            returnData = @{ @"data" : [NSArray arrayWithArray:eiLibs] };
 
-            [nc postNotificationName:@"BuildAPIGotLibrariesList" object:returnData];
+            [self relayResult:@"BuildAPIGotLibrariesList" :returnData];
+            [self notifyFollowers:connexion :@"BuildAPIGotLibrariesList" :returnData];
             break;
         }
     }
@@ -4568,6 +9318,10 @@ NSLog(@"   Expires in: %li", (long)token.lifetime);
     NSDictionary *error = @{ @"message" : message,
                              @"code" : [NSNumber numberWithInteger:errCode] };
 
+    // Keep the error for the completion handlers of any requests that have failed because of it
+
+    lastError = error;
+
     [[NSNotificationCenter defaultCenter] postNotificationName:@"BuildAPIError" object:error];
 }
 
@@ -41,6 +41,7 @@
 #define kConnectTypeUpdateProduct               12
 #define kConnectTypeDeleteProduct               13
 #define kConnectTypeGetProduct                  14
+#define kConnectTypeSyncProducts                15
 
 #define kConnectTypeGetDeviceGroups             20
 #define kConnectTypeCreateDeviceGroup           21
@@ -48,6 +49,7 @@
 #define kConnectTypeDeleteDeviceGroup           23
 #define kConnectTypeGetDeviceGroup              24
 #define kConnectTypeRestartDevices              25
+#define kConnectTypeSyncDeviceGroups            26
 
 #define kConnectTypeGetDeployments              30
 #define kConnectTypeCreateDeployment            31
@@ -67,6 +69,8 @@
 #define kConnectTypeGetDevice                   48
 #define kConnectTypeGetDeviceLogs               49
 #define kConnectTypeGetDeviceHistory            50
+#define kConnectTypeBulkOperation               51
+#define kConnectTypeSyncDevices                 52
 
 #define kConnectTypeGetWebhooks                 60
 #define kConnectTypeCreateWebhook               61
@@ -102,15 +106,35 @@
 #define kLogTimeout                             300.0
 #define klogRetryInterval                       10.0
 #define kLogMaxDevicesPerLog                    8
+#define kLogMaxStreams                          32
+#define kLogMaxReconnectAttempts                3
+#define kLogBatchIntervalDefault                0.0
+#define kLogBatchSizeDefault                    100
+#define kLogQueueLimitDefault                   5000
+#define kLogOverflowPolicyDrop                  0
+#define kLogOverflowPolicyBlock                 1
+
+// Bulk Device Operations
+
+#define kBulkOperationAssign                    0
+#define kBulkOperationUnassign                  1
+#define kBulkOperationRestart                   2
+#define kBulkOperationRename                    3
+#define kBulkOperationDelete                    4
+#define kBulkChunkMax                           100
+#define kBulkConcurrency                        4
 
 // Pagination
 
 #define kPaginationDefault                      20
+#define kPagePrefetchDefault                    0
+#define kPagePrefetchMax                        16
 
 // Errors
 
 #define kErrorNoError                           0
 #define kErrorNetworkError                      1
+#define kErrorRequestCancelled                  2
 
 #define kErrorLoginSuccess                      10
 #define kErrorLoginNoUsername                   11
@@ -120,6 +144,84 @@
 
 #define kConnectTimeoutInterval                 120
 
+// Request Scheduling
+
+#define kConnectPriorityInteractive             0
+#define kConnectPriorityBulk                    1
+#define kConnectPriorityBackground              2
+#define kConnectPriorityClasses                 3
+#define kConnectConcurrentDefault               6
+#define kConnectQueueMaxDefault                 0
+#define kRateLimitWindowDefault                 1.0
+#define kRateLimitRetryDefault                  1.0
+
+// Retries and Hedged Reads
+
+#define kRetryMaxDefault                        3
+#define kRetryDelayBase                         0.25
+#define kRetryDelayMax                          8.0
+#define kRetryBudgetRatio                       0.1
+#define kRetryBudgetMax                         10.0
+#define kHedgePercentileDefault                 0.95
+#define kHedgeHistorySize                       100
+#define kHedgeMinimumSamples                    20
+#define kHedgeMinimumDelay                      0.05
+
+// Session Pool
+
+#define kSessionPoolConnectionsPerHost          16
+
+// Access Token Refresh
+
+#define kTokenRefreshLead                       240.0
+#define kTokenExpiryMargin                      10.0
+#define kTokenRefreshRetry                      30.0
+
+// Response Cache
+
+#define kResponseCacheMaxEntries                256
+#define kResponseCacheLifetimeDefault           0.0
+
+// Metrics
+
+#define kMetricsHistogramBuckets                16
+#define kMetricsExportIntervalDefault           0.0
+
+// Fleet Mirror
+
+#define kFleetMirrorTypeProduct                 @"product"
+#define kFleetMirrorTypeDevicegroup             @"devicegroup"
+#define kFleetMirrorTypeDevice                  @"device"
+#define kFleetMirrorTypeDeployment              @"deployment"
+#define kFleetMirrorSyncIntervalDefault         0.0
+
+// Snapshot
+
+#define kSnapshotVersion                        1
+#define kSnapshotSaveDelay                      2.0
+
+// Device Timelines
+
+#define kTimelineCapacityDefault                1000
+
+// Compact Records
+
+#define kCompactRecordInternLength              40
+
+// Rollout Steps
+
+#define kRolloutStepCreateDeployment            0
+#define kRolloutStepSetMinDeployment            1
+#define kRolloutStepUpdateDevicegroup           2
+#define kRolloutStepRestartDevices              3
+#define kRolloutStepConditionalRestartDevices   4
+
+#define kRolloutStepStatePending                0
+#define kRolloutStepStateRunning                1
+#define kRolloutStepStateSucceeded              2
+#define kRolloutStepStateFailed                 3
+#define kRolloutStepStateSkipped                4
+
 
 #endif
 
@@ -135,6 +237,13 @@
 #define kLogStreamEventSeparatorCRCR            @"\r\r"
 #define kLogStreamEventSeparatorCRLFCRLF        @"\r\n\r\n"
 #define kLogStreamEventKeyValuePairSeparator    @"\n"
+#define kLogStreamParserCompactSize             4096
+
+// JSON List Parser Phases
+
+#define kJSONListPhaseEnvelope                  0
+#define kJSONListPhaseArray                     1
+#define kJSONListPhaseElement                   2
 
 // Event keys
 
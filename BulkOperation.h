@@ -0,0 +1,53 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import <Foundation/Foundation.h>
+
+
+@interface BulkOperation : NSObject
+
+
+// Required by BuildAPI access class
+// BulkOperation is simply a packaging object for the progress and the
+// per-device outcomes of an operation applied to many devices
+
+// Methods
+
+- (instancetype)init;
+
+// Properties
+
+@property (nonatomic, strong) NSMutableArray      *chunks;            // Requests yet to be made, each a dictionary
+@property (nonatomic, strong) NSMutableArray      *succeeded;         // IDs of the devices successfully processed
+@property (nonatomic, strong) NSMutableDictionary *failed;            // Error messages, keyed by device ID
+@property (nonatomic, strong) id                  representedObject;
+@property (nonatomic, assign) NSInteger           operation;
+@property (nonatomic, assign) NSUInteger          total;              // Number of devices to be processed
+@property (nonatomic, assign) NSInteger           chunksOutstanding;  // Requests made but not yet completed
+@property (nonatomic, assign) BOOL                isComplete;
+
+
+@end
@@ -0,0 +1,53 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import <Foundation/Foundation.h>
+
+
+@interface CompactRecord : NSDictionary
+
+
+// Required by BuildAPI access class
+// CompactRecord holds a product, device group, device or deployment record in a fraction
+// of the memory of the JSON:API dictionary tree it was decoded from. It keeps only the
+// record's ID, type, attributes and relationships - not its 'links' - and its strings are
+// shared with every other record decoded by the same CompactRecordDecoder. It is an
+// immutable NSDictionary, so it can be read exactly as the original record is read
+
+// Methods
+
+- (instancetype)init;
+- (NSString *)name;
+
+// Properties
+
+@property (nonatomic, strong) NSString       *recordID;
+@property (nonatomic, strong) NSString       *type;
+@property (nonatomic, strong) NSDictionary   *attributes;
+@property (nonatomic, strong) NSDictionary   *relationships;      // Values are shared { id, type } references
+
+
+@end
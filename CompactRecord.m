@@ -0,0 +1,118 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import "CompactRecord.h"
+
+
+@implementation CompactRecord
+
+
+@synthesize recordID, type, attributes, relationships;
+
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        recordID = nil;
+        type = nil;
+        attributes = nil;
+        relationships = nil;
+    }
+
+    return self;
+}
+
+
+
+- (instancetype)initWithObjects:(const id [])objects forKeys:(const id <NSCopying> [])keys count:(NSUInteger)count
+{
+    // NSDictionary's designated initializer, used when a record is built from keys and values, eg. by a copy
+
+    if (self = [self init])
+    {
+        for (NSUInteger i = 0 ; i < count ; ++i)
+        {
+            id key = keys[i];
+
+            if ([key isEqual:@"id"]) recordID = objects[i];
+            if ([key isEqual:@"type"]) type = objects[i];
+            if ([key isEqual:@"attributes"]) attributes = objects[i];
+            if ([key isEqual:@"relationships"]) relationships = objects[i];
+        }
+    }
+
+    return self;
+}
+
+
+
+- (NSString *)name
+{
+    NSString *name = [attributes objectForKey:@"name"];
+
+    return [name isKindOfClass:[NSString class]] ? name : nil;
+}
+
+
+
+#pragma mark - NSDictionary Primitive Methods
+
+
+- (NSUInteger)count
+{
+    return (recordID != nil ? 1 : 0) + (type != nil ? 1 : 0) + (attributes != nil ? 1 : 0) + (relationships != nil ? 1 : 0);
+}
+
+
+
+- (id)objectForKey:(id)aKey
+{
+    if (![aKey isKindOfClass:[NSString class]]) return nil;
+
+    if ([aKey isEqualToString:@"id"]) return recordID;
+    if ([aKey isEqualToString:@"type"]) return type;
+    if ([aKey isEqualToString:@"attributes"]) return attributes;
+    if ([aKey isEqualToString:@"relationships"]) return relationships;
+    return nil;
+}
+
+
+
+- (NSEnumerator *)keyEnumerator
+{
+    NSMutableArray *keys = [[NSMutableArray alloc] initWithCapacity:4];
+
+    if (recordID != nil) [keys addObject:@"id"];
+    if (type != nil) [keys addObject:@"type"];
+    if (attributes != nil) [keys addObject:@"attributes"];
+    if (relationships != nil) [keys addObject:@"relationships"];
+
+    return [keys objectEnumerator];
+}
+
+
+@end
@@ -0,0 +1,62 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import <Foundation/Foundation.h>
+#import "BuildAPIAccessConstants.h"
+#import "CompactRecord.h"
+
+
+@interface CompactRecordDecoder : NSObject
+
+{
+    NSMutableDictionary *strings, *references;
+}
+
+
+// Required by BuildAPI access class
+// CompactRecordDecoder converts JSON:API records to CompactRecords. Every record it decodes
+// shares a single copy of each key, type and short string value, and a single { id, type }
+// reference for each related record, eg. the device group to which thousands of devices belong.
+// Record IDs are not shared. The host clears the tables once each list has been decoded.
+// If a record type's fields are specified, any other attributes and relationships are dropped.
+// It is only used on the processing queue
+
+// Methods
+
+- (instancetype)init;
+- (id)decodeRecord:(id)record :(NSSet *)fields;
+- (NSArray *)decodeRecords:(NSArray *)records :(NSSet *)fields;
+- (id)internValue:(id)value;
+- (NSString *)internString:(NSString *)string;
+- (NSDictionary *)internReference:(NSDictionary *)reference;
+- (void)clear;
+
+// Properties
+
+@property (nonatomic, readonly) NSUInteger count;               // Number of shared strings and references
+
+
+@end
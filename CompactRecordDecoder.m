@@ -0,0 +1,190 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import "CompactRecordDecoder.h"
+
+
+@implementation CompactRecordDecoder
+
+
+@dynamic count;
+
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        strings = [[NSMutableDictionary alloc] init];
+        references = [[NSMutableDictionary alloc] init];
+    }
+
+    return self;
+}
+
+
+
+- (id)decodeRecord:(id)record :(NSSet *)fields
+{
+    // Convert a JSON:API record to a CompactRecord
+    // PARAMETERS:
+    //   'record' is the record as decoded from JSON
+    //   'fields' is the set of the names of the attributes and relationships to keep, or nil to keep them all
+    // RETURNS:
+    //   The CompactRecord, or 'record' itself if it is already compact or is not a JSON:API record
+
+    if ([record isKindOfClass:[CompactRecord class]] || ![record isKindOfClass:[NSDictionary class]]) return record;
+
+    NSString *recordID = [record objectForKey:@"id"];
+    NSString *type = [record objectForKey:@"type"];
+
+    if (![recordID isKindOfClass:[NSString class]] || ![type isKindOfClass:[NSString class]]) return record;
+
+    CompactRecord *compact = [[CompactRecord alloc] init];
+    compact.recordID = [recordID copy];
+    compact.type = [self internString:type];
+
+    NSDictionary *attributes = [record objectForKey:@"attributes"];
+
+    if ([attributes isKindOfClass:[NSDictionary class]])
+    {
+        NSMutableDictionary *values = [[NSMutableDictionary alloc] initWithCapacity:(fields != nil ? fields.count : attributes.count)];
+
+        for (NSString *key in attributes)
+        {
+            if (fields != nil && ![fields containsObject:key]) continue;
+
+            id value = [attributes objectForKey:key];
+
+            if (value != [NSNull null]) [values setObject:[self internValue:value] forKey:[self internString:key]];
+        }
+
+        compact.attributes = [values copy];
+    }
+
+    NSDictionary *relationships = [record objectForKey:@"relationships"];
+
+    if ([relationships isKindOfClass:[NSDictionary class]])
+    {
+        NSMutableDictionary *related = [[NSMutableDictionary alloc] initWithCapacity:relationships.count];
+
+        for (NSString *key in relationships)
+        {
+            if (fields != nil && ![fields containsObject:key]) continue;
+
+            id value = [relationships objectForKey:key];
+            id reference = [self internReference:value];
+
+            // Keep any relationship which is not a single { id, type } reference, eg. a list, as it is
+
+            if (reference == nil && value != [NSNull null]) reference = value;
+            if (reference != nil) [related setObject:reference forKey:[self internString:key]];
+        }
+
+        compact.relationships = [related copy];
+    }
+
+    return compact;
+}
+
+
+
+- (NSArray *)decodeRecords:(NSArray *)records :(NSSet *)fields
+{
+    NSMutableArray *compacts = [[NSMutableArray alloc] initWithCapacity:records.count];
+
+    for (id record in records) [compacts addObject:[self decodeRecord:record :fields]];
+
+    return compacts;
+}
+
+
+
+- (id)internValue:(id)value
+{
+    // Share short string values, eg. a device group's type, which may appear in thousands of records.
+    // Longer strings, eg. descriptions, are rarely repeated, so they are not worth keeping a table entry for
+
+    if ([value isKindOfClass:[NSString class]] && [value length] <= kCompactRecordInternLength) return [self internString:value];
+    return value;
+}
+
+
+
+- (NSString *)internString:(NSString *)string
+{
+    // Share a string which is expected to recur, eg. a key or a record type. Record IDs are unique,
+    // so they are never interned: their table entries would outlive the only records that use them
+
+    NSString *shared = [strings objectForKey:string];
+
+    if (shared != nil) return shared;
+
+    shared = [string copy];
+    [strings setObject:shared forKey:shared];
+    return shared;
+}
+
+
+
+- (NSDictionary *)internReference:(NSDictionary *)reference
+{
+    // Return a single shared { id, type } dictionary for each related record, or nil if 'reference'
+    // is not such a dictionary
+
+    if (![reference isKindOfClass:[NSDictionary class]] || [reference count] != 2) return nil;
+
+    NSString *relatedID = [reference objectForKey:@"id"];
+    NSString *relatedType = [reference objectForKey:@"type"];
+
+    if (![relatedID isKindOfClass:[NSString class]] || ![relatedType isKindOfClass:[NSString class]]) return nil;
+
+    NSString *key = [NSString stringWithFormat:@"%@/%@", relatedType, relatedID];
+    NSDictionary *shared = [references objectForKey:key];
+
+    if (shared != nil) return shared;
+
+    shared = @{ @"id" : [relatedID copy], @"type" : [self internString:relatedType] };
+    [references setObject:shared forKey:key];
+    return shared;
+}
+
+
+
+- (void)clear
+{
+    [strings removeAllObjects];
+    [references removeAllObjects];
+}
+
+
+
+- (NSUInteger)count
+{
+    return strings.count + references.count;
+}
+
+
+@end
@@ -25,6 +25,10 @@
 
 
 #import <Foundation/Foundation.h>
+#import "PagedList.h"
+#import "LogStreamParser.h"
+#import "CachedResponse.h"
+#import "JSONListParser.h"
 
 
 @interface Connexion : NSObject
@@ -44,8 +48,30 @@
 @property (nonatomic, strong) NSURLSessionTask    *task;
 @property (nonatomic, strong) NSMutableData       *data;
 @property (nonatomic, strong) NSMutableURLRequest *originalRequest;
+@property (nonatomic, strong) PagedList           *pagedList;
+@property (nonatomic, strong) LogStreamParser     *streamParser;
+@property (nonatomic, strong) JSONListParser      *listParser;
+@property (nonatomic, strong) CachedResponse      *cachedResponse;
+@property (nonatomic, strong) NSMutableArray      *followers;          // Connexions sharing this one's result
+@property (nonatomic, strong) NSString            *coalesceKey;
+@property (nonatomic, strong) Connexion           *hedge;              // The other read of a hedged pair
+@property (nonatomic, strong) dispatch_source_t   hedgeTimer;
 @property (nonatomic, assign) NSInteger           actionCode;
 @property (nonatomic, assign) NSInteger           errorCode;
+@property (nonatomic, assign) NSInteger           taskIdentifier;
+@property (nonatomic, assign) NSInteger           pageNumber;
+@property (nonatomic, assign) NSInteger           priority;
+@property (nonatomic, assign) NSUInteger          cacheGeneration;
+@property (nonatomic, assign) NSInteger           initialActionCode;   // 'actionCode' as launched, for metrics
+@property (nonatomic, assign) NSInteger           retryCount;          // Times re-sent after a transient failure
+@property (nonatomic, assign) NSUInteger          bytesReceived;
+@property (nonatomic, assign) NSTimeInterval      queuedTime;          // Metrics timestamps (system uptime)
+@property (nonatomic, assign) NSTimeInterval      startTime;
+@property (nonatomic, assign) NSTimeInterval      firstByteTime;
+@property (nonatomic, assign) NSTimeInterval      decodeTime;          // Time spent decoding the response
+@property (nonatomic, assign) NSTimeInterval      sentTime;            // When the task was started (system uptime)
+@property (nonatomic, assign) BOOL                isPartialList;       // Whether pages of the list could not be retrieved
+@property (nonatomic, assign) BOOL                isHedge;             // Whether this is the second read of a hedged pair
 
 
 @end
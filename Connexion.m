@@ -30,7 +30,11 @@
 @implementation Connexion
 
 
-@synthesize actionCode, data, errorCode, task, representedObject, originalRequest;
+@synthesize actionCode, data, errorCode, task, representedObject, originalRequest, taskIdentifier;
+@synthesize pagedList, pageNumber, streamParser, priority, cachedResponse, cacheGeneration;
+@synthesize followers, coalesceKey, listParser, isPartialList;
+@synthesize hedge, hedgeTimer, retryCount, sentTime, isHedge;
+@synthesize initialActionCode, bytesReceived, queuedTime, startTime, firstByteTime, decodeTime;
 
 
 - (instancetype)init
@@ -41,8 +45,30 @@
         data = nil;
         representedObject = nil;
         originalRequest = nil;
+        pagedList = nil;
+        streamParser = nil;
+        cachedResponse = nil;
+        followers = nil;
+        coalesceKey = nil;
+        listParser = nil;
+        isPartialList = NO;
+        hedge = nil;
+        hedgeTimer = nil;
+        isHedge = NO;
+        pageNumber = 0;
         actionCode = -1;
         errorCode = -1;
+        taskIdentifier = -1;
+        priority = -1;
+        cacheGeneration = 0;
+        initialActionCode = -1;
+        retryCount = 0;
+        bytesReceived = 0;
+        queuedTime = 0;
+        startTime = 0;
+        firstByteTime = 0;
+        decodeTime = 0;
+        sentTime = 0;
     }
 
     return self;
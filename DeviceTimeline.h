@@ -0,0 +1,55 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import <Foundation/Foundation.h>
+#import "RingBuffer.h"
+
+
+@interface DeviceTimeline : NSObject
+
+
+// Required by BuildAPI access class
+// DeviceTimeline is simply a packaging object for a device's most recent log and
+// history entries, and the cursors which mark the newest entries retrieved so far
+
+// Methods
+
+- (instancetype)init;
+
+// Properties
+
+@property (nonatomic, strong) NSString       *deviceID;
+@property (nonatomic, strong) RingBuffer     *logs;               // Log entries, oldest first, historical and streamed
+@property (nonatomic, strong) RingBuffer     *history;            // History entries, oldest first
+@property (nonatomic, strong) NSString       *logCursor;          // Timestamp of the newest log entry retrieved
+@property (nonatomic, strong) NSString       *historyCursor;      // Timestamp of the newest history entry retrieved
+@property (nonatomic, strong) NSSet          *logCursorKeys;      // Keys of the entries at the cursors' timestamps,
+@property (nonatomic, strong) NSSet          *historyCursorKeys;  // as several entries can share a timestamp
+@property (nonatomic, strong) NSMutableArray *pendingLogs;        // Entries received by a retrieval in progress
+@property (nonatomic, strong) NSMutableArray *pendingHistory;
+
+
+@end
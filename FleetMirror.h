@@ -0,0 +1,65 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import <Foundation/Foundation.h>
+#import "BuildAPIAccessConstants.h"
+
+
+@interface FleetMirror : NSObject
+
+{
+    NSMutableDictionary *recordsByType, *childrenByType;
+}
+
+
+// Required by BuildAPI access class
+// FleetMirror holds the most recently retrieved record of every product, device group,
+// device and deployment, keyed by type and ID, and indexes each record under its parent:
+// a device under its device group, a device group under its product, and a deployment
+// under its device group. Records are only read and written on the processing queue
+
+// Methods
+
+- (instancetype)init;
+- (NSDictionary *)updateRecords:(NSArray *)records :(NSString *)type :(BOOL)isComplete;
+- (BOOL)addRecord:(NSDictionary *)record;
+- (BOOL)removeRecord:(NSString *)recordID :(NSString *)type;
+- (NSArray *)moveDevices:(NSArray *)deviceIDs :(NSString *)devicegroupID;
+- (NSDictionary *)record:(NSString *)recordID :(NSString *)type;
+- (NSArray *)records:(NSString *)type;
+- (NSArray *)children:(NSString *)parentID :(NSString *)type;
+- (NSString *)typeOfRecord:(NSDictionary *)record;
+- (NSString *)parentOfRecord:(NSDictionary *)record;
+- (void)indexRecord:(NSDictionary *)record :(NSString *)type;
+- (void)unindexRecord:(NSDictionary *)record :(NSString *)type;
+- (void)clear;
+
+// Properties
+
+@property (nonatomic, readonly) NSUInteger count;               // Number of records of all types
+
+
+@end
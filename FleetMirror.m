@@ -0,0 +1,363 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import "FleetMirror.h"
+
+
+@implementation FleetMirror
+
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        recordsByType = [[NSMutableDictionary alloc] init];
+        childrenByType = [[NSMutableDictionary alloc] init];
+    }
+
+    return self;
+}
+
+
+
+- (NSDictionary *)updateRecords:(NSArray *)records :(NSString *)type :(BOOL)isComplete
+{
+    // Bring the mirror's records of one type into line with a freshly retrieved list of them
+    // PARAMETERS:
+    //   'records' is the list of records retrieved from the server
+    //   'type' is the records' type, eg. kFleetMirrorTypeDevice
+    //   'isComplete' is YES if the list holds every record of the type, ie. it was not filtered
+    //                or truncated, so that mirrored records missing from it can be removed
+    // RETURNS:
+    //   A dictionary of the IDs of the records added, updated and removed, or nil if nothing changed
+
+    if (type == nil) return nil;
+
+    NSMutableArray *added = [[NSMutableArray alloc] init];
+    NSMutableArray *updated = [[NSMutableArray alloc] init];
+    NSMutableArray *removed = [[NSMutableArray alloc] init];
+    NSMutableSet *listed = [[NSMutableSet alloc] initWithCapacity:records.count];
+    NSDictionary *existing = [recordsByType objectForKey:type];
+
+    for (NSDictionary *record in records)
+    {
+        if (![record isKindOfClass:[NSDictionary class]]) continue;
+
+        NSString *recordID = [record objectForKey:@"id"];
+
+        if (recordID == nil || ![[self typeOfRecord:record] isEqualToString:type]) continue;
+
+        [listed addObject:recordID];
+
+        BOOL isNew = ([existing objectForKey:recordID] == nil);
+
+        if ([self addRecord:record]) [(isNew ? added : updated) addObject:recordID];
+    }
+
+    if (isComplete)
+    {
+        for (NSString *recordID in [existing allKeys])
+        {
+            if (![listed containsObject:recordID] && [self removeRecord:recordID :type]) [removed addObject:recordID];
+        }
+    }
+
+    if (added.count + updated.count + removed.count == 0) return nil;
+
+    return @{ @"type" : type,
+              @"added" : added,
+              @"updated" : updated,
+              @"removed" : removed };
+}
+
+
+
+- (BOOL)addRecord:(NSDictionary *)record
+{
+    // Add a record to the mirror, replacing any earlier version of it
+    // RETURNS:
+    //   YES if the mirror has changed, ie. the record is new or differs from the mirrored version
+
+    NSString *type = [self typeOfRecord:record];
+    NSString *recordID = [record objectForKey:@"id"];
+
+    if (type == nil || ![recordID isKindOfClass:[NSString class]]) return NO;
+
+    NSMutableDictionary *records = [recordsByType objectForKey:type];
+
+    if (records == nil)
+    {
+        records = [[NSMutableDictionary alloc] init];
+        [recordsByType setObject:records forKey:type];
+    }
+
+    NSDictionary *oldRecord = [records objectForKey:recordID];
+
+    if (oldRecord != nil)
+    {
+        if ([oldRecord isEqualToDictionary:record]) return NO;
+
+        [self unindexRecord:oldRecord :type];
+    }
+
+    [records setObject:record forKey:recordID];
+    [self indexRecord:record :type];
+    return YES;
+}
+
+
+
+- (BOOL)removeRecord:(NSString *)recordID :(NSString *)type
+{
+    // Remove a record from the mirror
+    // RETURNS:
+    //   YES if the record was mirrored, otherwise NO
+
+    if (recordID == nil || type == nil) return NO;
+
+    NSMutableDictionary *records = [recordsByType objectForKey:type];
+    NSDictionary *record = [records objectForKey:recordID];
+
+    if (record == nil) return NO;
+
+    [self unindexRecord:record :type];
+    [records removeObjectForKey:recordID];
+    return YES;
+}
+
+
+
+- (NSArray *)moveDevices:(NSArray *)deviceIDs :(NSString *)devicegroupID
+{
+    // Record that devices have been assigned to a device group, or unassigned if 'devicegroupID' is nil,
+    // by updating the 'devicegroup' relationship of the mirrored records of those devices
+    // RETURNS:
+    //   The IDs of the mirrored devices which have changed
+
+    NSMutableArray *moved = [[NSMutableArray alloc] init];
+    NSDictionary *devicegroup = [self record:devicegroupID :kFleetMirrorTypeDevicegroup];
+    NSString *groupType = devicegroup != nil ? [devicegroup objectForKey:@"type"] : kFleetMirrorTypeDevicegroup;
+
+    for (NSString *deviceID in deviceIDs)
+    {
+        NSDictionary *device = [self record:deviceID :kFleetMirrorTypeDevice];
+
+        if (device == nil) continue;
+
+        NSMutableDictionary *newDevice = [NSMutableDictionary dictionaryWithDictionary:device];
+        NSDictionary *relationships = [device objectForKey:@"relationships"];
+        NSMutableDictionary *newRelationships = [relationships isKindOfClass:[NSDictionary class]]
+        ? [NSMutableDictionary dictionaryWithDictionary:relationships]
+        : [[NSMutableDictionary alloc] init];
+
+        if (devicegroupID != nil)
+        {
+            [newRelationships setObject:@{ @"type" : groupType, @"id" : devicegroupID } forKey:@"devicegroup"];
+        }
+        else
+        {
+            [newRelationships removeObjectForKey:@"devicegroup"];
+        }
+
+        [newDevice setObject:newRelationships forKey:@"relationships"];
+
+        if ([self addRecord:newDevice]) [moved addObject:deviceID];
+    }
+
+    return moved;
+}
+
+
+
+- (NSDictionary *)record:(NSString *)recordID :(NSString *)type
+{
+    // Returns the mirrored record of the specified type and ID, or nil if there is none
+
+    if (recordID == nil || type == nil) return nil;
+
+    return [[recordsByType objectForKey:type] objectForKey:recordID];
+}
+
+
+
+- (NSArray *)records:(NSString *)type
+{
+    // Returns all of the mirrored records of the specified type
+
+    NSDictionary *records = [recordsByType objectForKey:type];
+
+    return records != nil ? [records allValues] : @[];
+}
+
+
+
+- (NSArray *)children:(NSString *)parentID :(NSString *)type
+{
+    // Returns the mirrored records of the specified type which belong to the specified parent,
+    // eg. the devices in a device group. If 'parentID' is nil, returns the records with no parent,
+    // eg. the unassigned devices
+
+    NSSet *childIDs = [[childrenByType objectForKey:type] objectForKey:(parentID != nil ? parentID : [NSNull null])];
+
+    if (childIDs == nil) return @[];
+
+    NSDictionary *records = [recordsByType objectForKey:type];
+    NSMutableArray *children = [[NSMutableArray alloc] initWithCapacity:childIDs.count];
+
+    for (NSString *childID in childIDs)
+    {
+        NSDictionary *child = [records objectForKey:childID];
+        if (child != nil) [children addObject:child];
+    }
+
+    return children;
+}
+
+
+
+- (NSString *)typeOfRecord:(NSDictionary *)record
+{
+    // Returns the mirror type of the specified record, or nil if it is not of a mirrored type.
+    // Device groups have several API types, eg. 'development_devicegroup', all mirrored as one
+
+    if (![record isKindOfClass:[NSDictionary class]]) return nil;
+
+    NSString *type = [record objectForKey:@"type"];
+
+    if (![type isKindOfClass:[NSString class]]) return nil;
+    if ([type hasSuffix:kFleetMirrorTypeDevicegroup]) return kFleetMirrorTypeDevicegroup;
+    if ([type isEqualToString:kFleetMirrorTypeProduct]) return kFleetMirrorTypeProduct;
+    if ([type isEqualToString:kFleetMirrorTypeDevice]) return kFleetMirrorTypeDevice;
+    if ([type isEqualToString:kFleetMirrorTypeDeployment]) return kFleetMirrorTypeDeployment;
+
+    return nil;
+}
+
+
+
+- (NSString *)parentOfRecord:(NSDictionary *)record
+{
+    // Returns the ID of the record's parent, read from its relationships, or nil if it has none
+
+    NSString *type = [self typeOfRecord:record];
+    NSString *key = nil;
+
+    if ([type isEqualToString:kFleetMirrorTypeDevicegroup])
+    {
+        key = @"product";
+    }
+    else if ([type isEqualToString:kFleetMirrorTypeDevice] || [type isEqualToString:kFleetMirrorTypeDeployment])
+    {
+        key = @"devicegroup";
+    }
+
+    if (key == nil) return nil;
+
+    NSDictionary *relationships = [record objectForKey:@"relationships"];
+
+    if (![relationships isKindOfClass:[NSDictionary class]]) return nil;
+
+    NSDictionary *parent = [relationships objectForKey:key];
+
+    if (![parent isKindOfClass:[NSDictionary class]]) return nil;
+
+    NSString *parentID = [parent objectForKey:@"id"];
+
+    return [parentID isKindOfClass:[NSString class]] ? parentID : nil;
+}
+
+
+
+- (void)indexRecord:(NSDictionary *)record :(NSString *)type
+{
+    // Add a record to its parent's index. Products have no parent so are not indexed
+
+    if ([type isEqualToString:kFleetMirrorTypeProduct]) return;
+
+    NSMutableDictionary *children = [childrenByType objectForKey:type];
+
+    if (children == nil)
+    {
+        children = [[NSMutableDictionary alloc] init];
+        [childrenByType setObject:children forKey:type];
+    }
+
+    NSString *parentID = [self parentOfRecord:record];
+    id key = parentID != nil ? parentID : [NSNull null];
+    NSMutableSet *childIDs = [children objectForKey:key];
+
+    if (childIDs == nil)
+    {
+        childIDs = [[NSMutableSet alloc] init];
+        [children setObject:childIDs forKey:key];
+    }
+
+    [childIDs addObject:[record objectForKey:@"id"]];
+}
+
+
+
+- (void)unindexRecord:(NSDictionary *)record :(NSString *)type
+{
+    // Remove a record from its parent's index
+
+    NSMutableDictionary *children = [childrenByType objectForKey:type];
+
+    if (children == nil) return;
+
+    NSString *parentID = [self parentOfRecord:record];
+    id key = parentID != nil ? parentID : [NSNull null];
+    NSMutableSet *childIDs = [children objectForKey:key];
+
+    [childIDs removeObject:[record objectForKey:@"id"]];
+
+    if (childIDs != nil && childIDs.count == 0) [children removeObjectForKey:key];
+}
+
+
+
+- (void)clear
+{
+    // Remove every record from the mirror
+
+    [recordsByType removeAllObjects];
+    [childrenByType removeAllObjects];
+}
+
+
+
+- (NSUInteger)count
+{
+    NSUInteger count = 0;
+
+    for (NSString *type in recordsByType) count += [[recordsByType objectForKey:type] count];
+
+    return count;
+}
+
+
+
+@end
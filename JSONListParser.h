@@ -0,0 +1,66 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import <Foundation/Foundation.h>
+#import "BuildAPIAccessConstants.h"
+#import "CompactRecordDecoder.h"
+
+
+@interface JSONListParser : NSObject
+
+{
+    NSMutableData *envelope, *element, *key;
+
+    NSMutableArray *items;
+
+    NSInteger depth, phase;
+
+    BOOL inString, escaped, expectKey, keyIsData, valueIsData, foundList;
+}
+
+
+// Required by BuildAPI access class
+// JSONListParser incrementally decodes the JSON:API 'data' array of a list response as
+// its bytes arrive. Each element is decoded as soon as it is complete and its bytes are
+// discarded; everything outside the array (eg. 'links') is kept and decoded at the end.
+// If it has a record decoder, each element is converted to a CompactRecord as it is decoded
+
+// Methods
+
+- (instancetype)init;
+- (BOOL)parseData:(NSData *)data;
+- (void)decodeElement;
+- (NSDictionary *)result;
+
+// Properties
+
+@property (nonatomic, readonly) NSUInteger      count;           // Number of elements decoded so far
+@property (nonatomic, readonly) NSError         *error;          // Set if the response could not be decoded
+@property (nonatomic, strong) CompactRecordDecoder *decoder;     // Optional
+@property (nonatomic, strong) NSSet             *fields;         // Fields kept by the decoder, or nil for all
+
+
+@end
@@ -0,0 +1,325 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import "JSONListParser.h"
+
+
+@implementation JSONListParser
+
+
+@synthesize error, decoder, fields;
+
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        envelope = [[NSMutableData alloc] init];
+        element = [[NSMutableData alloc] init];
+        key = [[NSMutableData alloc] init];
+        items = [[NSMutableArray alloc] init];
+        depth = 0;
+        phase = kJSONListPhaseEnvelope;
+        inString = NO;
+        escaped = NO;
+        expectKey = NO;
+        keyIsData = NO;
+        valueIsData = NO;
+        foundList = NO;
+        error = nil;
+        decoder = nil;
+        fields = nil;
+    }
+
+    return self;
+}
+
+
+
+- (BOOL)parseData:(NSData *)data
+{
+    // Scan a chunk of the response body. Bytes outside the 'data' array are added to the envelope;
+    // the bytes of each element of the array are gathered and the element decoded once it is complete
+    // PARAMETERS:
+    //   'data' is the chunk of data received from the server
+    // RETURNS:
+    //   NO if the data could not be decoded, otherwise YES
+
+    if (error != nil) return NO;
+    if (data == nil || data.length == 0) return YES;
+
+    const uint8_t *bytes = data.bytes;
+    NSUInteger length = data.length;
+    NSUInteger runStart = 0;
+
+    for (NSUInteger i = 0 ; i < length ; ++i)
+    {
+        uint8_t c = bytes[i];
+
+        if (phase == kJSONListPhaseElement)
+        {
+            if (inString)
+            {
+                if (escaped)
+                {
+                    escaped = NO;
+                }
+                else if (c == '\\')
+                {
+                    escaped = YES;
+                }
+                else if (c == '"')
+                {
+                    inString = NO;
+                }
+
+                continue;
+            }
+
+            if (c == '"')
+            {
+                inString = YES;
+            }
+            else if (c == '{' || c == '[')
+            {
+                ++depth;
+            }
+            else if (c == '}' || c == ']')
+            {
+                if (depth == 2)
+                {
+                    // A scalar element ended by the close of the array - or malformed data
+
+                    if (c == '}')
+                    {
+                        error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSPropertyListReadCorruptError userInfo:nil];
+                        return NO;
+                    }
+
+                    [element appendBytes:(bytes + runStart) length:(i - runStart)];
+                    [self decodeElement];
+
+                    phase = kJSONListPhaseArray;
+                    runStart = i;
+                    --i;
+                    continue;
+                }
+
+                if (--depth == 2)
+                {
+                    // The element's closing bracket
+
+                    [element appendBytes:(bytes + runStart) length:(i + 1 - runStart)];
+                    [self decodeElement];
+
+                    phase = kJSONListPhaseArray;
+                    runStart = i + 1;
+                }
+            }
+            else if (c == ',' && depth == 2)
+            {
+                // A scalar element ended by the next one
+
+                [element appendBytes:(bytes + runStart) length:(i - runStart)];
+                [self decodeElement];
+
+                phase = kJSONListPhaseArray;
+                runStart = i + 1;
+            }
+
+            continue;
+        }
+
+        if (phase == kJSONListPhaseArray)
+        {
+            // Between the elements of the array, where only separators are expected
+
+            if (c == ']')
+            {
+                [envelope appendBytes:"]" length:1];
+
+                --depth;
+                phase = kJSONListPhaseEnvelope;
+                runStart = i + 1;
+            }
+            else if (c == ',' || c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            {
+                runStart = i + 1;
+            }
+            else
+            {
+                // The start of an element: process the byte again as part of it
+
+                phase = kJSONListPhaseElement;
+                runStart = i;
+                --i;
+            }
+
+            continue;
+        }
+
+        // Outside the array, look for the top-level 'data' key and the array that is its value
+
+        if (inString)
+        {
+            if (escaped)
+            {
+                escaped = NO;
+            }
+            else if (c == '\\')
+            {
+                escaped = YES;
+            }
+            else if (c == '"')
+            {
+                inString = NO;
+
+                if (expectKey)
+                {
+                    keyIsData = (key.length == 4 && memcmp(key.bytes, "data", 4) == 0);
+                    expectKey = NO;
+                }
+            }
+            else if (expectKey && key.length < 5)
+            {
+                [key appendBytes:&c length:1];
+            }
+
+            continue;
+        }
+
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') continue;
+
+        if (c == '[' && valueIsData && depth == 1 && !foundList)
+        {
+            // The start of the 'data' array: record it as empty in the envelope
+
+            [envelope appendBytes:(bytes + runStart) length:(i + 1 - runStart)];
+
+            ++depth;
+            foundList = YES;
+            valueIsData = NO;
+            phase = kJSONListPhaseArray;
+            runStart = i + 1;
+            continue;
+        }
+
+        valueIsData = NO;
+
+        if (c == '"')
+        {
+            inString = YES;
+            if (expectKey) key.length = 0;
+        }
+        else if (c == ':')
+        {
+            valueIsData = (depth == 1 && keyIsData);
+            keyIsData = NO;
+        }
+        else if (c == '{' || c == '[')
+        {
+            ++depth;
+            expectKey = (c == '{' && depth == 1);
+        }
+        else if (c == '}' || c == ']')
+        {
+            --depth;
+        }
+        else if (c == ',' && depth == 1)
+        {
+            expectKey = YES;
+        }
+    }
+
+    // Keep the unprocessed remainder of the chunk
+
+    if (runStart < length)
+    {
+        if (phase == kJSONListPhaseEnvelope) [envelope appendBytes:(bytes + runStart) length:(length - runStart)];
+        if (phase == kJSONListPhaseElement) [element appendBytes:(bytes + runStart) length:(length - runStart)];
+    }
+
+    return (error == nil);
+}
+
+
+
+- (void)decodeElement
+{
+    // Decode the gathered bytes of a single element of the 'data' array
+
+    NSError *decodeError = nil;
+    id item = [NSJSONSerialization JSONObjectWithData:element options:kNilOptions error:&decodeError];
+
+    if (item != nil)
+    {
+        if (decoder != nil) item = [decoder decodeRecord:item :fields];
+
+        [items addObject:item];
+    }
+    else if (error == nil)
+    {
+        error = decodeError;
+    }
+
+    element.length = 0;
+}
+
+
+
+- (NSDictionary *)result
+{
+    // Decode the envelope and restore the decoded elements to its 'data' array
+    // RETURNS:
+    //   The decoded response, or nil if it could not be decoded
+
+    if (error != nil) return nil;
+
+    NSError *decodeError = nil;
+    id decoded = [NSJSONSerialization JSONObjectWithData:envelope options:NSJSONReadingMutableContainers error:&decodeError];
+
+    if (![decoded isKindOfClass:[NSMutableDictionary class]])
+    {
+        error = decodeError != nil ? decodeError : [NSError errorWithDomain:NSCocoaErrorDomain code:NSPropertyListReadCorruptError userInfo:nil];
+        return nil;
+    }
+
+    NSMutableDictionary *dict = (NSMutableDictionary *)decoded;
+
+    if (foundList) [dict setObject:items forKey:@"data"];
+
+    return dict;
+}
+
+
+
+- (NSUInteger)count
+{
+    return items.count;
+}
+
+
+@end
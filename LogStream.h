@@ -0,0 +1,63 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import <Foundation/Foundation.h>
+
+
+@class Connexion;
+
+
+@interface LogStream : NSObject
+
+
+// Required by BuildAPI access class
+// LogStream is simply a packaging object for the state of one of the
+// impCentral API log streams that BuildAPIAccess spreads logging devices across
+
+// Methods
+
+- (instancetype)init;
+
+// Properties
+
+@property (nonatomic, strong) NSString       *streamID;
+@property (nonatomic, strong) NSURL          *url;
+@property (nonatomic, strong) Connexion      *connexion;          // The connexion carrying the stream's events
+@property (nonatomic, strong) NSMutableArray *devices;            // IDs of the devices assigned to the stream
+@property (nonatomic, strong) NSMutableArray *pendingDevices;     // Devices to subscribe once the stream opens
+@property (nonatomic, strong) NSString       *lastEventID;
+@property (nonatomic, assign) NSTimeInterval retryInterval;
+@property (nonatomic, assign) NSInteger      reconnectAttempts;
+@property (nonatomic, assign) NSUInteger     eventCount;         // Metrics: events and bytes received,
+@property (nonatomic, assign) NSUInteger     byteCount;          // and their values when last sampled
+@property (nonatomic, assign) NSUInteger     sampledEventCount;
+@property (nonatomic, assign) NSUInteger     sampledByteCount;
+@property (nonatomic, assign) NSTimeInterval sampleTime;
+@property (nonatomic, assign) BOOL           isOpen;
+@property (nonatomic, assign) BOOL           isClosed;
+
+
+@end
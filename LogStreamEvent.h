@@ -43,6 +43,7 @@
 @property (nonatomic, strong) NSError   *error;     // Errors with the connection to the source
 @property (nonatomic, assign) NSInteger type;       // Current state of the connection to the source
 @property (nonatomic, assign) NSInteger state;      // Current state of the connection to the source
+@property (nonatomic, strong) id        stream;     // The log stream from which the event came
 
 
 @end
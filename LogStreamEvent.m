@@ -30,7 +30,7 @@
 @implementation LogStreamEvent
 
 
-@synthesize eid, event, data, type, state, error;
+@synthesize eid, event, data, type, state, error, stream;
 
 
 - (instancetype)init
@@ -43,6 +43,7 @@
         event = nil;
         error = nil;
         data = nil;
+        stream = nil;
     }
 
     return self;
@@ -0,0 +1,65 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import <Foundation/Foundation.h>
+#import "BuildAPIAccessConstants.h"
+#import "LogStreamEvent.h"
+
+
+@interface LogStreamParser : NSObject
+
+{
+    NSMutableData *buffer, *eventData;
+
+    NSMutableArray *parsedEvents;
+
+    NSString *eventName;
+
+    NSUInteger lineStart, scanStart;
+
+    BOOL hasData, skipLineFeed, checkBOM;
+}
+
+
+// Required by BuildAPI access class
+// LogStreamParser incrementally extracts Server-Sent Events (SSE) from the raw
+// bytes of an impCentral API log stream as they arrive. Bytes are scanned once;
+// only complete fields are decoded, so a UTF-8 sequence split across chunks is safe
+
+// Methods
+
+- (instancetype)init;
+- (NSArray *)parseData:(NSData *)data;
+- (void)processLine:(const uint8_t *)line :(NSUInteger)length;
+- (void)dispatchEvent;
+
+// Properties
+
+@property (nonatomic, readonly) NSString        *lastEventID;     // Value of the most recent 'id' field
+@property (nonatomic, readonly) NSTimeInterval  retryInterval;    // Value of the most recent 'retry' field, in seconds, or 0
+
+
+@end
@@ -0,0 +1,263 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import "LogStreamParser.h"
+
+
+@implementation LogStreamParser
+
+
+@synthesize lastEventID, retryInterval;
+
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        buffer = [[NSMutableData alloc] init];
+        eventData = [[NSMutableData alloc] init];
+        parsedEvents = nil;
+        eventName = nil;
+        lastEventID = nil;
+        retryInterval = 0;
+        lineStart = 0;
+        scanStart = 0;
+        hasData = NO;
+        skipLineFeed = NO;
+        checkBOM = YES;
+    }
+
+    return self;
+}
+
+
+
+- (NSArray *)parseData:(NSData *)data
+{
+    // Add a chunk of streamed data to the buffer and scan the bytes we have not yet seen for line ends.
+    // Every complete line is processed in place; an incomplete trailing line is held until more data arrives
+    // PARAMETERS:
+    //   'data' is the chunk of data received from the server
+    // RETURNS:
+    //   An array of the LogStreamEvents completed by the chunk, or nil if there are none
+
+    if (data == nil || data.length == 0) return nil;
+
+    [buffer appendData:data];
+
+    const uint8_t *bytes = buffer.bytes;
+    NSUInteger length = buffer.length;
+    NSUInteger i = scanStart;
+
+    parsedEvents = nil;
+
+    if (checkBOM)
+    {
+        // The stream may begin with a UTF-8 byte order mark, which we ignore.
+        // Wait for enough bytes to tell if what we have is the start of one
+
+        const uint8_t bom[3] = { 0xEF, 0xBB, 0xBF };
+        NSUInteger count = length < 3 ? length : 3;
+
+        if (memcmp(bytes, bom, count) == 0)
+        {
+            if (count < 3) return nil;
+            i = lineStart = 3;
+        }
+
+        checkBOM = NO;
+    }
+
+    while (i < length)
+    {
+        uint8_t c = bytes[i];
+
+        if (skipLineFeed)
+        {
+            // The previous line ended with a CR: if this is the LF of a CRLF pair, skip it
+
+            skipLineFeed = NO;
+
+            if (c == '\n')
+            {
+                lineStart = ++i;
+                continue;
+            }
+        }
+
+        if (c == '\n' || c == '\r')
+        {
+            // SSE lines may end in CR, LF or CRLF
+
+            [self processLine:(bytes + lineStart) :(i - lineStart)];
+
+            skipLineFeed = (c == '\r');
+            lineStart = ++i;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    scanStart = i;
+
+    if (lineStart == length)
+    {
+        // Everything has been consumed, so just empty the buffer for re-use
+
+        buffer.length = 0;
+        lineStart = 0;
+        scanStart = 0;
+    }
+    else if (lineStart >= kLogStreamParserCompactSize)
+    {
+        // Drop consumed bytes from the front of the buffer so that it doesn't grow without limit
+
+        [buffer replaceBytesInRange:NSMakeRange(0, lineStart) withBytes:NULL length:0];
+        scanStart -= lineStart;
+        lineStart = 0;
+    }
+
+    NSArray *events = parsedEvents;
+    parsedEvents = nil;
+    return events;
+}
+
+
+
+- (void)processLine:(const uint8_t *)line :(NSUInteger)length
+{
+    // Process a single line of the stream (without its terminator), which is either
+    // a blank line, which marks the end of an event, a comment or a 'field: value' pair
+
+    if (length == 0)
+    {
+        [self dispatchEvent];
+        return;
+    }
+
+    // Lines beginning with a colon are comments
+
+    if (line[0] == ':') return;
+
+    // Split the line into field name and value. A line with no colon is a field name with an empty
+    // value; a single space after the colon is not part of the value
+
+    const uint8_t *colon = memchr(line, ':', length);
+    NSUInteger nameLength = colon != NULL ? (NSUInteger)(colon - line) : length;
+    const uint8_t *value = colon != NULL ? colon + 1 : line + length;
+    NSUInteger valueLength = colon != NULL ? length - nameLength - 1 : 0;
+
+    if (valueLength > 0 && value[0] == ' ')
+    {
+        ++value;
+        --valueLength;
+    }
+
+    if (nameLength == 4 && memcmp(line, "data", 4) == 0)
+    {
+        // 'data' - value will be, eg. 'opened', 'closed', '40000c2a69109f08 subscribed', or '<log entry>'
+        // Multiple data fields are joined with newlines, and decoded only when the event is complete
+
+        if (hasData) [eventData appendBytes:"\n" length:1];
+        [eventData appendBytes:value length:valueLength];
+        hasData = YES;
+    }
+    else if (nameLength == 5 && memcmp(line, "event", 5) == 0)
+    {
+        // 'event' - value will be 'message' or 'state_change'
+
+        eventName = [[NSString alloc] initWithBytes:value length:valueLength encoding:NSUTF8StringEncoding];
+    }
+    else if (nameLength == 2 && memcmp(line, "id", 2) == 0)
+    {
+        // 'id' - ignored if it contains a NULL, as per the SSE specification
+
+        if (memchr(value, 0, valueLength) == NULL) lastEventID = [[NSString alloc] initWithBytes:value length:valueLength encoding:NSUTF8StringEncoding];
+    }
+    else if (nameLength == 5 && memcmp(line, "retry", 5) == 0)
+    {
+        // 'retry' - the reconnection time in milliseconds; ignored if it is not all digits
+
+        if (valueLength == 0) return;
+
+        NSUInteger ms = 0;
+
+        for (NSUInteger i = 0 ; i < valueLength ; ++i)
+        {
+            if (value[i] < '0' || value[i] > '9') return;
+            ms = ms * 10 + (value[i] - '0');
+        }
+
+        retryInterval = ms / 1000.0;
+    }
+}
+
+
+
+- (void)dispatchEvent
+{
+    // Package the fields received since the last blank line as a LogStreamEvent.
+    // Events without data are discarded, as per the SSE specification
+
+    if (hasData)
+    {
+        LogStreamEvent *event = [[LogStreamEvent alloc] init];
+        event.type = kLogStreamEventTypeMessage;
+        event.event = eventName;
+        event.eid = lastEventID;
+        event.data = [[NSString alloc] initWithData:eventData encoding:NSUTF8StringEncoding];
+
+        // Don't lose an entry that contains malformed UTF-8
+
+        if (event.data == nil) event.data = [[NSString alloc] initWithData:eventData encoding:NSISOLatin1StringEncoding];
+
+        if (event.event != nil && [event.event compare:@"state_change"] == NSOrderedSame)
+        {
+            // Change the event's 'state' according to type
+            // NOTE 'state' doesn't matter for messages
+
+            event.type = kLogStreamEventTypeStateChange;
+            if ([event.data compare:@"opened"] == NSOrderedSame) event.state = kLogStreamEventStateOpen;
+            if ([event.data compare:@"closed"] == NSOrderedSame) event.state = kLogStreamEventStateClosed;
+            if ([event.data hasSuffix:@"subscribed"]) event.state = kLogStreamEventStateSubscribed;
+            if ([event.data hasSuffix:@"unsubscribed"]) event.state = kLogStreamEventStateUnsubscribed;
+        }
+
+        if (parsedEvents == nil) parsedEvents = [[NSMutableArray alloc] init];
+        [parsedEvents addObject:event];
+    }
+
+    // Clear the event fields, ready for the next one
+
+    eventData.length = 0;
+    eventName = nil;
+    hasData = NO;
+}
+
+
+@end
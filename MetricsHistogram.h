@@ -0,0 +1,57 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import <Foundation/Foundation.h>
+#import "BuildAPIAccessConstants.h"
+
+
+@interface MetricsHistogram : NSObject
+
+{
+    NSUInteger buckets[kMetricsHistogramBuckets];
+}
+
+
+// Required by BuildAPI access class
+// MetricsHistogram records a distribution of durations in buckets whose upper bounds
+// double from 1ms: bucket 0 holds values of up to 1ms, bucket 1 values of up to 2ms,
+// and so on, with the last bucket holding everything longer
+
+// Methods
+
+- (instancetype)init;
+- (void)record:(NSTimeInterval)duration;
+- (NSTimeInterval)percentile:(double)fraction;
+- (NSDictionary *)snapshot;
+
+// Properties
+
+@property (nonatomic, readonly) NSUInteger     count;
+@property (nonatomic, readonly) NSTimeInterval total;
+@property (nonatomic, readonly) NSTimeInterval max;
+
+
+@end
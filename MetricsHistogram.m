@@ -0,0 +1,119 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import "MetricsHistogram.h"
+
+
+@implementation MetricsHistogram
+
+
+@synthesize count, total, max;
+
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        for (NSUInteger i = 0 ; i < kMetricsHistogramBuckets ; ++i) buckets[i] = 0;
+        count = 0;
+        total = 0;
+        max = 0;
+    }
+
+    return self;
+}
+
+
+
+- (void)record:(NSTimeInterval)duration
+{
+    // Add a duration, in seconds, to the histogram
+
+    if (duration < 0) duration = 0;
+
+    // Find the bucket: the index is the power of two, in milliseconds, at or above the duration
+
+    double ms = duration * 1000.0;
+    int exponent = (ms > 1.0) ? (int)ceil(log2(ms)) : 0;
+
+    NSUInteger index = (exponent < kMetricsHistogramBuckets) ? (NSUInteger)exponent : kMetricsHistogramBuckets - 1;
+
+    buckets[index] += 1;
+    count += 1;
+    total += duration;
+    if (duration > max) max = duration;
+}
+
+
+
+- (NSTimeInterval)percentile:(double)fraction
+{
+    // Returns the upper bound, in seconds, of the bucket containing the specified fraction (0.0-1.0)
+    // of the recorded durations - or the longest duration, if that is shorter - or 0 if none are recorded
+
+    if (count == 0) return 0;
+
+    NSUInteger target = (NSUInteger)ceil(fraction * count);
+    NSUInteger seen = 0;
+
+    if (target == 0) target = 1;
+
+    for (NSUInteger i = 0 ; i < kMetricsHistogramBuckets ; ++i)
+    {
+        seen += buckets[i];
+
+        if (seen >= target)
+        {
+            NSTimeInterval bound = ldexp(1.0, (int)i) / 1000.0;
+            return (i < kMetricsHistogramBuckets - 1 && bound < max) ? bound : max;
+        }
+    }
+
+    return max;
+}
+
+
+
+- (NSDictionary *)snapshot
+{
+    // Returns the histogram as a dictionary. Durations are in seconds; 'buckets' is an array
+    // of the number of durations in each bucket
+
+    NSMutableArray *counts = [[NSMutableArray alloc] initWithCapacity:kMetricsHistogramBuckets];
+
+    for (NSUInteger i = 0 ; i < kMetricsHistogramBuckets ; ++i) [counts addObject:[NSNumber numberWithUnsignedInteger:buckets[i]]];
+
+    return @{ @"count" : [NSNumber numberWithUnsignedInteger:count],
+              @"mean" : [NSNumber numberWithDouble:(count > 0 ? total / count : 0)],
+              @"max" : [NSNumber numberWithDouble:max],
+              @"p50" : [NSNumber numberWithDouble:[self percentile:0.5]],
+              @"p90" : [NSNumber numberWithDouble:[self percentile:0.9]],
+              @"p99" : [NSNumber numberWithDouble:[self percentile:0.99]],
+              @"buckets" : counts };
+}
+
+
+@end
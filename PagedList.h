@@ -0,0 +1,56 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import <Foundation/Foundation.h>
+
+
+@interface PagedList : NSObject
+
+
+// Required by BuildAPI access class
+// PagedList is simply a packaging object for the state of a paginated list
+// whose remaining pages are being retrieved concurrently
+
+// Methods
+
+- (instancetype)init;
+
+// Properties
+
+@property (nonatomic, strong) NSMutableArray  *list;                // The master array the pages are added to
+@property (nonatomic, strong) NSMutableArray  *pages;               // Received pages, indexed by page number - 1
+@property (nonatomic, strong) NSString        *urlHead;             // Page URL up to the page number
+@property (nonatomic, strong) NSString        *urlTail;             // Page URL after the page number
+@property (nonatomic, strong) id              representedObject;
+@property (nonatomic, strong) NSMutableArray  *followers;           // Connexions sharing the list's result
+@property (nonatomic, assign) NSInteger       actionCode;
+@property (nonatomic, assign) NSInteger       lastPage;
+@property (nonatomic, assign) NSInteger       nextPage;            // The next page yet to be requested
+@property (nonatomic, assign) NSInteger       pagesOutstanding;    // Pages requested but not yet received
+@property (nonatomic, assign) NSInteger       pagesFailed;         // Pages recorded as empty because they could not be retrieved
+
+
+@end
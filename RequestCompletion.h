@@ -0,0 +1,55 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import <Foundation/Foundation.h>
+
+
+// The block called when a request made with a completion handler has completed. On success,
+// 'result' is the dictionary that would have been posted as the request's notification object,
+// and 'error' is nil; on failure, 'result' is nil and 'error' contains the keys 'message' and 'code'
+
+typedef void (^BuildAPICompletionHandler)(NSDictionary *result, NSDictionary *error);
+
+
+@interface RequestCompletion : NSObject
+
+
+// Required by BuildAPI access class
+// RequestCompletion is simply a packaging object for the completion handler
+// of a request made with one, and the queue on which it is called
+
+// Methods
+
+- (instancetype)init;
+
+// Properties
+
+@property (nonatomic, copy)   BuildAPICompletionHandler handler;
+@property (nonatomic, strong) dispatch_queue_t          queue;       // The queue on which 'handler' is called
+@property (nonatomic, assign) BOOL                      isComplete;
+
+
+@end
@@ -0,0 +1,60 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import <Foundation/Foundation.h>
+
+
+@interface RingBuffer : NSObject
+
+{
+    NSMutableArray *items;
+
+    NSUInteger head;
+}
+
+
+// Required by BuildAPI access class
+// RingBuffer holds up to 'capacity' objects in the order they were added. Once it is
+// full, adding an object overwrites the oldest, so adding never moves or copies items
+
+// Methods
+
+- (instancetype)initWithCapacity:(NSUInteger)size;
+- (void)addObject:(id)object;
+- (void)addObjectsFromArray:(NSArray *)array;
+- (void)replaceAllObjects:(NSArray *)array;
+- (void)removeAllObjects;
+- (NSArray *)allObjects;
+- (id)objectAtIndex:(NSUInteger)index;
+- (id)lastObject;
+
+// Properties
+
+@property (nonatomic, readwrite, setter=setCapacity:) NSUInteger capacity;
+@property (nonatomic, readonly) NSUInteger count;
+
+
+@end
@@ -0,0 +1,153 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import "RingBuffer.h"
+
+
+@implementation RingBuffer
+
+
+@synthesize capacity;
+
+
+- (instancetype)initWithCapacity:(NSUInteger)size
+{
+    if (self = [super init])
+    {
+        capacity = size > 0 ? size : 1;
+        items = [[NSMutableArray alloc] initWithCapacity:capacity];
+        head = 0;
+    }
+
+    return self;
+}
+
+
+
+- (void)addObject:(id)object
+{
+    // Add an object, overwriting the oldest if the buffer is full. 'head' indexes the oldest object
+
+    if (object == nil) return;
+
+    if (items.count < capacity)
+    {
+        [items addObject:object];
+        return;
+    }
+
+    [items replaceObjectAtIndex:head withObject:object];
+    head = (head + 1) % capacity;
+}
+
+
+
+- (void)addObjectsFromArray:(NSArray *)array
+{
+    for (id object in array) [self addObject:object];
+}
+
+
+
+- (void)replaceAllObjects:(NSArray *)array
+{
+    // Replace the contents with the newest 'capacity' objects of the array
+
+    [self removeAllObjects];
+
+    NSUInteger start = array.count > capacity ? array.count - capacity : 0;
+
+    [items addObjectsFromArray:[array subarrayWithRange:NSMakeRange(start, array.count - start)]];
+}
+
+
+
+- (void)removeAllObjects
+{
+    [items removeAllObjects];
+    head = 0;
+}
+
+
+
+- (NSArray *)allObjects
+{
+    // Returns the objects, oldest first
+
+    if (head == 0) return [NSArray arrayWithArray:items];
+
+    NSMutableArray *array = [[NSMutableArray alloc] initWithCapacity:items.count];
+    [array addObjectsFromArray:[items subarrayWithRange:NSMakeRange(head, items.count - head)]];
+    [array addObjectsFromArray:[items subarrayWithRange:NSMakeRange(0, head)]];
+    return array;
+}
+
+
+
+- (id)objectAtIndex:(NSUInteger)index
+{
+    // Returns the object at the index, counting from the oldest, or nil if there is no such object
+
+    if (index >= items.count) return nil;
+
+    return [items objectAtIndex:((head + index) % items.count)];
+}
+
+
+
+- (id)lastObject
+{
+    // Returns the most recently added object
+
+    if (items.count == 0) return nil;
+
+    return [items objectAtIndex:(head == 0 ? items.count - 1 : head - 1)];
+}
+
+
+
+- (void)setCapacity:(NSUInteger)size
+{
+    // Change the capacity, keeping the newest objects if there are now too many
+
+    if (size == 0) size = 1;
+    if (size == capacity) return;
+
+    NSArray *array = [self allObjects];
+    capacity = size;
+    [self replaceAllObjects:array];
+}
+
+
+
+- (NSUInteger)count
+{
+    return items.count;
+}
+
+
+
+@end
@@ -0,0 +1,56 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import <Foundation/Foundation.h>
+
+
+@interface RolloutStep : NSObject
+
+
+// Required by BuildAPI access class
+// RolloutStep is simply a packaging object for one step of a rollout pipeline:
+// the request it makes, the steps it waits for, and its outcome
+
+// Methods
+
+- (instancetype)init;
+
+// Properties
+
+@property (nonatomic, strong) NSString       *stepID;
+@property (nonatomic, strong) NSString       *devicegroupID;      // The device group the step acts on
+@property (nonatomic, strong) NSDictionary   *plan;               // The step's entry in the host's plan
+@property (nonatomic, strong) NSArray        *dependencies;       // IDs of the steps which must succeed first
+@property (nonatomic, strong) NSMutableArray *dependents;         // Steps waiting for this one
+@property (nonatomic, strong) NSString       *inputID;            // ID of the step whose record is this step's input
+@property (nonatomic, strong) NSDictionary   *result;             // The record returned by the step's request
+@property (nonatomic, strong) NSString       *error;
+@property (nonatomic, assign) NSInteger      action;
+@property (nonatomic, assign) NSInteger      state;
+@property (nonatomic, assign) NSInteger      waitingOn;           // Number of dependencies yet to succeed
+
+
+@end
@@ -0,0 +1,73 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import <Foundation/Foundation.h>
+#import "BuildAPIAccessConstants.h"
+
+
+@class BuildAPIAccess;
+
+
+@interface SessionPool : NSObject <NSURLSessionDataDelegate, NSURLSessionTaskDelegate>
+
+{
+    NSMutableDictionary *sessions, *accounts;
+
+    NSMapTable *taskOwners;
+
+    NSOperationQueue *delegateQueue;
+
+    dispatch_queue_t poolQueue;
+}
+
+
+// Required by BuildAPI access class
+// SessionPool lets many BuildAPIAccess instances, one per account, share one NSURLSession -
+// and so one pool of kept-alive, TLS-established connections - per impCloud host. Each
+// instance keeps its own access token, rate limiter, request queues and log streams. The
+// pool routes each task's delegate callbacks to the processing queue of the instance which
+// made it. It can also make the same request of every account at once and merge the results
+
+// Methods
+
+- (instancetype)init;
+- (BuildAPIAccess *)addAccount:(NSString *)name;
+- (void)removeAccount:(NSString *)name;
+- (BuildAPIAccess *)account:(NSString *)name;
+- (NSArray *)accountNames;
+- (void)fanOut:(void (^)(BuildAPIAccess *account, id someObject))request :(dispatch_queue_t)queue :(void (^)(NSDictionary *result))handler;
+- (NSURLSessionDataTask *)dataTask:(NSURLRequest *)request :(BuildAPIAccess *)owner;
+- (NSURLSession *)sessionForHost:(NSString *)host;
+- (BuildAPIAccess *)ownerOfTask:(NSURLSessionTask *)task :(BOOL)remove;
+- (void)invalidate;
+
+// Properties
+
+@property (nonatomic, readwrite) NSUInteger maxConnectionsPerHost;     // Applies to sessions created from now on
+@property (nonatomic, readonly) NSUInteger  count;                     // Number of accounts
+
+
+@end
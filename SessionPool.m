@@ -0,0 +1,370 @@
+
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+#import "SessionPool.h"
+#import "BuildAPIAccess.h"
+
+
+@implementation SessionPool
+
+
+@synthesize maxConnectionsPerHost;
+@dynamic count;
+
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        sessions = [[NSMutableDictionary alloc] init];
+        accounts = [[NSMutableDictionary alloc] init];
+        taskOwners = [NSMapTable strongToWeakObjectsMapTable];
+        poolQueue = dispatch_queue_create("SessionPool.pool", DISPATCH_QUEUE_SERIAL);
+        maxConnectionsPerHost = kSessionPoolConnectionsPerHost;
+
+        // The shared sessions' callbacks only look up the task's instance and pass them on to it,
+        // so a single serial queue serves every session
+
+        delegateQueue = [[NSOperationQueue alloc] init];
+        delegateQueue.maxConcurrentOperationCount = 1;
+    }
+
+    return self;
+}
+
+
+
+#pragma mark - Account Methods
+
+
+- (BuildAPIAccess *)addAccount:(NSString *)name
+{
+    // Create an instance for an account, which sends its requests through the pool's shared sessions.
+    // Each account has its own processing queue, so the responses of different accounts are handled
+    // concurrently - its notifications are therefore posted on that queue
+    // PARAMETERS:
+    //   'name' is the host's name for the account, used as the key of its fan-out results
+    // RETURNS:
+    //   The instance, which must then be logged in, or nil if 'name' is already in use
+
+    if (name == nil || name.length == 0) return nil;
+
+    // Set the instance up before taking the pool's lock, as its setters may wait on other queues
+
+    NSString *label = [NSString stringWithFormat:@"BuildAPIAccess.%@", name];
+    BuildAPIAccess *api = [[BuildAPIAccess alloc] init];
+    api.processingQueue = dispatch_queue_create(label.UTF8String, DISPATCH_QUEUE_SERIAL);
+    api.sessionPool = self;
+
+    __block BOOL added = NO;
+
+    dispatch_sync(poolQueue, ^{
+        if ([accounts objectForKey:name] != nil) return;
+
+        [accounts setObject:api forKey:name];
+        added = YES;
+    });
+
+    return added ? api : nil;
+}
+
+
+
+- (void)removeAccount:(NSString *)name
+{
+    // Remove an account from the pool, logging it out and cancelling its requests
+
+    __block BuildAPIAccess *api = nil;
+
+    dispatch_sync(poolQueue, ^{
+        api = [accounts objectForKey:name];
+
+        if (api != nil) [accounts removeObjectForKey:name];
+    });
+
+    if (api == nil) return;
+
+    [api logout];
+    [api killAllConnections];
+}
+
+
+
+- (BuildAPIAccess *)account:(NSString *)name
+{
+    __block BuildAPIAccess *api = nil;
+
+    dispatch_sync(poolQueue, ^{ api = [accounts objectForKey:name]; });
+
+    return api;
+}
+
+
+
+- (NSArray *)accountNames
+{
+    __block NSArray *names = nil;
+
+    dispatch_sync(poolQueue, ^{ names = [accounts.allKeys sortedArrayUsingSelector:@selector(compare:)]; });
+
+    return names;
+}
+
+
+
+- (void)fanOut:(void (^)(BuildAPIAccess *account, id someObject))request :(dispatch_queue_t)queue :(void (^)(NSDictionary *result))handler
+{
+    // Make the same request of every account at once, and call the handler once every account has answered
+    // PARAMETERS:
+    //   'request' is a block that makes the request of the account it is given, passing the object it is
+    //             given to the request method, eg. ^(BuildAPIAccess *account, id obj){ [account getDevices:obj]; }
+    //   'queue' is the queue on which the handler will be called, or nil for the main queue
+    //   'handler' is called with a dictionary containing:
+    //       'data'     - the merged results: the records of every account's list, or every account's single record
+    //       'accounts' - each account's result, keyed by account name
+    //       'errors'   - the error of each account whose request failed, keyed by account name
+    // RETURNS:
+    //   Nothing
+
+    if (request == nil || handler == nil) return;
+
+    __block NSDictionary *targets = nil;
+
+    dispatch_sync(poolQueue, ^{ targets = [accounts copy]; });
+
+    NSMutableDictionary *results = [[NSMutableDictionary alloc] init];
+    NSMutableDictionary *errors = [[NSMutableDictionary alloc] init];
+    dispatch_queue_t gatherQueue = dispatch_queue_create("SessionPool.fanOut", DISPATCH_QUEUE_SERIAL);
+    dispatch_group_t group = dispatch_group_create();
+
+    for (NSString *name in targets)
+    {
+        BuildAPIAccess *account = [targets objectForKey:name];
+
+        dispatch_group_enter(group);
+
+        [account performRequest:^(id someObject) {
+            request(account, someObject);
+        } :gatherQueue :^(NSDictionary *result, NSDictionary *error) {
+            if (error != nil)
+            {
+                [errors setObject:error forKey:name];
+            }
+            else
+            {
+                id data = [result objectForKey:@"data"];
+
+                if (data != nil) [results setObject:data forKey:name];
+            }
+
+            dispatch_group_leave(group);
+        }];
+    }
+
+    dispatch_group_notify(group, gatherQueue, ^{
+        // Merge the results in account name order, so that the merged list is the same from call to call
+
+        NSMutableArray *merged = [[NSMutableArray alloc] init];
+
+        for (NSString *name in [results.allKeys sortedArrayUsingSelector:@selector(compare:)])
+        {
+            id data = [results objectForKey:name];
+
+            if ([data isKindOfClass:[NSArray class]])
+            {
+                [merged addObjectsFromArray:data];
+            }
+            else
+            {
+                [merged addObject:data];
+            }
+        }
+
+        NSDictionary *result = @{ @"data" : merged,
+                                  @"accounts" : [results copy],
+                                  @"errors" : [errors copy] };
+
+        dispatch_async((queue != nil ? queue : dispatch_get_main_queue()), ^{
+            handler(result);
+        });
+    });
+}
+
+
+
+- (NSUInteger)count
+{
+    __block NSUInteger count = 0;
+
+    dispatch_sync(poolQueue, ^{ count = accounts.count; });
+
+    return count;
+}
+
+
+
+#pragma mark - Session Methods
+
+
+- (NSURLSessionDataTask *)dataTask:(NSURLRequest *)request :(BuildAPIAccess *)owner
+{
+    // Create a task for the request in the shared session for its host, and note which instance it belongs to.
+    // The instance resumes the task itself
+
+    NSURLSessionDataTask *task = [[self sessionForHost:request.URL.host] dataTaskWithRequest:request];
+
+    dispatch_sync(poolQueue, ^{ [taskOwners setObject:owner forKey:task]; });
+
+    return task;
+}
+
+
+
+- (NSURLSession *)sessionForHost:(NSString *)host
+{
+    // Returns the shared session for the specified host, creating it if necessary. Sessions are configured
+    // for many accounts' requests: more connections per host, and no cookies or credentials, which would
+    // otherwise be shared between accounts
+
+    __block NSURLSession *session = nil;
+    NSString *key = host != nil ? host : @"";
+
+    dispatch_sync(poolQueue, ^{
+        session = [sessions objectForKey:key];
+
+        if (session != nil) return;
+
+        NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
+        configuration.URLCache = [[NSURLCache alloc] initWithMemoryCapacity:0 diskCapacity:0 diskPath:nil];
+        configuration.requestCachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
+        configuration.HTTPMaximumConnectionsPerHost = self.maxConnectionsPerHost;
+        configuration.HTTPShouldSetCookies = NO;
+        configuration.HTTPCookieAcceptPolicy = NSHTTPCookieAcceptPolicyNever;
+        configuration.HTTPCookieStorage = nil;
+        configuration.URLCredentialStorage = nil;
+
+        session = [NSURLSession sessionWithConfiguration:configuration delegate:self delegateQueue:delegateQueue];
+        [sessions setObject:session forKey:key];
+    });
+
+    return session;
+}
+
+
+
+- (BuildAPIAccess *)ownerOfTask:(NSURLSessionTask *)task :(BOOL)remove
+{
+    // Returns the instance which made the task, or nil if it has gone, optionally forgetting the task
+
+    __block BuildAPIAccess *owner = nil;
+
+    dispatch_sync(poolQueue, ^{
+        owner = [taskOwners objectForKey:task];
+
+        if (remove) [taskOwners removeObjectForKey:task];
+    });
+
+    return owner;
+}
+
+
+
+- (void)invalidate
+{
+    // Let every shared session finish its tasks, then release it
+
+    dispatch_sync(poolQueue, ^{
+        for (NSURLSession *session in sessions.allValues) [session finishTasksAndInvalidate];
+
+        [sessions removeAllObjects];
+    });
+}
+
+
+
+#pragma mark - NSURLSession Delegate Methods
+
+
+- (void)URLSession:(NSURLSession *)session
+          dataTask:(NSURLSessionDataTask *)dataTask
+didReceiveResponse:(NSURLResponse *)response
+ completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler
+{
+    BuildAPIAccess *owner = [self ownerOfTask:dataTask :NO];
+
+    if (owner == nil)
+    {
+        if (completionHandler != nil) completionHandler(NSURLSessionResponseCancel);
+        return;
+    }
+
+    [owner performOnProcessingQueue:^{
+        [owner URLSession:session dataTask:dataTask didReceiveResponse:response completionHandler:completionHandler];
+    }];
+}
+
+
+
+- (void)URLSession:(NSURLSession *)session
+          dataTask:(NSURLSessionDataTask *)dataTask
+    didReceiveData:(NSData *)data
+{
+    BuildAPIAccess *owner = [self ownerOfTask:dataTask :NO];
+
+    [owner performOnProcessingQueue:^{
+        [owner URLSession:session dataTask:dataTask didReceiveData:data];
+    }];
+}
+
+
+
+- (void)URLSession:(NSURLSession *)session
+              task:(NSURLSessionTask *)task
+didCompleteWithError:(NSError *)error
+{
+    BuildAPIAccess *owner = [self ownerOfTask:task :YES];
+
+    [owner performOnProcessingQueue:^{
+        [owner URLSession:session task:task didCompleteWithError:error];
+    }];
+}
+
+
+
+- (void)URLSession:(NSURLSession *)session didBecomeInvalidWithError:(NSError *)error
+{
+    // A session is only invalidated by 'invalidate:', which has already released it, unless the system did so
+
+    dispatch_sync(poolQueue, ^{
+        for (NSString *key in sessions.allKeys)
+        {
+            if ([sessions objectForKey:key] == session) [sessions removeObjectForKey:key];
+        }
+    });
+}
+
+
+@end
@@ -0,0 +1,549 @@
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+//  Microbenchmarks of BuildAPIAccess internals. These need no server.
+//
+//  Usage: BuildAPIBench [benchmark ...]
+//
+//  Benchmarks:
+//    registry    The cost of finding an in-flight connexion from an NSURLSession callback,
+//                with 10 to 10,000 connexions in flight. The list walk that the registry
+//                replaced is measured alongside it for comparison
+//    sse         Log stream parsing throughput: LogStreamParser against the parser it replaced,
+//                which decoded and split the whole carried-over buffer as a string on every chunk
+//    snapshot    The time taken to encode, write and restore a snapshot of 1,000 to 50,000 devices.
+//                The snapshot is JSON, so restoring it decodes every record it holds
+//    records     The memory held by a list of 50,000 devices decoded as plain records, against
+//                the same list with a few fields projected (listFields) as CompactRecords
+//                (useCompactRecords)
+
+
+
+#import <Foundation/Foundation.h>
+#ifdef __APPLE__
+#import <mach/mach.h>
+#endif
+#import "../BuildAPIAccess.h"
+#import "../JSONListParser.h"
+#import "../LogStreamParser.h"
+
+
+#define kBenchRegistryLookups       100000
+#define kBenchStreamEvents          50000
+#define kBenchStreamChunkSize       1460
+#define kBenchEndpoint              @"http://127.0.0.1:1/v5/"
+#define kBenchRecordDevices         50000
+#define kBenchRecordPageSize        100
+
+
+
+// The log stream parser as it was before LogStreamParser, with event dispatch replaced by
+// collecting the events. NOTE it only handles LF line ends, and a chunk that ends partway
+// through a UTF-8 sequence fails to decode, so the benchmark stream is LF-terminated ASCII
+
+@interface LegacyStreamParser : NSObject
+
+{
+    NSMutableData *held;
+}
+
+- (NSArray *)parseData:(NSData *)data;
+
+@end
+
+
+
+@implementation LegacyStreamParser
+
+
+- (NSArray *)parseData:(NSData *)data
+{
+    NSMutableArray *parsed = [[NSMutableArray alloc] init];
+    NSString *eventString;
+
+    if (held != nil && held.length > 0)
+    {
+        [held appendData:data];
+        eventString = [[NSString alloc] initWithData:held encoding:NSUTF8StringEncoding];
+        held = [NSMutableData dataWithLength:0];
+    }
+    else
+    {
+        eventString = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+    }
+
+    NSString *lastTwoChars = @"";
+    if (eventString.length > 2) lastTwoChars = [eventString substringFromIndex:eventString.length - 2];
+    BOOL lastMessageTruncated = ([lastTwoChars compare:kLogStreamEventSeparatorLFLF] == NSOrderedSame) ? NO : YES;
+
+    NSArray *events = [eventString componentsSeparatedByString:kLogStreamEventSeparatorLFLF];
+
+    if (events.count > 1)
+    {
+        for (NSUInteger i = 0 ; i < events.count ; ++i)
+        {
+            NSString *event = [events objectAtIndex:i];
+
+            if (event.length == 0) continue;
+
+            if (i == events.count - 1 && lastMessageTruncated)
+            {
+                held = [NSMutableData dataWithData:[event dataUsingEncoding:NSUTF8StringEncoding]];
+            }
+            else
+            {
+                LogStreamEvent *logStreamEvent = [[LogStreamEvent alloc] init];
+                logStreamEvent.type = kLogStreamEventTypeMessage;
+
+                NSArray *lines = [event componentsSeparatedByString:kLogStreamEventKeyValuePairSeparator];
+
+                for (NSString *line in lines)
+                {
+                    if ([line hasPrefix:@":"]) continue;
+
+                    NSRange fieldSeparatorRange = [line rangeOfString:kLogStreamKeyValueDelimiter];
+
+                    if (fieldSeparatorRange.location != NSNotFound)
+                    {
+                        NSString *key = [line substringToIndex:fieldSeparatorRange.location];
+                        NSString *value = [line substringFromIndex:fieldSeparatorRange.location + 2];
+
+                        if ([key isEqualToString:kLogStreamEventEventKey])
+                        {
+                            logStreamEvent.event = value;
+                        }
+                        else if ([key isEqualToString:kLogStreamEventDataKey])
+                        {
+                            logStreamEvent.data = logStreamEvent.data != nil ? [logStreamEvent.data stringByAppendingFormat:@"\n%@", value] : value;
+                        }
+                        else if ([key isEqualToString:kLogStreamEventIDKey])
+                        {
+                            logStreamEvent.eid = value;
+                        }
+                    }
+                }
+
+                if (logStreamEvent.data != nil)
+                {
+                    if ([logStreamEvent.event compare:@"state_change"] == NSOrderedSame) logStreamEvent.type = kLogStreamEventTypeStateChange;
+
+                    [parsed addObject:logStreamEvent];
+                }
+            }
+        }
+    }
+    else
+    {
+        if (held == nil) held = [[NSMutableData alloc] init];
+
+        [held appendData:data];
+    }
+
+    return parsed;
+}
+
+
+@end
+
+
+
+static NSTimeInterval now(void)
+{
+    return [NSProcessInfo processInfo].systemUptime;
+}
+
+
+
+static double residentMB(void)
+{
+    // Current resident set size, or 0 if it can't be read
+
+#ifdef __APPLE__
+    struct mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) return 0;
+
+    return info.resident_size / (1024.0 * 1024.0);
+#else
+    unsigned long pages = 0;
+    FILE *file = fopen("/proc/self/statm", "r");
+
+    if (file == NULL) return 0;
+    if (fscanf(file, "%*lu %lu", &pages) != 1) pages = 0;
+
+    fclose(file);
+    return pages * (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+#endif
+}
+
+
+
+static Connexion *walkConnexions(NSArray *list, NSURLSessionTask *task)
+{
+    // How connexions were found before they were registered by task identifier
+
+    for (Connexion *connexion in list)
+    {
+        if (connexion.task == task) return connexion;
+    }
+
+    return nil;
+}
+
+
+
+static void benchRegistry(void)
+{
+    // Register 'count' connexions whose tasks are created but never resumed, so nothing is sent,
+    // then time the lookup made by each delegate callback, and adding and removing a connexion
+
+    NSURLSession *session = [NSURLSession sessionWithConfiguration:[NSURLSessionConfiguration ephemeralSessionConfiguration]];
+    NSURL *url = [NSURL URLWithString:@"http://127.0.0.1:1/"];
+    NSUInteger counts[] = { 10, 100, 1000, 10000 };
+
+    printf("Connexion registry (ns per operation)\n");
+    printf("%10s %12s %12s %12s %12s\n", "in flight", "lookup", "add", "remove", "list walk");
+
+    for (NSUInteger c = 0 ; c < sizeof(counts) / sizeof(counts[0]) ; ++c)
+    {
+        @autoreleasepool
+        {
+            NSUInteger count = counts[c];
+            BuildAPIAccess *api = [[BuildAPIAccess alloc] init];
+            NSMutableArray *list = [[NSMutableArray alloc] initWithCapacity:count];
+            NSMutableArray *tasks = [[NSMutableArray alloc] initWithCapacity:count];
+
+            for (NSUInteger i = 0 ; i < count ; ++i)
+            {
+                Connexion *connexion = [[Connexion alloc] init];
+                connexion.task = [session dataTaskWithURL:url];
+                [list addObject:connexion];
+                [tasks addObject:connexion.task];
+            }
+
+            // Add
+
+            NSTimeInterval start = now();
+
+            for (Connexion *connexion in list) [api addConnexion:connexion];
+
+            double addCost = (now() - start) * 1e9 / count;
+
+            // Look up, spread across the whole registry
+
+            NSUInteger found = 0;
+            start = now();
+
+            for (NSUInteger i = 0 ; i < kBenchRegistryLookups ; ++i)
+            {
+                if ([api connexionForTask:[tasks objectAtIndex:((i * 7919) % count)]] != nil) ++found;
+            }
+
+            double lookupCost = (now() - start) * 1e9 / kBenchRegistryLookups;
+
+            // The list walk, over the same tasks. Fewer lookups are made: at 10,000 it is slow
+
+            NSUInteger walks = kBenchRegistryLookups / 100;
+            start = now();
+
+            for (NSUInteger i = 0 ; i < walks ; ++i)
+            {
+                if (walkConnexions(list, [tasks objectAtIndex:((i * 7919) % count)]) != nil) ++found;
+            }
+
+            double walkCost = (now() - start) * 1e9 / walks;
+
+            // Remove
+
+            start = now();
+
+            for (Connexion *connexion in list) [api removeConnexion:connexion];
+
+            double removeCost = (now() - start) * 1e9 / count;
+
+            if (found != kBenchRegistryLookups + walks || api.numberOfConnections != 0) printf("FAILED: registry lost connexions\n");
+
+            printf("%10lu %12.0f %12.0f %12.0f %12.0f\n", (unsigned long)count, lookupCost, addCost, removeCost, walkCost);
+        }
+    }
+
+    [session invalidateAndCancel];
+}
+
+
+
+static NSArray *makeStreamChunks(void)
+{
+    // A log stream of 'kBenchStreamEvents' messages, cut into packet-sized chunks
+
+    NSMutableData *stream = [[NSMutableData alloc] init];
+
+    for (NSUInteger i = 0 ; i < kBenchStreamEvents ; ++i)
+    {
+        NSString *event = [NSString stringWithFormat:@"id: %lu\nevent: message\ndata: %016lx 2019-09-06T10:00:00.000Z development server.log Reading %lu: temperature 21.5C humidity 40%%\n\n",
+                           (unsigned long)i, (unsigned long)(0x2000000000000000 + i % 1000), (unsigned long)i];
+        [stream appendData:[event dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+
+    NSMutableArray *chunks = [[NSMutableArray alloc] init];
+
+    for (NSUInteger i = 0 ; i < stream.length ; i += kBenchStreamChunkSize)
+    {
+        [chunks addObject:[stream subdataWithRange:NSMakeRange(i, MIN(kBenchStreamChunkSize, stream.length - i))]];
+    }
+
+    return chunks;
+}
+
+
+
+static void benchStreamParsing(void)
+{
+    // Parse the same stream with each parser and compare events and megabytes per second
+
+    NSArray *chunks = makeStreamChunks();
+    NSUInteger length = 0;
+
+    for (NSData *chunk in chunks) length += chunk.length;
+
+    printf("Log stream parsing (%lu events, %lu bytes, %i-byte chunks)\n", (unsigned long)kBenchStreamEvents, (unsigned long)length, kBenchStreamChunkSize);
+    printf("%16s %12s %12s %10s\n", "parser", "events/s", "MB/s", "events");
+
+    for (NSUInteger p = 0 ; p < 2 ; ++p)
+    {
+        @autoreleasepool
+        {
+            id parser = (p == 0) ? (id)[[LegacyStreamParser alloc] init] : (id)[[LogStreamParser alloc] init];
+            NSUInteger count = 0;
+            NSTimeInterval start = now();
+
+            for (NSData *chunk in chunks)
+            {
+                @autoreleasepool
+                {
+                    count += [[parser parseData:chunk] count];
+                }
+            }
+
+            NSTimeInterval elapsed = now() - start;
+
+            printf("%16s %12.0f %12.1f %10lu%s\n", (p == 0 ? "legacy" : "LogStreamParser"),
+                   count / elapsed, length / elapsed / (1024 * 1024), (unsigned long)count,
+                   (count == kBenchStreamEvents ? "" : "  FAILED: events lost"));
+        }
+    }
+}
+
+
+
+static NSArray *makeDeviceRecords(NSUInteger count, BOOL complete)
+{
+    // Device records shaped like those served by mock_impcentral.py. If 'complete' is YES, they also
+    // carry the other attributes, relationships and links that the impCentral API returns
+
+    NSMutableArray *records = [[NSMutableArray alloc] initWithCapacity:count];
+
+    for (NSUInteger i = 0 ; i < count ; ++i)
+    {
+        NSString *deviceID = [NSString stringWithFormat:@"%016lx", (unsigned long)(0x2000000000000000 + i)];
+        NSMutableDictionary *attributes = [NSMutableDictionary dictionaryWithDictionary:@{
+            @"name" : [NSString stringWithFormat:@"Device %lu", (unsigned long)i],
+            @"mac_address" : [NSString stringWithFormat:@"0c:2a:69:%02lx:%02lx:%02lx", (unsigned long)((i >> 16) & 0xFF), (unsigned long)((i >> 8) & 0xFF), (unsigned long)(i & 0xFF)],
+            @"device_online" : [NSNumber numberWithBool:(i % 7 != 0)],
+            @"agent_id" : [NSString stringWithFormat:@"agent%08lu", (unsigned long)i],
+            @"imp_type" : @"imp005",
+            @"swversion" : @"43.0.0" }];
+        NSMutableDictionary *relationships = [NSMutableDictionary dictionaryWithDictionary:@{
+            @"devicegroup" : @{ @"type" : @"development_devicegroup",
+                                @"id" : [NSString stringWithFormat:@"%08lx-0000-0000-0000-000000000000", (unsigned long)(0x10000000 + i % 100)] } }];
+        NSMutableDictionary *record = [NSMutableDictionary dictionaryWithDictionary:@{ @"type" : @"device", @"id" : deviceID }];
+
+        if (complete)
+        {
+            [attributes addEntriesFromDictionary:@{
+                @"agent_url" : [NSString stringWithFormat:@"https://agent.electricimp.com/agent%08lu", (unsigned long)i],
+                @"agent_running" : [NSNumber numberWithBool:(i % 7 != 0)],
+                @"device_state_changed_at" : @"2019-09-06T10:00:00.000Z",
+                @"last_enrolled_at" : @"2019-01-15T08:30:00.000Z",
+                @"free_memory" : [NSNumber numberWithUnsignedInteger:(80000 + i % 1000)],
+                @"rssi" : [NSNumber numberWithInteger:-(40 + (NSInteger)(i % 50))],
+                @"ip_address" : [NSString stringWithFormat:@"10.%lu.%lu.%lu", (unsigned long)((i >> 16) & 0xFF), (unsigned long)((i >> 8) & 0xFF), (unsigned long)(i & 0xFF)],
+                @"plan_id" : [NSString stringWithFormat:@"plan%012lu", (unsigned long)i],
+                @"device_test_created_at" : [NSNull null] }];
+            [relationships addEntriesFromDictionary:@{
+                @"product" : @{ @"type" : @"product", @"id" : @"20000000-0000-0000-0000-000000000000" },
+                @"owner" : @{ @"type" : @"account", @"id" : @"c1d61eef-d544-4d09-c8dc-d43e6742cae3" } }];
+            [record setObject:@{ @"self" : [@"https://api.electricimp.com/v5/devices/" stringByAppendingString:deviceID] } forKey:@"links"];
+        }
+
+        [record setObject:attributes forKey:@"attributes"];
+        [record setObject:relationships forKey:@"relationships"];
+        [records addObject:record];
+    }
+
+    return records;
+}
+
+
+
+static void benchSnapshot(void)
+{
+    // Write snapshots of ever larger fleets, then time how long an instance takes to restore them.
+    // The endpoint is one at which nothing listens, so the mirror's background resync fails at once
+
+    NSUInteger counts[] = { 1000, 10000, 50000 };
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"BuildAPIBench.snapshot"];
+
+    printf("Snapshot (ms, JSON)\n");
+    printf("%10s %12s %12s %12s %12s\n", "devices", "bytes", "encode", "write", "restore");
+
+    for (NSUInteger c = 0 ; c < sizeof(counts) / sizeof(counts[0]) ; ++c)
+    {
+        @autoreleasepool
+        {
+            NSUInteger count = counts[c];
+            BuildAPIAccess *api = [[BuildAPIAccess alloc] init];
+            api.processingQueue = dispatch_queue_create("com.bps.buildapiaccess.bench", DISPATCH_QUEUE_SERIAL);
+            [api setEndpoint:kBenchEndpoint];
+            api.snapshotPath = path;
+
+            // The snapshot as 'saveSnapshot' makes it
+
+            NSDictionary *snapshot = @{ @"version" : [NSNumber numberWithInteger:kSnapshotVersion],
+                                        @"account" : @"",
+                                        @"cloud" : [NSNumber numberWithInteger:0],
+                                        @"endpoint" : kBenchEndpoint,
+                                        @"customEndpoint" : [NSNumber numberWithBool:YES],
+                                        @"token" : @{ @"accessToken" : @"bench", @"refreshToken" : @"bench",
+                                                      @"expiryDate" : @"2099-01-01T00:00:00.000Z" },
+                                        @"records" : @{ kFleetMirrorTypeDevice : makeDeviceRecords(count, NO) } };
+
+            NSTimeInterval start = now();
+            NSData *data = [NSJSONSerialization dataWithJSONObject:snapshot options:0 error:nil];
+            double encodeTime = (now() - start) * 1000;
+
+            start = now();
+            BOOL written = [api writeSnapshotFile:data :path];
+            double writeTime = (now() - start) * 1000;
+
+            start = now();
+            BOOL restored = written && [api restoreSnapshot];
+            double restoreTime = (now() - start) * 1000;
+
+            if (!restored || [api mirroredRecords:kFleetMirrorTypeDevice].count != count) printf("FAILED: snapshot not restored\n");
+
+            printf("%10lu %12lu %12.1f %12.1f %12.1f\n", (unsigned long)count, (unsigned long)data.length, encodeTime, writeTime, restoreTime);
+
+            [api logout];
+        }
+    }
+}
+
+
+
+static void benchRecords(void)
+{
+    // Decode a list of 'kBenchRecordDevices' complete device records, page by page, as the instance does,
+    // keeping the decoded records, and compare the growth in resident memory. The projected CompactRecords
+    // are decoded first: memory they free may be re-used by the plain records, which are then under-counted
+
+    NSMutableArray *pages = [[NSMutableArray alloc] init];
+    NSUInteger length = 0;
+
+    @autoreleasepool
+    {
+        NSArray *records = makeDeviceRecords(kBenchRecordDevices, YES);
+
+        for (NSUInteger i = 0 ; i < records.count ; i += kBenchRecordPageSize)
+        {
+            NSArray *page = [records subarrayWithRange:NSMakeRange(i, MIN(kBenchRecordPageSize, records.count - i))];
+            NSData *data = [NSJSONSerialization dataWithJSONObject:@{ @"data" : page, @"links" : @{} } options:0 error:nil];
+            [pages addObject:data];
+            length += data.length;
+        }
+    }
+
+    NSArray *fields = @[ @"name", @"device_online", @"devicegroup" ];
+    double held[2] = { 0, 0 };
+
+    printf("Device records (%lu devices, %lu bytes of JSON)\n", (unsigned long)kBenchRecordDevices, (unsigned long)length);
+    printf("%28s %12s %12s %10s\n", "records", "MB held", "ms", "decoded");
+
+    for (NSInteger v = 1 ; v >= 0 ; --v)
+    {
+        @autoreleasepool
+        {
+            CompactRecordDecoder *decoder = (v == 1) ? [[CompactRecordDecoder alloc] init] : nil;
+            NSMutableArray *list = [[NSMutableArray alloc] initWithCapacity:kBenchRecordDevices];
+            double before = residentMB();
+            NSTimeInterval start = now();
+
+            for (NSData *page in pages)
+            {
+                @autoreleasepool
+                {
+                    JSONListParser *parser = [[JSONListParser alloc] init];
+                    parser.decoder = decoder;
+                    parser.fields = (v == 1) ? [NSSet setWithArray:fields] : nil;
+
+                    [parser parseData:page];
+                    [list addObjectsFromArray:[[parser result] objectForKey:@"data"]];
+                }
+            }
+
+            // The instance empties the table of shared strings once a list is complete
+
+            [decoder clear];
+
+            NSTimeInterval elapsed = now() - start;
+            held[v] = residentMB() - before;
+
+            printf("%28s %12.1f %12.1f %10lu%s\n", (v == 1 ? "listFields + CompactRecord" : "plain"),
+                   held[v], elapsed * 1000, (unsigned long)list.count,
+                   (list.count == kBenchRecordDevices ? "" : "  FAILED: records lost"));
+        }
+    }
+
+    if (held[1] > 0) printf("Plain records hold %.1fx the memory of projected CompactRecords\n", held[0] / held[1]);
+}
+
+
+
+int main(int argc, const char *argv[])
+{
+    @autoreleasepool
+    {
+        NSArray *args = [[NSProcessInfo processInfo].arguments subarrayWithRange:NSMakeRange(1, argc - 1)];
+        BOOL all = (args.count == 0);
+
+        if (all || [args containsObject:@"registry"]) benchRegistry();
+        if (all || [args containsObject:@"sse"]) benchStreamParsing();
+        if (all || [args containsObject:@"snapshot"]) benchSnapshot();
+        if (all || [args containsObject:@"records"]) benchRecords();
+    }
+
+    return 0;
+}
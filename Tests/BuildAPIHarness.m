@@ -0,0 +1,358 @@
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+//  Drives BuildAPIAccess against the mock impCentral server (mock_impcentral.py) and reports:
+//    - how long it takes to list the whole fleet
+//    - how many device requests per second it completes, and their latency
+//    - how many log events per second it receives from a log stream
+//    - the process' peak resident memory
+//
+//  With '-m', it also checks that no request takes longer than the given time. Run the mock server
+//  with a short token lifetime, eg. '--token-lifetime 60', and the harness for longer than the
+//  time to the first refresh, to check that requests don't stall while the token is refreshed
+//
+//  Usage: BuildAPIHarness [-e endpoint] [-s seconds] [-c concurrent requests] [-l devices to log]
+//                         [-p page size] [-m maximum request latency in ms]
+
+
+
+#import <Foundation/Foundation.h>
+#import <sys/resource.h>
+#import "../BuildAPIAccess.h"
+
+
+#define kHarnessDefaultEndpoint     @"http://127.0.0.1:8080/v5/"
+#define kHarnessTimeout             60.0
+
+
+
+static NSTimeInterval now(void)
+{
+    return [NSProcessInfo processInfo].systemUptime;
+}
+
+
+
+static double peakMemoryMB(void)
+{
+    // Peak resident set size. NOTE macOS reports this in bytes, Linux in kilobytes
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+    return usage.ru_maxrss / 1024.0;
+#endif
+}
+
+
+
+static BOOL waitFor(dispatch_semaphore_t semaphore, NSTimeInterval timeout)
+{
+    return (dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeout * NSEC_PER_SEC))) == 0);
+}
+
+
+
+static NSString *option(NSArray *args, NSString *flag, NSString *defaultValue)
+{
+    NSUInteger index = [args indexOfObject:flag];
+
+    if (index == NSNotFound || index + 1 >= args.count) return defaultValue;
+    return [args objectAtIndex:(index + 1)];
+}
+
+
+
+static double percentile(NSArray *sortedLatencies, double p)
+{
+    if (sortedLatencies.count == 0) return 0;
+
+    NSUInteger index = (NSUInteger)(p * (sortedLatencies.count - 1));
+    return [[sortedLatencies objectAtIndex:index] doubleValue];
+}
+
+
+
+static NSDictionary *serverStats(NSString *endpoint)
+{
+    // Ask the mock server for its counts of responses, log events and token refreshes
+
+    NSURL *url = [NSURL URLWithString:@"/mock/stats" relativeToURL:[NSURL URLWithString:endpoint]];
+    NSData *data = [NSData dataWithContentsOfURL:url];
+
+    return data != nil ? [NSJSONSerialization JSONObjectWithData:data options:0 error:nil] : nil;
+}
+
+
+
+static BOOL checkStalls(NSArray *sortedLatencies, double limit, NSString *endpoint)
+{
+    // Check that no request waited longer than 'limit' milliseconds, eg. for a new access token,
+    // and that none was rejected for using an expired one. The check only means something if the
+    // token was refreshed during the run
+
+    NSDictionary *stats = serverStats(endpoint);
+    NSUInteger refreshes = [[stats objectForKey:@"token_refreshes"] unsignedIntegerValue];
+    NSUInteger rejected = [[[stats objectForKey:@"responses"] objectForKey:@"401"] unsignedIntegerValue];
+    double slowest = percentile(sortedLatencies, 1.0) * 1000;
+    BOOL passed = (sortedLatencies.count > 0 && slowest <= limit && refreshes > 0 && rejected == 0);
+
+    printf("Stall check:    %s (slowest %.1f ms, limit %.0f ms, %lu token refreshes, %lu rejected requests)\n",
+           (passed ? "PASSED" : "FAILED"), slowest, limit, (unsigned long)refreshes, (unsigned long)rejected);
+
+    if (refreshes == 0) printf("                No token refresh was made: use a shorter token lifetime or a longer run\n");
+
+    return passed;
+}
+
+
+
+static BOOL login(BuildAPIAccess *api, NSString *endpoint)
+{
+    // Log in to the mock server, which accepts any credentials
+
+    dispatch_semaphore_t done = dispatch_semaphore_create(0);
+    NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
+    __block BOOL success = NO;
+
+    id loggedIn = [nc addObserverForName:@"BuildAPILoggedIn" object:nil queue:nil usingBlock:^(NSNotification *note) {
+        success = YES;
+        dispatch_semaphore_signal(done);
+    }];
+
+    id rejected = [nc addObserverForName:@"BuildAPILoginRejected" object:nil queue:nil usingBlock:^(NSNotification *note) {
+        dispatch_semaphore_signal(done);
+    }];
+
+    id failed = [nc addObserverForName:@"BuildAPIError" object:nil queue:nil usingBlock:^(NSNotification *note) {
+        dispatch_semaphore_signal(done);
+    }];
+
+    [api setEndpoint:endpoint];
+    [api login:@"harness" :@"harness" :0];
+
+    waitFor(done, kHarnessTimeout);
+
+    [nc removeObserver:loggedIn];
+    [nc removeObserver:rejected];
+    [nc removeObserver:failed];
+
+    return success;
+}
+
+
+
+static NSArray *listFleet(BuildAPIAccess *api, dispatch_queue_t queue)
+{
+    // Time a full-fleet device list, ie. every page
+
+    dispatch_semaphore_t done = dispatch_semaphore_create(0);
+    __block NSArray *devices = nil;
+
+    NSTimeInterval start = now();
+
+    [api getDevicesWithCompletion:queue :^(NSDictionary *result, NSDictionary *error) {
+        if (error == nil) devices = [result objectForKey:@"data"];
+        dispatch_semaphore_signal(done);
+    }];
+
+    if (!waitFor(done, kHarnessTimeout * 10) || devices == nil)
+    {
+        printf("Fleet list:     FAILED (%s)\n", api.errorMessage.UTF8String);
+        return nil;
+    }
+
+    NSTimeInterval elapsed = now() - start;
+
+    printf("Fleet list:     %lu devices in %.3f s (%.0f devices/s)\n",
+           (unsigned long)devices.count, elapsed, devices.count / elapsed);
+
+    return devices;
+}
+
+
+
+static NSArray *measureRequests(BuildAPIAccess *api, dispatch_queue_t queue, NSArray *deviceIDs, NSUInteger concurrency, NSTimeInterval duration, BOOL *completed)
+{
+    // Keep 'concurrency' single-device requests in flight for 'duration' seconds and record
+    // each one's latency. Returns the latencies, sorted. 'completed' is set to NO if any
+    // request had still not completed 'kHarnessTimeout' seconds after the last was sent
+
+    NSMutableArray *latencies = [[NSMutableArray alloc] init];
+    dispatch_semaphore_t slots = dispatch_semaphore_create(concurrency);
+    dispatch_group_t group = dispatch_group_create();
+    __block NSUInteger failures = 0;
+    NSUInteger sent = 0;
+
+    NSTimeInterval start = now();
+
+    while (now() - start < duration)
+    {
+        if (!waitFor(slots, 1.0)) continue;
+
+        NSString *deviceID = [deviceIDs objectAtIndex:(sent % deviceIDs.count)];
+        NSTimeInterval requested = now();
+        ++sent;
+
+        dispatch_group_enter(group);
+
+        [api getDeviceWithCompletion:deviceID :queue :^(NSDictionary *result, NSDictionary *error) {
+            if (error == nil)
+            {
+                [latencies addObject:[NSNumber numberWithDouble:(now() - requested)]];
+            }
+            else
+            {
+                ++failures;
+            }
+
+            dispatch_semaphore_signal(slots);
+            dispatch_group_leave(group);
+        }];
+    }
+
+    long timedOut = dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kHarnessTimeout * NSEC_PER_SEC)));
+
+    NSTimeInterval elapsed = now() - start;
+
+    // The results are recorded on 'queue', and after a time-out requests may still be completing,
+    // so take them there. Requests which have yet to complete are counted as failures
+
+    __block NSArray *sorted = nil;
+    __block NSUInteger failed = 0;
+    __block NSUInteger unfinished = 0;
+
+    dispatch_sync(queue, ^{
+        sorted = [latencies sortedArrayUsingSelector:@selector(compare:)];
+        unfinished = sent - sorted.count - failures;
+        failed = failures + unfinished;
+    });
+
+    *completed = (timedOut == 0);
+
+    printf("Requests:       %lu completed, %lu failed in %.3f s (%.1f requests/s)\n",
+           (unsigned long)sorted.count, (unsigned long)failed, elapsed, sorted.count / elapsed);
+
+    if (timedOut != 0) printf("Requests:       FAILED: %lu requests timed out\n", (unsigned long)unfinished);
+
+    printf("Latency:        p50 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+           percentile(sorted, 0.5) * 1000, percentile(sorted, 0.99) * 1000, percentile(sorted, 1.0) * 1000);
+
+    return sorted;
+}
+
+
+
+static void measureLogging(BuildAPIAccess *api, NSArray *deviceIDs, NSUInteger count, NSTimeInterval duration)
+{
+    // Stream 'count' devices' logs for 'duration' seconds and count the events received
+
+    NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
+    __block NSUInteger events = 0;
+    __block NSTimeInterval firstEvent = 0;
+
+    id observer = [nc addObserverForName:@"BuildAPILogEntryReceived" object:nil queue:nil usingBlock:^(NSNotification *note) {
+        if (events == 0) firstEvent = now();
+        ++events;
+    }];
+
+    for (NSUInteger i = 0 ; i < count && i < deviceIDs.count ; ++i) [api startLogging:[deviceIDs objectAtIndex:i]];
+
+    [NSThread sleepForTimeInterval:duration];
+
+    [api performOnProcessingQueueAndWait:^{
+        NSTimeInterval elapsed = events > 0 ? now() - firstEvent : 0;
+
+        printf("Log stream:     %lu events in %.3f s (%.1f events/s)\n",
+               (unsigned long)events, elapsed, elapsed > 0 ? events / elapsed : 0);
+    }];
+
+    [nc removeObserver:observer];
+
+    for (NSUInteger i = 0 ; i < count && i < deviceIDs.count ; ++i) [api stopLogging:[deviceIDs objectAtIndex:i]];
+}
+
+
+
+int main(int argc, const char *argv[])
+{
+    @autoreleasepool
+    {
+        NSArray *args = [NSProcessInfo processInfo].arguments;
+        NSString *endpoint = option(args, @"-e", kHarnessDefaultEndpoint);
+        NSTimeInterval duration = [option(args, @"-s", @"10") doubleValue];
+        NSUInteger concurrency = (NSUInteger)[option(args, @"-c", @"8") integerValue];
+        NSUInteger loggedDevices = (NSUInteger)[option(args, @"-l", @"1") integerValue];
+        NSInteger pageSize = [option(args, @"-p", @"100") integerValue];
+        double latencyLimit = [option(args, @"-m", @"0") doubleValue];
+        BOOL passed = YES;
+
+        // State is managed on a private queue, so this thread can wait on results.
+        // Completion handlers are called on another, serial queue
+
+        BuildAPIAccess *api = [[BuildAPIAccess alloc] init];
+        api.processingQueue = dispatch_queue_create("com.bps.buildapiaccess.harness", DISPATCH_QUEUE_SERIAL);
+        api.useResponseCache = NO;
+        api.coalesceReads = NO;
+        api.collectMetrics = YES;
+
+        dispatch_queue_t queue = dispatch_queue_create("com.bps.buildapiaccess.harness.results", DISPATCH_QUEUE_SERIAL);
+
+        printf("BuildAPIAccess %s harness against %s\n", kBuildAPIAccessVersion.UTF8String, endpoint.UTF8String);
+
+        if (!login(api, endpoint))
+        {
+            printf("Login:          FAILED (%s)\n", api.errorMessage.UTF8String);
+            return 1;
+        }
+
+        api.pageSize = pageSize;
+
+        NSArray *devices = listFleet(api, queue);
+
+        if (devices.count == 0) return 1;
+
+        NSMutableArray *deviceIDs = [[NSMutableArray alloc] initWithCapacity:devices.count];
+
+        for (id device in devices) [deviceIDs addObject:[device valueForKey:@"id"]];
+
+        BOOL completed = YES;
+        NSArray *latencies = measureRequests(api, queue, deviceIDs, concurrency, duration, &completed);
+
+        if (latencyLimit > 0) passed = checkStalls(latencies, latencyLimit, endpoint);
+        if (!completed) passed = NO;
+
+        if (loggedDevices > 0) measureLogging(api, deviceIDs, loggedDevices, duration);
+
+        printf("Peak memory:    %.1f MB\n", peakMemoryMB());
+
+        [api logout];
+
+        return passed ? 0 : 1;
+    }
+}
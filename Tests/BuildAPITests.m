@@ -0,0 +1,473 @@
+//  BuildAPIAccess 3.3.0
+//  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+//  Issued under the MIT licence:
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+
+
+//  Unit tests of BuildAPIAccess components that need no server: the log stream parser,
+//  access token expiry and the request queue. Prints each failed check and exits with a non-zero status if there are any
+//
+//  Usage: BuildAPITests
+
+
+
+#import <Foundation/Foundation.h>
+#import "../BuildAPIAccess.h"
+#import "../LogStreamParser.h"
+
+
+// A BuildAPIAccess whose access token can be set directly
+
+@interface TokenTestAccess : BuildAPIAccess
+
+- (void)setTestToken:(Token *)aToken;
+
+@end
+
+
+
+@implementation TokenTestAccess
+
+
+- (void)setTestToken:(Token *)aToken
+{
+    token = aToken;
+}
+
+
+@end
+
+
+
+static NSUInteger checks = 0;
+static NSUInteger failures = 0;
+
+#define CHECK(condition, description) check((condition), (description), __LINE__)
+
+
+
+static void check(BOOL condition, NSString *description, int line)
+{
+    ++checks;
+
+    if (!condition)
+    {
+        ++failures;
+        printf("FAILED (line %i): %s\n", line, description.UTF8String);
+    }
+}
+
+
+
+static NSData *bytes(const char *string)
+{
+    return [NSData dataWithBytes:string length:strlen(string)];
+}
+
+
+
+static NSArray *parseChunks(LogStreamParser *parser, NSArray *chunks)
+{
+    // Feed the parser each chunk in turn and collect the events they complete
+
+    NSMutableArray *events = [[NSMutableArray alloc] init];
+
+    for (NSData *chunk in chunks)
+    {
+        NSArray *parsed = [parser parseData:chunk];
+        if (parsed != nil) [events addObjectsFromArray:parsed];
+    }
+
+    return events;
+}
+
+
+
+static NSArray *parseSplit(NSData *data, NSUInteger chunkSize)
+{
+    // Parse the data with a new parser, delivered in chunks of the specified size
+
+    NSMutableArray *chunks = [[NSMutableArray alloc] init];
+
+    for (NSUInteger i = 0 ; i < data.length ; i += chunkSize)
+    {
+        NSUInteger length = MIN(chunkSize, data.length - i);
+        [chunks addObject:[data subdataWithRange:NSMakeRange(i, length)]];
+    }
+
+    return parseChunks([[LogStreamParser alloc] init], chunks);
+}
+
+
+
+static NSString *dataOf(NSArray *events, NSUInteger index)
+{
+    if (index >= events.count) return nil;
+
+    LogStreamEvent *event = [events objectAtIndex:index];
+    return event.data;
+}
+
+
+
+#pragma mark - LogStreamParser Tests
+
+
+static void testLineEndings(void)
+{
+    // SSE lines may end in LF, CR or CRLF, and a stream may mix them
+
+    NSArray *events = parseSplit(bytes("event: message\ndata: lf\n\n"), 1024);
+    CHECK(events.count == 1, @"LF: one event");
+    CHECK([dataOf(events, 0) isEqualToString:@"lf"], @"LF: data");
+    CHECK([((LogStreamEvent *)events.firstObject).event isEqualToString:@"message"], @"LF: event name");
+    CHECK(((LogStreamEvent *)events.firstObject).type == kLogStreamEventTypeMessage, @"LF: message type");
+
+    events = parseSplit(bytes("event: message\rdata: cr\r\r"), 1024);
+    CHECK(events.count == 1, @"CR: one event");
+    CHECK([dataOf(events, 0) isEqualToString:@"cr"], @"CR: data");
+
+    events = parseSplit(bytes("event: message\r\ndata: crlf\r\n\r\n"), 1024);
+    CHECK(events.count == 1, @"CRLF: one event, not one per line end");
+    CHECK([dataOf(events, 0) isEqualToString:@"crlf"], @"CRLF: data");
+
+    events = parseSplit(bytes("data: one\n\ndata: two\r\rdata: three\r\n\r\n"), 1024);
+    CHECK(events.count == 3, @"Mixed: three events");
+    CHECK([dataOf(events, 2) isEqualToString:@"three"], @"Mixed: last event's data");
+}
+
+
+
+static void testCRLFSplitAcrossChunks(void)
+{
+    // A CRLF pair split between chunks must count as one line end, not two
+
+    LogStreamParser *parser = [[LogStreamParser alloc] init];
+    NSArray *events = parseChunks(parser, @[ bytes("data: a\r"), bytes("\n\r"), bytes("\ndata: b\r\n\r"), bytes("\n") ]);
+
+    CHECK(events.count == 2, @"Split CRLF: two events");
+    CHECK([dataOf(events, 0) isEqualToString:@"a"], @"Split CRLF: first event's data");
+    CHECK([dataOf(events, 1) isEqualToString:@"b"], @"Split CRLF: second event's data");
+
+    // A lone CR at the end of a chunk followed by a new line is still a line end
+
+    parser = [[LogStreamParser alloc] init];
+    events = parseChunks(parser, @[ bytes("data: a\r"), bytes("\rdata: b\r\r") ]);
+
+    CHECK(events.count == 2, @"CR then CR across chunks: two events");
+}
+
+
+
+static void testUTF8SplitAcrossChunks(void)
+{
+    // A multi-byte UTF-8 sequence split between chunks must be decoded intact
+
+    NSString *message = @"2000000000000003 2019-09-06T10:00:00.000Z development server.log Température ✓ 🚀";
+    NSData *stream = [[NSString stringWithFormat:@"event: message\ndata: %@\n\n", message] dataUsingEncoding:NSUTF8StringEncoding];
+
+    for (NSUInteger size = 1 ; size <= 8 ; ++size)
+    {
+        NSArray *events = parseSplit(stream, size);
+
+        CHECK(events.count == 1, ([NSString stringWithFormat:@"Split UTF-8 (%lu-byte chunks): one event", (unsigned long)size]));
+        CHECK([dataOf(events, 0) isEqualToString:message], ([NSString stringWithFormat:@"Split UTF-8 (%lu-byte chunks): data intact", (unsigned long)size]));
+    }
+
+    // Split inside the four-byte sequence of the emoji, at each of its byte boundaries
+
+    NSUInteger emoji = [stream rangeOfData:[@"🚀" dataUsingEncoding:NSUTF8StringEncoding] options:0 range:NSMakeRange(0, stream.length)].location;
+
+    for (NSUInteger offset = 1 ; offset < 4 ; ++offset)
+    {
+        NSUInteger split = emoji + offset;
+        LogStreamParser *parser = [[LogStreamParser alloc] init];
+        NSArray *events = parseChunks(parser, @[ [stream subdataWithRange:NSMakeRange(0, split)],
+                                                 [stream subdataWithRange:NSMakeRange(split, stream.length - split)] ]);
+
+        CHECK([dataOf(events, 0) isEqualToString:message], @"Split UTF-8 inside a four-byte sequence: data intact");
+    }
+}
+
+
+
+static void testFields(void)
+{
+    // Multi-line data, comments, ids, retry intervals and field syntax
+
+    NSArray *events = parseSplit(bytes("data: first\ndata: second\ndata: third\n\n"), 1024);
+    CHECK([dataOf(events, 0) isEqualToString:@"first\nsecond\nthird"], @"Multi-line data is joined with newlines");
+
+    events = parseSplit(bytes(": keep-alive\n\n"), 1024);
+    CHECK(events.count == 0, @"A comment alone is not an event");
+
+    events = parseSplit(bytes("data: a\n: comment\ndata: b\n\n"), 1024);
+    CHECK([dataOf(events, 0) isEqualToString:@"a\nb"], @"A comment inside an event is ignored");
+
+    events = parseSplit(bytes("event: message\n\n"), 1024);
+    CHECK(events.count == 0, @"An event without data is discarded");
+
+    events = parseSplit(bytes("data:no space\n\ndata:  two spaces\n\ndata\n\n"), 1024);
+    CHECK(events.count == 3, @"Field syntax: three events");
+    CHECK([dataOf(events, 0) isEqualToString:@"no space"], @"The space after the colon is optional");
+    CHECK([dataOf(events, 1) isEqualToString:@" two spaces"], @"Only one space after the colon is removed");
+    CHECK([dataOf(events, 2) isEqualToString:@""], @"A field name without a colon has an empty value");
+
+    LogStreamParser *parser = [[LogStreamParser alloc] init];
+    events = parseChunks(parser, @[ bytes("id: 42\nretry: 2500\ndata: x\n\n") ]);
+    CHECK([parser.lastEventID isEqualToString:@"42"], @"The id field sets the last event ID");
+    CHECK([((LogStreamEvent *)events.firstObject).eid isEqual:@"42"], @"An event carries the last event ID");
+    CHECK(parser.retryInterval == 2.5, @"The retry field is in milliseconds");
+
+    parseChunks(parser, @[ bytes("retry: 1e3\ndata: y\n\n") ]);
+    CHECK(parser.retryInterval == 2.5, @"A retry field that is not all digits is ignored");
+
+    parseChunks(parser, @[ bytes("data: z\n\n") ]);
+    CHECK([parser.lastEventID isEqualToString:@"42"], @"The last event ID persists between events");
+}
+
+
+
+static void testBOM(void)
+{
+    // A leading UTF-8 byte order mark is ignored, even when split across chunks
+
+    NSArray *events = parseSplit(bytes("\xEF\xBB\xBF" "data: x\n\n"), 1024);
+    CHECK(events.count == 1 && [dataOf(events, 0) isEqualToString:@"x"], @"BOM is skipped");
+
+    events = parseSplit(bytes("\xEF\xBB\xBF" "data: x\n\n"), 1);
+    CHECK(events.count == 1 && [dataOf(events, 0) isEqualToString:@"x"], @"BOM split across chunks is skipped");
+
+    events = parseSplit(bytes("data: x\n\n" "\xEF\xBB\xBF" "data: y\n\n"), 1024);
+    CHECK(events.count == 1, @"A BOM after the start of the stream is part of the field name");
+}
+
+
+
+static void testStateChanges(void)
+{
+    NSArray *events = parseSplit(bytes("event: state_change\ndata: opened\n\n"
+                                       "event: state_change\ndata: 2000000000000003 subscribed\n\n"
+                                       "event: state_change\ndata: 2000000000000003 unsubscribed\n\n"
+                                       "event: state_change\ndata: closed\n\n"), 7);
+
+    NSInteger expected[] = { kLogStreamEventStateOpen, kLogStreamEventStateSubscribed, kLogStreamEventStateUnsubscribed, kLogStreamEventStateClosed };
+
+    CHECK(events.count == 4, @"State changes: four events");
+
+    for (NSUInteger i = 0 ; i < events.count && i < 4 ; ++i)
+    {
+        LogStreamEvent *event = [events objectAtIndex:i];
+        CHECK(event.type == kLogStreamEventTypeStateChange, @"State change: type");
+        CHECK(event.state == expected[i], ([NSString stringWithFormat:@"State change: '%@' state", event.data]));
+    }
+}
+
+
+
+static void testLongStream(void)
+{
+    // Many events in odd-sized chunks, so the buffer is compacted with a partial line held
+
+    NSMutableData *stream = [[NSMutableData alloc] init];
+    NSUInteger count = 2000;
+
+    for (NSUInteger i = 0 ; i < count ; ++i)
+    {
+        NSString *event = [NSString stringWithFormat:@"id: %lu\r\nevent: message\r\ndata: entry %lu – ✓\r\n\r\n", (unsigned long)i, (unsigned long)i];
+        [stream appendData:[event dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+
+    NSArray *events = parseSplit(stream, 997);
+    BOOL inOrder = (events.count == count);
+
+    for (NSUInteger i = 0 ; inOrder && i < count ; ++i)
+    {
+        inOrder = [dataOf(events, i) isEqualToString:[NSString stringWithFormat:@"entry %lu – ✓", (unsigned long)i]];
+    }
+
+    CHECK(events.count == count, @"Long stream: every event parsed");
+    CHECK(inOrder, @"Long stream: events intact and in order");
+}
+
+
+
+#pragma mark - Access Token Tests
+
+
+static Token *makeToken(NSInteger lifetime, NSString *expiryDate)
+{
+    Token *aToken = [[Token alloc] init];
+    aToken.accessToken = @"token";
+    aToken.lifetime = lifetime;
+    aToken.expiryDate = expiryDate;
+    return aToken;
+}
+
+
+
+static void testTokenValidity(void)
+{
+    TokenTestAccess *api = [[TokenTestAccess alloc] init];
+
+    CHECK(![api isAccessTokenValid], @"No token is not a valid token");
+    CHECK(![[Token alloc] init].hasExpiryTime, @"A new token has no expiry time");
+
+    // A token due for refresh, ie. within 'kTokenRefreshLead' of expiry, is still used for requests:
+    // they must not wait for the new token until the current one is within 'kTokenExpiryMargin'
+
+    Token *aToken = makeToken((NSInteger)(kTokenRefreshLead - 40), @"");
+    [api setTestToken:aToken];
+    CHECK([api isAccessTokenValid], @"A token due for refresh remains valid");
+    CHECK(aToken.hasExpiryTime, @"Checking a token records its expiry time");
+
+    [api setTestToken:makeToken((NSInteger)(kTokenExpiryMargin / 2), @"")];
+    CHECK(![api isAccessTokenValid], @"A token within the expiry margin is not valid");
+
+    // Without a lifetime, the expiry date is used. One that can't be read makes the token invalid,
+    // so that a new one is requested rather than the server rejecting the next request
+
+    NSDateFormatter *formatter = [[NSDateFormatter alloc] init];
+    formatter.dateFormat = @"yyyy-MM-dd'T'HH:mm:ss.SSSZZZZZZ";
+    formatter.timeZone = [NSTimeZone timeZoneWithAbbreviation:@"UTC"];
+
+    [api setTestToken:makeToken(0, [formatter stringFromDate:[NSDate dateWithTimeIntervalSinceNow:3600]])];
+    CHECK([api isAccessTokenValid], @"A token with a future expiry date is valid");
+
+    [api setTestToken:makeToken(0, [formatter stringFromDate:[NSDate dateWithTimeIntervalSinceNow:-60]])];
+    CHECK(![api isAccessTokenValid], @"A token with a past expiry date is not valid");
+
+    aToken = makeToken(0, @"not a date");
+    [api setTestToken:aToken];
+    CHECK(![api isAccessTokenValid], @"A token with an unreadable expiry date is not valid");
+    CHECK(aToken.hasExpiryTime, @"An unreadable expiry date still records an expiry time");
+
+    [api setTestToken:makeToken(0, @"")];
+    CHECK(![api isAccessTokenValid], @"A token with no expiry is not valid");
+
+    // The expiry time is calculated once, and again only when 'hasExpiryTime' is reset,
+    // as it is when a new token is received
+
+    aToken = makeToken(3600, @"");
+    [api setTestToken:aToken];
+    CHECK([api isAccessTokenValid], @"A long-lived token is valid");
+
+    aToken.lifetime = 1;
+    CHECK([api isAccessTokenValid], @"The expiry time is not recalculated while it is set");
+
+    aToken.hasExpiryTime = NO;
+    CHECK(![api isAccessTokenValid], @"The expiry time is recalculated once reset");
+}
+
+
+
+#pragma mark - Request Queue Tests
+
+
+static Connexion *makeQueuedConnexion(NSInteger priority)
+{
+    Connexion *connexion = [[Connexion alloc] init];
+    connexion.actionCode = kConnectTypeGetDevice;
+    connexion.priority = priority;
+    return connexion;
+}
+
+
+
+static void testRequestQueue(void)
+{
+    // Requests are queued directly, so none is sent. Rejections are reported asynchronously on the
+    // processing queue, so an empty block is run on it to wait for them
+
+    BuildAPIAccess *api = [[BuildAPIAccess alloc] init];
+    api.processingQueue = dispatch_queue_create("com.bps.buildapiaccess.tests", DISPATCH_QUEUE_SERIAL);
+
+    __block NSUInteger errors = 0;
+    id observer = [[NSNotificationCenter defaultCenter] addObserverForName:@"BuildAPIError" object:nil queue:nil usingBlock:^(NSNotification *note) {
+        ++errors;
+    }];
+
+    // By default the queue has no limit: every request waits its turn, as it was once sent at once
+
+    CHECK(api.maxQueuedConnections == 0, @"The queue has no limit by default");
+
+    __block NSUInteger queued = 0;
+    [api performOnProcessingQueueAndWait:^{
+        for (NSUInteger i = 0 ; i < 1000 ; ++i) [api queueConnexion:makeQueuedConnexion(kConnectPriorityInteractive)];
+        queued = [api numberOfQueuedConnexions];
+    }];
+    [api performOnProcessingQueueAndWait:^{}];
+
+    CHECK(queued == 1000, @"Without a limit, every request is queued");
+    CHECK(errors == 0, @"Without a limit, no request is turned away");
+
+    // With a limit, a request beyond it displaces the latest lower-priority request, if there is one,
+    // and is otherwise turned away itself
+
+    api = [[BuildAPIAccess alloc] init];
+    api.processingQueue = dispatch_queue_create("com.bps.buildapiaccess.tests", DISPATCH_QUEUE_SERIAL);
+    api.maxQueuedConnections = 4;
+    errors = 0;
+
+    [api performOnProcessingQueueAndWait:^{
+        for (NSUInteger i = 0 ; i < 4 ; ++i) [api queueConnexion:makeQueuedConnexion(kConnectPriorityBackground)];
+        [api queueConnexion:makeQueuedConnexion(kConnectPriorityInteractive)];
+        queued = [api numberOfQueuedConnexions];
+    }];
+    [api performOnProcessingQueueAndWait:^{}];
+
+    CHECK(queued == 4, @"A full queue stays at its limit");
+    CHECK(errors == 1, @"A displaced lower-priority request is reported");
+
+    [api performOnProcessingQueueAndWait:^{
+        [api queueConnexion:makeQueuedConnexion(kConnectPriorityBackground)];
+        queued = [api numberOfQueuedConnexions];
+    }];
+    [api performOnProcessingQueueAndWait:^{}];
+
+    CHECK(queued == 4, @"A request with nothing to displace is not queued");
+    CHECK(errors == 2, @"A request with nothing to displace is reported");
+
+    [[NSNotificationCenter defaultCenter] removeObserver:observer];
+}
+
+
+
+int main(int argc, const char *argv[])
+{
+    @autoreleasepool
+    {
+        testLineEndings();
+        testCRLFSplitAcrossChunks();
+        testUTF8SplitAcrossChunks();
+        testFields();
+        testBOM();
+        testStateChanges();
+        testLongStream();
+        testTokenValidity();
+        testRequestQueue();
+
+        printf("%lu checks, %lu failed\n", (unsigned long)checks, (unsigned long)failures);
+    }
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,520 @@
+#!/usr/bin/env python3
+#
+#  BuildAPIAccess 3.3.0
+#  Copyright (c) 2017-19 Tony Smith. All rights reserved.
+#  Issued under the MIT licence (see LICENSE)
+#
+#  A local stand-in for the impCentral API, used by the harness and benchmarks in
+#  this directory. It serves the parts of the v5 API that BuildAPIAccess uses for
+#  fleet work: log in and token refresh, the account, paged product, device group,
+#  device and deployment lists, device updates and deletes, and log streams, which
+#  emit messages at a set rate. It can also add latency and rate-limit requests.
+#
+#  Point BuildAPIAccess at it with: [api setEndpoint:@"http://127.0.0.1:8080/v5/"]
+#
+#  Usage: mock_impcentral.py [--port 8080] [--devices 10000] [--products 20]
+#                            [--groups 100] [--deployments 500] [--latency 0.05]
+#                            [--log-rate 100] [--token-lifetime 3600]
+#                            [--rate-limit 0] [--max-page-size 100]
+
+import argparse
+import json
+import re
+import threading
+import time
+import uuid
+from datetime import datetime, timedelta, timezone
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, unquote, urlsplit
+
+
+API_PREFIX = "/v5/"
+
+
+def iso_time(when):
+    # ISO 8601 UTC, in the form impCentral uses
+
+    return when.strftime("%Y-%m-%dT%H:%M:%S.") + "%03dZ" % (when.microsecond // 1000)
+
+
+class Fleet:
+    # The records the server holds. Created once, up front, so that list timings
+    # measure paging and transfer rather than record construction
+
+    def __init__(self, args):
+        self.lock = threading.Lock()
+        self.products = []
+        self.groups = []
+        self.devices = []
+        self.deployments = []
+
+        for i in range(args.products):
+            self.products.append({
+                "type": "product",
+                "id": str(uuid.UUID(int=0x10000000 + i)),
+                "attributes": {"name": "Product %d" % i, "description": ""},
+                "relationships": {"owner": {"type": "account", "id": "mock-account"}}
+            })
+
+        for i in range(args.groups):
+            product = self.products[i % len(self.products)] if self.products else None
+            self.groups.append({
+                "type": "development_devicegroup",
+                "id": str(uuid.UUID(int=0x20000000 + i)),
+                "attributes": {"name": "Device Group %d" % i, "description": "", "env_vars": {}},
+                "relationships": {"product": {"type": "product", "id": product["id"]} if product else None}
+            })
+
+        for i in range(args.devices):
+            group = self.groups[i % len(self.groups)] if self.groups else None
+            self.devices.append({
+                "type": "device",
+                "id": "%016x" % (0x2000000000000000 + i),
+                "attributes": {
+                    "name": "Device %d" % i,
+                    "mac_address": "0c:2a:69:%02x:%02x:%02x" % ((i >> 16) & 0xFF, (i >> 8) & 0xFF, i & 0xFF),
+                    "device_online": i % 7 != 0,
+                    "agent_id": "agent%08d" % i,
+                    "imp_type": "imp005",
+                    "swversion": "43.0.0"
+                },
+                "relationships": {"devicegroup": {"type": group["type"], "id": group["id"]} if group else None}
+            })
+
+        for i in range(args.deployments):
+            group = self.groups[i % len(self.groups)] if self.groups else None
+            self.deployments.append({
+                "type": "deployment",
+                "id": str(uuid.UUID(int=0x30000000 + i)),
+                "attributes": {"sha": "%040x" % i, "description": "Deployment %d" % i, "tags": []},
+                "relationships": {"devicegroup": {"type": group["type"], "id": group["id"]} if group else None}
+            })
+
+        self.collections = {
+            "products": self.products,
+            "devicegroups": self.groups,
+            "devices": self.devices,
+            "deployments": self.deployments
+        }
+
+
+class Streams:
+    # Open log streams: stream ID -> the device IDs subscribed to it
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.devices = {}
+
+    def create(self):
+        stream_id = uuid.uuid4().hex
+
+        with self.lock:
+            self.devices[stream_id] = []
+
+        return stream_id
+
+    def subscribe(self, stream_id, device_id):
+        with self.lock:
+            if stream_id not in self.devices: return False
+            if device_id not in self.devices[stream_id]: self.devices[stream_id].append(device_id)
+            return True
+
+    def unsubscribe(self, stream_id, device_id):
+        with self.lock:
+            if stream_id in self.devices and device_id in self.devices[stream_id]:
+                self.devices[stream_id].remove(device_id)
+
+    def subscribed(self, stream_id):
+        with self.lock:
+            return list(self.devices.get(stream_id, []))
+
+    def exists(self, stream_id):
+        with self.lock:
+            return stream_id in self.devices
+
+    def close(self, stream_id):
+        with self.lock:
+            self.devices.pop(stream_id, None)
+
+
+class RateLimiter:
+    # A fixed window of 'limit' requests per second. A limit of 0 disables it
+
+    def __init__(self, limit):
+        self.limit = limit
+        self.lock = threading.Lock()
+        self.window = time.monotonic()
+        self.count = 0
+
+    def check(self):
+        # Returns (allowed, remaining, reset in ms)
+
+        with self.lock:
+            now = time.monotonic()
+
+            if now - self.window >= 1.0:
+                self.window = now
+                self.count = 0
+
+            reset = max(0, int((self.window + 1.0 - now) * 1000))
+
+            if self.limit == 0: return True, 0, reset
+            if self.count >= self.limit: return False, 0, reset
+
+            self.count += 1
+            return True, self.limit - self.count, reset
+
+
+class Stats:
+    # Counts responses by status, log events and token refreshes, so a run can be checked
+    # afterwards via GET /mock/stats
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.counts = {}
+        self.events = 0
+        self.refreshes = 0
+
+    def record(self, status):
+        with self.lock:
+            self.counts[str(status)] = self.counts.get(str(status), 0) + 1
+
+    def record_events(self, count):
+        with self.lock:
+            self.events += count
+
+    def record_refresh(self):
+        with self.lock:
+            self.refreshes += 1
+
+    def snapshot(self):
+        with self.lock:
+            return {"responses": dict(self.counts), "log_events": self.events, "token_refreshes": self.refreshes}
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    server_version = "MockImpCentral/1.0"
+
+    def log_message(self, format, *args):
+        if self.server.args.verbose: super().log_message(format, *args)
+
+    # Request dispatch
+
+    def do_GET(self):
+        self.dispatch("GET")
+
+    def do_POST(self):
+        self.dispatch("POST")
+
+    def do_PUT(self):
+        self.dispatch("PUT")
+
+    def do_PATCH(self):
+        self.dispatch("PATCH")
+
+    def do_DELETE(self):
+        self.dispatch("DELETE")
+
+    def dispatch(self, verb):
+        parts = urlsplit(self.path)
+        path = parts.path
+        query = parse_qs(unquote(parts.query))
+        body = self.read_body()
+
+        if path == "/mock/stats":
+            self.send_json(200, self.server.stats.snapshot())
+            return
+
+        if not path.startswith(API_PREFIX):
+            self.send_error_json(404, "NotFound", "No such endpoint")
+            return
+
+        path = path[len(API_PREFIX):].strip("/")
+
+        # Log streams are long-lived, so they neither wait nor count against the rate limit
+
+        match = re.fullmatch(r"logstream/([0-9a-f]+)", path)
+
+        if verb == "GET" and match:
+            self.stream_logs(match.group(1))
+            return
+
+        if self.server.args.latency > 0: time.sleep(self.server.args.latency)
+
+        allowed, remaining, reset = self.server.limiter.check()
+
+        if not allowed:
+            self.send_error_json(429, "TooManyRequests", "Rate limit exceeded", {
+                "X-RateLimit-Limit": str(self.server.args.rate_limit),
+                "X-RateLimit-Remaining": "0",
+                "X-RateLimit-Reset": str(reset)
+            })
+            return
+
+        if path in ("auth", "auth/token") and verb == "POST":
+            self.issue_token(path, body)
+            return
+
+        if not self.is_authorised():
+            self.send_error_json(401, "Unauthorized", "Invalid or expired access token")
+            return
+
+        if path == "accounts/me" and verb == "GET":
+            self.send_json(200, {"data": {"type": "account", "id": "mock-account",
+                                          "attributes": {"username": "mock", "email": "mock@example.com"}}})
+            return
+
+        if path == "logstream" and verb == "POST":
+            stream_id = self.server.streams.create()
+            url = "http://%s:%d%slogstream/%s" % (self.server.args.host, self.server.server_port, API_PREFIX, stream_id)
+            self.send_json(200, {"data": {"type": "logstream", "id": stream_id, "attributes": {"url": url}}})
+            return
+
+        match = re.fullmatch(r"logstream/([0-9a-f]+)/([0-9a-f]+)", path)
+
+        if match and verb in ("PUT", "DELETE"):
+            if verb == "PUT":
+                if not self.server.streams.subscribe(match.group(1), match.group(2)):
+                    self.send_error_json(404, "NotFound", "No such log stream")
+                    return
+            else:
+                self.server.streams.unsubscribe(match.group(1), match.group(2))
+
+            self.send_json(204, None)
+            return
+
+        match = re.fullmatch(r"(products|devicegroups|devices|deployments)(?:/([^/]+))?", path)
+
+        if match:
+            self.handle_collection(verb, match.group(1), match.group(2), query, body)
+            return
+
+        self.send_error_json(404, "NotFound", "No such endpoint")
+
+    # Endpoints
+
+    def issue_token(self, path, body):
+        try:
+            request = json.loads(body or b"{}")
+        except ValueError:
+            request = {}
+
+        if path == "auth" and (not request.get("id") or not request.get("password")):
+            self.send_error_json(401, "Unauthorized", "Invalid credentials")
+            return
+
+        if path == "auth/token" and request.get("token") != self.server.refresh_token:
+            self.send_error_json(401, "Unauthorized", "Invalid refresh token")
+            return
+
+        lifetime = self.server.args.token_lifetime
+        access = uuid.uuid4().hex
+
+        with self.server.token_lock:
+            # The previous token stays valid until it expires, as it does with impCentral
+
+            now = time.monotonic()
+            self.server.tokens[access] = now + lifetime
+            self.server.tokens = {k: v for k, v in self.server.tokens.items() if v > now}
+
+        response = {
+            "access_token": access,
+            "expires_in": lifetime,
+            "expires_at": iso_time(datetime.now(timezone.utc) + timedelta(seconds=lifetime)),
+            "token_type": "bearer"
+        }
+
+        if path == "auth":
+            response["refresh_token"] = self.server.refresh_token
+        else:
+            self.server.stats.record_refresh()
+
+        self.send_json(200, response)
+
+    def handle_collection(self, verb, name, item_id, query, body):
+        fleet = self.server.fleet
+        records = fleet.collections[name]
+
+        if item_id is None:
+            if verb != "GET":
+                self.send_json(201 if verb == "POST" else 204, {"data": {"type": name, "id": uuid.uuid4().hex}})
+                return
+
+            self.send_page(name, records, query)
+            return
+
+        with fleet.lock:
+            index = next((i for i, r in enumerate(records) if r["id"] == item_id), None)
+
+            if index is None:
+                self.send_error_json(404, "NotFound", "No such resource")
+                return
+
+            if verb == "GET":
+                self.send_json(200, {"data": records[index]})
+            elif verb == "PATCH":
+                try:
+                    update = json.loads(body or b"{}").get("data", {}).get("attributes", {})
+                except (ValueError, AttributeError):
+                    update = {}
+
+                records[index]["attributes"].update(update)
+                self.send_json(200, {"data": records[index]})
+            elif verb == "DELETE":
+                del records[index]
+                self.send_json(204, None)
+            else:
+                self.send_error_json(405, "MethodNotAllowed", "Method not allowed")
+
+    def send_page(self, name, records, query):
+        # impCentral pages with 'page[number]' (from 1) and 'page[size]', and links each page to the next
+
+        size = int(query.get("page[size]", [self.server.args.default_page_size])[0])
+        size = max(1, min(size, self.server.args.max_page_size))
+        number = max(1, int(query.get("page[number]", ["1"])[0]))
+
+        with self.server.fleet.lock:
+            total = len(records)
+            data = records[(number - 1) * size:number * size]
+
+        last = max(1, (total + size - 1) // size)
+        base = "http://%s:%d%s%s" % (self.server.args.host, self.server.server_port, API_PREFIX, name)
+        link = lambda n: "%s?page[number]=%d&page[size]=%d" % (base, n, size)
+        links = {"self": link(number), "first": link(1), "last": link(last)}
+
+        if number < last: links["next"] = link(number + 1)
+        if number > 1: links["prev"] = link(number - 1)
+
+        self.send_json(200, {"data": data, "links": links})
+
+    def stream_logs(self, stream_id):
+        # Server-sent events: a state change to say the stream is open, then log messages for the
+        # subscribed devices at the requested rate, with CRLF line endings on alternate events
+
+        if not self.server.streams.exists(stream_id):
+            self.send_error_json(404, "NotFound", "No such log stream")
+            return
+
+        self.send_response(200)
+        self.send_header("Content-Type", "text/event-stream")
+        self.send_header("Cache-Control", "no-cache")
+        self.send_header("Connection", "close")
+        self.end_headers()
+        self.close_connection = True
+        self.server.stats.record(200)
+
+        rate = self.server.args.log_rate
+        interval = 1.0 / rate if rate > 0 else 1.0
+        counter = 0
+        announced = set()
+
+        try:
+            self.wfile.write(b"event: state_change\ndata: opened\n\n")
+            self.wfile.flush()
+
+            while self.server.streams.exists(stream_id):
+                devices = self.server.streams.subscribed(stream_id)
+                chunk = []
+
+                for device in devices:
+                    if device not in announced:
+                        announced.add(device)
+                        chunk.append("event: state_change\ndata: %s subscribed\n\n" % device)
+
+                if rate > 0 and devices:
+                    device = devices[counter % len(devices)]
+                    stamp = iso_time(datetime.now(timezone.utc))
+                    ending = "\r\n" if counter % 2 else "\n"
+                    message = "%s %s development server.log Mock log entry %d – ünïcödé" % (device, stamp, counter)
+                    chunk.append("id: %d%sevent: message%sdata: %s%s%s" % (counter, ending, ending, message, ending, ending))
+                    counter += 1
+
+                if chunk:
+                    self.wfile.write("".join(chunk).encode("utf-8"))
+                    self.wfile.flush()
+                    if rate > 0 and devices: self.server.stats.record_events(1)
+                else:
+                    # Keep the connection alive with a comment while there is nothing to send
+
+                    self.wfile.write(b": keep-alive\n\n")
+                    self.wfile.flush()
+
+                time.sleep(interval if devices else 0.5)
+        except (BrokenPipeError, ConnectionResetError):
+            pass
+
+    # Helpers
+
+    def is_authorised(self):
+        header = self.headers.get("Authorization", "")
+
+        if not header.startswith("Bearer "): return False
+
+        with self.server.token_lock:
+            expiry = self.server.tokens.get(header[7:])
+
+        return expiry is not None and expiry > time.monotonic()
+
+    def read_body(self):
+        length = int(self.headers.get("Content-Length", "0") or 0)
+        return self.rfile.read(length) if length > 0 else b""
+
+    def send_json(self, status, payload, headers=None):
+        body = b"" if payload is None or status == 204 else json.dumps(payload).encode("utf-8")
+
+        self.send_response(status)
+        self.send_header("Content-Type", "application/vnd.api+json")
+        self.send_header("Content-Length", str(len(body)))
+
+        for key, value in (headers or {}).items(): self.send_header(key, value)
+
+        if self.server.args.rate_limit > 0 and status != 429:
+            self.send_header("X-RateLimit-Limit", str(self.server.args.rate_limit))
+
+        self.end_headers()
+        self.wfile.write(body)
+        self.server.stats.record(status)
+
+    def send_error_json(self, status, code, detail, headers=None):
+        self.send_json(status, {"errors": [{"status": str(status), "code": code, "title": code, "detail": detail}]}, headers)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Local stand-in for the impCentral API")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--devices", type=int, default=10000, help="number of devices in the fleet")
+    parser.add_argument("--products", type=int, default=20)
+    parser.add_argument("--groups", type=int, default=100)
+    parser.add_argument("--deployments", type=int, default=500)
+    parser.add_argument("--latency", type=float, default=0.05, help="seconds added to every API response")
+    parser.add_argument("--log-rate", type=float, default=100.0, help="log messages per second per stream")
+    parser.add_argument("--token-lifetime", type=int, default=3600, help="access token lifetime in seconds")
+    parser.add_argument("--rate-limit", type=int, default=0, help="requests per second before a 429 (0: no limit)")
+    parser.add_argument("--default-page-size", type=int, default=20)
+    parser.add_argument("--max-page-size", type=int, default=100)
+    parser.add_argument("--verbose", action="store_true")
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer((args.host, args.port), Handler)
+    server.daemon_threads = True
+    server.args = args
+    server.fleet = Fleet(args)
+    server.streams = Streams()
+    server.limiter = RateLimiter(args.rate_limit)
+    server.stats = Stats()
+    server.tokens = {}
+    server.token_lock = threading.Lock()
+    server.refresh_token = uuid.uuid4().hex
+
+    print("Mock impCentral serving %d devices at http://%s:%d%s" % (args.devices, args.host, server.server_port, API_PREFIX), flush=True)
+
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
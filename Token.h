@@ -34,12 +34,14 @@
 // Token is simply a packaging object for impCentral API access data
 // and associated data ie. it has no methods, just four properties:
 
-@property (nonatomic, strong) NSString  *accessToken;
-@property (nonatomic, strong) NSString  *expiryDate;
-@property (nonatomic, strong) NSString  *refreshToken;
-@property (nonatomic, strong) NSString  *loginKey;
-@property (nonatomic, strong) NSString  *account;
-@property (nonatomic, assign) NSInteger lifetime;
+@property (nonatomic, strong) NSString       *accessToken;
+@property (nonatomic, strong) NSString       *expiryDate;
+@property (nonatomic, strong) NSString       *refreshToken;
+@property (nonatomic, strong) NSString       *loginKey;
+@property (nonatomic, strong) NSString       *account;
+@property (nonatomic, assign) NSInteger      lifetime;
+@property (nonatomic, assign) NSTimeInterval expiryTime;    // Expiry as system uptime, once calculated
+@property (nonatomic, assign) BOOL           hasExpiryTime; // YES once 'expiryTime' has been calculated
 
 
 @end
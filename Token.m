@@ -29,7 +29,7 @@
 @implementation Token
 
 
-@synthesize accessToken, refreshToken, expiryDate, lifetime, loginKey, account;
+@synthesize accessToken, refreshToken, expiryDate, lifetime, loginKey, account, expiryTime, hasExpiryTime;
 
 
 - (instancetype)init
@@ -40,6 +40,8 @@
         refreshToken = @"";
         expiryDate = @"";
         lifetime = 0;
+        expiryTime = 0;
+        hasExpiryTime = NO;
         loginKey = @"";
         account = @"";
     }